@@ -21,6 +21,7 @@
 #include "pv.uc"
 #include "pkt_io.uc"
 #include "ebpf.uc"
+#include "lro.uc"
 #include "app_mac_lkup.h"
 #include "mem_lkup.uc"
 
@@ -96,7 +97,233 @@ mem_lkup_init_hash_addr(g_mac_lkup_addr, _mac_lkup_tbl, HASH_OP_CAMR48_64B, 0, M
 #endm
 
 
+#ifdef ACTIONS_PROFILE
+/* Per opcode cycle accounting, enabled by building the datapath with
+ * ACTIONS_PROFILE defined.
+ *
+ * The cycle counter is sampled whenever control passes from one instruction
+ * to the next (including pipelined fall through) and at the end of each
+ * packet. PROFILE_COUNT only has 16 bits, so each sample also keeps the low
+ * 16 bits of TIMESTAMP_LOW (16 cycle ticks) in its upper half. Deltas up to
+ * 2^20 cycles are exact, see __actions_profile_close().
+ * The elapsed cycles, including memory stalls and context swaps, are
+ * accumulated per opcode in local memory shared by all contexts of the ME.
+ * Every ACTIONS_PROF_FLUSH packets the accumulators are added to the exported
+ * _actions_prof symbol, which holds a 64-bit cycle sum and a 64-bit count per
+ * opcode summed over all workers (see scripts/actions_prof.awk).
+ *
+ * Sampling is restricted to the ingress queue written to _actions_prof_queue
+ * (NIC_CFG_INSTR_TBL index, i.e. (pcie << 6) | queue for host queues and
+ * (1 << 8) | port for wire ports), ACTIONS_PROF_ALL_QUEUES samples every
+ * packet. The filter is reloaded on every flush.
+ */
+#define ACTIONS_PROF_OPS            32
+#define ACTIONS_PROF_FLUSH_SHF      12
+#define ACTIONS_PROF_FLUSH          (1 << ACTIONS_PROF_FLUSH_SHF)
+#define ACTIONS_PROF_ALL_QUEUES     0xffff
+#define ACTIONS_PROF_PKTS_OFFSET    (ACTIONS_PROF_OPS * 8)
+
+.alloc_mem __actions_prof_lm lmem me (ACTIONS_PROF_PKTS_OFFSET + 8) 8
+.alloc_mem _actions_prof emem global (ACTIONS_PROF_OPS * 16) 256
+.alloc_mem _actions_prof_queue emem global 8 8
+.init _actions_prof_queue ACTIONS_PROF_ALL_QUEUES
+
+/* Pinned above the registers available to eBPF programs so that the state
+ * survives INSTR_EBPF. Bit 31 of __actions_prof_cur is set while the current
+ * packet is not sampled, otherwise it holds the LM address of the current
+ * opcode's accumulators.
+ */
+.reg volatile __actions_prof_cur
+.reg_addr __actions_prof_cur 30 A
+.set __actions_prof_cur
+.reg volatile __actions_prof_ts
+.reg_addr __actions_prof_ts 30 B
+.set __actions_prof_ts
+.reg volatile __actions_prof_filter
+.reg_addr __actions_prof_filter 31 A
+.set __actions_prof_filter
+
+
+/* Sample the cycle counter: TIMESTAMP_LOW ticks in bits 31:16 and
+ * PROFILE_COUNT in bits 15:0.
+ */
+#macro __actions_profile_now(out_now)
+.begin
+    .reg ticks
+
+    local_csr_rd[PROFILE_COUNT]
+    immed[out_now, 0]
+    local_csr_rd[TIMESTAMP_LOW]
+    immed[ticks, 0]
+    ld_field[out_now, 1100, ticks, <<16]
+.end
+#endm
+
+
+/* Account the cycles since the last sample to the current opcode. The low
+ * 16 bits of the delta come from PROFILE_COUNT, the multiple of 2^16 above
+ * them is the tick delta times 16 rounded to the nearest multiple.
+ */
+#macro __actions_profile_close(out_now)
+.begin
+    .reg delta
+    .reg wide
+
+    __actions_profile_now(out_now)
+    br_bset[__actions_prof_cur, 31, end#]
+
+    local_csr_wr[ACTIVE_LM_ADDR_0, __actions_prof_cur]
+    alu[wide, out_now, -, __actions_prof_ts]
+    ld_field_w_clr[delta, 0011, wide]
+    alu[wide, --, B, wide, >>16]
+    alu[wide, --, B, wide, <<4]
+    alu[wide, wide, -, delta]
+    alu[wide, wide, +, 0x80, <<8]
+    alu[wide, --, B, wide, >>16]
+    alu[delta, delta, +, wide, <<16]
+    alu[*l$index0[0], *l$index0[0], +, delta]
+    alu[*l$index0[1], *l$index0[1], +, 1]
+
+end#:
+.end
+#endm
+
+
+/* Close the current opcode and open the one at *$index */
+#macro __actions_profile_switch()
+.begin
+    .reg now
+    .reg op
+
+    __actions_profile_close(now)
+    br_bset[__actions_prof_cur, 31, end#]
+
+    alu[op, (ACTIONS_PROF_OPS - 1), AND, *$index, >>INSTR_OPCODE_LSB]
+    immed[__actions_prof_cur, __actions_prof_lm]
+    alu[__actions_prof_cur, __actions_prof_cur, OR, op, <<3]
+    alu[__actions_prof_ts, --, B, now]
+
+end#:
+.end
+#endm
+
+
+/* Decide whether the packet is sampled and open its first opcode */
+#macro __actions_profile_begin(in_act_addr)
+.begin
+    .reg filter
+    .reg now
+    .reg op
+    .reg qid
+
+    alu[qid, --, B, in_act_addr, >>(log2(NIC_MAX_INSTR * 4))]
+    ld_field_w_clr[filter, 0011, __actions_prof_filter]
+    alu[--, filter, -, qid]
+    beq[sample#]
+
+    immed[qid, ACTIONS_PROF_ALL_QUEUES]
+    alu[--, filter, -, qid]
+    beq[sample#]
+
+    br[end#], defer[1]
+        alu[__actions_prof_cur, --, B, 1, <<31]
+
+sample#:
+    __actions_profile_now(now)
+    alu[op, (ACTIONS_PROF_OPS - 1), AND, $__actions[0], >>INSTR_OPCODE_LSB]
+    immed[__actions_prof_cur, __actions_prof_lm]
+    alu[__actions_prof_cur, __actions_prof_cur, OR, op, <<3]
+    alu[__actions_prof_ts, --, B, now]
+
+end#:
+.end
+#endm
+
+
+#macro actions_profile_init()
+    immed[__actions_prof_filter, ACTIONS_PROF_ALL_QUEUES]
+    alu[__actions_prof_cur, --, B, 1, <<31]
+#endm
+
+
+/* Close the last opcode of the packet and flush the accumulators to
+ * _actions_prof every ACTIONS_PROF_FLUSH packets per ME.
+ */
+#macro actions_profile_end()
+.begin
+    .reg addr_hi
+    .reg addr_lo
+    .reg lm_addr
+    .reg now
+    .reg pkts
+    .reg read $filter
+    .reg write $prof[4]
+    .xfer_order $prof
+    .sig sig_filter
+    .sig sig_prof
+
+    __actions_profile_close(now)
+
+    immed[lm_addr, (__actions_prof_lm + ACTIONS_PROF_PKTS_OFFSET)]
+    local_csr_wr[ACTIVE_LM_ADDR_0, lm_addr]
+    alu[__actions_prof_cur, --, B, 1, <<31]
+    nop
+    nop
+    alu[pkts, *l$index0, +, 1]
+    br_bclr[pkts, ACTIONS_PROF_FLUSH_SHF, end#], defer[1]
+        alu[*l$index0, --, B, pkts]
+
+    /* zero the packet count first so only this context flushes */
+    alu[*l$index0, --, B, 0]
+    immed[lm_addr, __actions_prof_lm]
+    move(addr_hi, (_actions_prof >> 8))
+    immed[addr_lo, 0]
+
+flush_loop#:
+    local_csr_wr[ACTIVE_LM_ADDR_0, lm_addr]
+    nop
+    nop
+    nop
+    alu[--, --, B, *l$index0[1]]
+    beq[flush_next#]
+
+    /* copy and zero LM before swapping out, other contexts keep counting */
+    alu[$prof[0], --, B, 0]
+    alu[$prof[1], --, B, *l$index0[0]]
+    alu[$prof[2], --, B, 0]
+    alu[$prof[3], --, B, *l$index0[1]]
+    alu[*l$index0[0], --, B, 0]
+    alu[*l$index0[1], --, B, 0]
+    mem[add64, $prof[0], addr_hi, <<8, addr_lo, 2], ctx_swap[sig_prof]
+
+flush_next#:
+    alu[addr_lo, addr_lo, +, 16]
+    br_bclr[addr_lo, log2(ACTIONS_PROF_OPS * 16), flush_loop#], defer[1]
+        alu[lm_addr, lm_addr, +, 8]
+
+    move(addr_hi, (_actions_prof_queue >> 8))
+    mem[read32, $filter, addr_hi, <<8, 0, 1], ctx_swap[sig_filter]
+    alu[__actions_prof_filter, --, B, $filter]
+
+end#:
+.end
+#endm
+
+#else /* ACTIONS_PROFILE */
+
+#macro actions_profile_init()
+#endm
+
+#macro actions_profile_end()
+#endm
+
+#endif /* ACTIONS_PROFILE */
+
+
 #macro __actions_next()
+    #ifdef ACTIONS_PROFILE
+        __actions_profile_switch()
+    #endif
     br_bclr[*$index, INSTR_PIPELINE_BIT, next#]
 #endm
 
@@ -130,11 +357,23 @@ mem_lkup_init_hash_addr(g_mac_lkup_addr, _mac_lkup_tbl, HASH_OP_CAMR48_64B, 0, M
  *       +-----------------------+-------+-------------------------------+
  *    1  |                           MAC ADDR LO                         |
  *       +---------+-------------------------------------------+---------+
+ *
+ * Resolved lookups are cached per island in _veb_cache (CTM), so a hit costs
+ * a single CTM read instead of the hash table lookup and action list fetch
+ * from EMEM. Each 64 byte entry holds the action list (words 0 - 13) and the
+ * key (words 14 - 15) with NIC_VEB_CACHE_VALID set in word 14. The entry is
+ * read straight into $__actions, so a miss has to reload the original action
+ * list from CLS before carrying on. Entries are flushed by the app master,
+ * see cfg_act_veb_cache_sync().
  */
 
 #macro __actions_veb_lookup(in_pkt_vec, DROP_LABEL)
 .begin
+    .reg act_addr
+    .reg cache_base
+    .reg cache_off
     .reg ins_addr[2]
+    .reg key[2]
     .reg key_addr
     .reg mac_hi
     .reg mac_lo
@@ -158,7 +397,7 @@ veb_error#:
 
 veb_miss#:
     alu[--, port_mac[0], OR, port_mac[1]]
-    beq[done#]
+    beq[veb_reload#]
     pv_stats_update(in_pkt_vec, RX_DISCARD_ADDR, DROP_LABEL)
 
 veb_lookup#:
@@ -170,9 +409,29 @@ veb_lookup#:
     bitfield_extract(vlan_id, BF_AML(in_pkt_vec, PV_VLAN_ID_bf))
     alu[vlan_id, --, B, vlan_id, <<20]
 
-    alu[*l$index0++, vlan_id, +16, *$index++]
-    alu[*l$index0, --, B, *$index]
+    alu[key[0], vlan_id, +16, *$index++]
+    alu[key[1], --, B, *$index]
+    alu[*l$index0++, --, B, key[0]]
+    alu[*l$index0, --, B, key[1]]
+
+    alu[cache_off, key[0], XOR, key[1]]
+    alu[cache_off, cache_off, XOR, cache_off, >>16]
+    alu[cache_off, (NIC_VEB_CACHE_ENTRIES - 1), AND, cache_off]
+    alu[cache_off, --, B, cache_off, <<(log2(NIC_MAX_INSTR * 4))]
+    move(cache_base, (_veb_cache >> 8))
+
+    ov_start(OV_LENGTH)
+    ov_set_use(OV_LENGTH, 16, OVF_SUBTRACT_ONE)
+    ov_clean()
+    mem[read32, $__actions[0], cache_base, <<8, cache_off, max_16], indirect_ref, ctx_swap[sig_read], defer[1]
+        alu[key[0], key[0], OR, 1, <<NIC_VEB_CACHE_VALID_SHF]
+
+    alu[--, key[0], XOR, $__actions[NIC_MAX_INSTR - 2]]
+    bne[veb_cache_miss#]
+    alu[--, key[1], XOR, $__actions[NIC_MAX_INSTR - 1]]
+    beq[veb_loaded#]
 
+veb_cache_miss#:
     #define HASHMAP_RXFR_COUNT 4
     #define MAP_RDXR $__pv_pkt_data
     // hashmap_ops will overwrite the packet cache, we MUST invalidate
@@ -198,13 +457,44 @@ veb_hit#:
     ov_start(OV_LENGTH)
     ov_set_use(OV_LENGTH, 16, OVF_SUBTRACT_ONE)
     ov_clean()
-    mem[read32, $__actions[0], ins_addr[0], <<8, ins_addr[1], max_16], indirect_ref, sig_done[sig_read]
-
-    ctx_arb[sig_read], defer[2], br[done#]
+    mem[read32, $__actions[0], ins_addr[0], <<8, ins_addr[1], max_16], indirect_ref, ctx_swap[sig_read]
+
+    .begin
+        .reg write $veb_fill[NIC_MAX_INSTR]
+        .xfer_order $veb_fill
+
+        #define_eval LOOP 0
+        #while (LOOP < (NIC_MAX_INSTR - 2))
+            alu[$veb_fill[LOOP], --, B, $__actions[LOOP]]
+            #define_eval LOOP (LOOP + 1)
+        #endloop
+        #undef LOOP
+        alu[$veb_fill[NIC_MAX_INSTR - 2], --, B, key[0]]
+        alu[$veb_fill[NIC_MAX_INSTR - 1], --, B, key[1]]
+
+        // wait for the write so the fill is retired before the next epoch
+        ov_start(OV_LENGTH)
+        ov_set_use(OV_LENGTH, 16, OVF_SUBTRACT_ONE)
+        ov_clean()
+        mem[write32, $veb_fill[0], cache_base, <<8, cache_off, max_16], indirect_ref, ctx_swap[sig_read]
+    .end
+
+veb_loaded#:
+    br[done#], defer[2]
         .reg_addr __actions_t_idx 28 B
         alu[__actions_t_idx, t_idx_ctx, OR, &$__actions[0], <<2]
         nop
 
+veb_reload#:
+    // the cache probe overwrote the original instructions, fetch them again
+    alu[act_addr, --, B, BF_A(in_pkt_vec, PV_QUEUE_IN_bf), >>BF_L(PV_QUEUE_IN_bf)]
+    alu[act_addr, --, B, act_addr, <<(log2(NIC_MAX_INSTR * 4))]
+    ov_start(OV_LENGTH)
+    ov_set_use(OV_LENGTH, 16, OVF_SUBTRACT_ONE)
+    ov_clean()
+    cls[read, $__actions[0], 0, act_addr, max_16], indirect_ref, ctx_swap[sig_read]
+    br[done#]
+
 mac_match_check#:
     alu[mac_hi, port_mac[0], XOR, *$index++]
     alu[mac_lo, port_mac[1], XOR, *$index--]
@@ -367,13 +657,61 @@ end#:
 #endm
 
 
+/* Fold one 32-bit word of hash input into a Toeplitz hash. Every nibble of
+ * the word selects one word from its row in the key tables, io_tbl_addr is
+ * advanced to the rows of the next input word.
+ */
+#macro __actions_rss_toeplitz_word(io_hash, in_data, io_tbl_addr)
+.begin
+    .reg nibble
+    .reg read $tpz_row[4]
+    .sig tpz_sig0
+    .sig tpz_sig1
+    .sig tpz_sig2
+    .sig tpz_sig3
+
+    #define_eval _TPZ_NIBBLE (0)
+    #while (_TPZ_NIBBLE < 8)
+        #define_eval _TPZ_SLOT (_TPZ_NIBBLE & 3)
+        #define_eval _TPZ_SHF (26 - (4 * _TPZ_NIBBLE))
+        #if (_TPZ_SHF > 0)
+            alu[nibble, 0x3c, AND, in_data, >>(_TPZ_SHF)]
+        #else
+            alu[nibble, 0x3c, AND, in_data, <<2]
+        #endif
+        cls[read, $tpz_row[_TPZ_SLOT], io_tbl_addr, nibble, 1], sig_done[tpz_sig/**/_TPZ_SLOT]
+        alu[io_tbl_addr, io_tbl_addr, +, (16 * 4)]
+        #if (_TPZ_SLOT == 3)
+            ctx_arb[tpz_sig0, tpz_sig1, tpz_sig2, tpz_sig3]
+            alu[io_hash, io_hash, XOR, $tpz_row[0]]
+            alu[io_hash, io_hash, XOR, $tpz_row[1]]
+            alu[io_hash, io_hash, XOR, $tpz_row[2]]
+            alu[io_hash, io_hash, XOR, $tpz_row[3]]
+        #endif
+        #define_eval _TPZ_NIBBLE (_TPZ_NIBBLE + 1)
+    #endloop
+    #undef _TPZ_SHF
+    #undef _TPZ_SLOT
+    #undef _TPZ_NIBBLE
+.end
+#endm
+
+
 #macro __actions_rss(in_pkt_vec)
 .begin
+    .reg act_addr
+    .reg act_mask
+    .reg act_offset
     .reg args[2]
+    .reg arfs_base
+    .reg arfs_flow
+    .reg arfs_offset
     .reg data
+    .reg hash
     .reg hash_type
     .reg l3_offset
     .reg l4_offset
+    .reg l3_end
     .reg l4_data
     .reg max_queue
     .reg process_l4
@@ -382,9 +720,18 @@ end#:
     .reg queue
     .reg rss_table_addr
     .reg rss_table_idx
+    .reg sym_data
+    .reg sym_port
+    .reg sym_src[3]
     .reg write $metadata
+    .reg write $act_bit
+    .reg read $act_word
     .reg read $rss_tbl_row
+    .reg read $arfs_entry[3]
+    .xfer_order $arfs_entry
     .sig rss_tbl_sig
+    .sig arfs_sig
+    .sig act_sig
 
     __actions_read_begin()
     __actions_read(args[0])
@@ -425,9 +772,14 @@ begin#:
     byte_align_be[l4_data, *$index++]
 
 process_l3#:
+    br_bset[BF_AL(args, INSTR_RSS_TOEPLITZ_bf), toeplitz#]
+    br_bset[BF_AL(args, INSTR_RSS_SYMMETRIC_bf), symmetric#]
+
     pv_seek(in_pkt_vec, l3_offset, PV_SEEK_PAD_INCLUDED)
 
-    local_csr_wr[CRC_REMAINDER, BF_A(args, INSTR_RSS_KEY_bf)]
+    /* seed CRC32 with the key alone, the mode bits above it differ per vNIC */
+    alu[data, BF_A(args, INSTR_RSS_KEY_bf), AND~, ((1 << (31 - BF_M(INSTR_RSS_KEY_bf))) - 1), <<(BF_M(INSTR_RSS_KEY_bf) + 1)]
+    local_csr_wr[CRC_REMAINDER, data]
     byte_align_be[--, *$index++]
     byte_align_be[data, *$index++]
     br_bset[BF_A(in_pkt_vec, PV_PROTO_bf), 1, process_l4#], defer[3] // branch if IPv4, 2 words hashed
@@ -452,6 +804,7 @@ process_l4#:
 
     crc_be[crc_32, --, l4_data]
 
+l4_hashed#:
     alu[proto_shf, BF_A(in_pkt_vec, PV_PROTO_bf), AND, 1]
     alu[proto_delta, proto_shf, B, 3]
     alu[proto_delta, --, B, proto_delta, <<indirect]
@@ -466,12 +819,79 @@ skip_l4#:
     local_csr_rd[CRC_REMAINDER]
     immed[*l$index2, 0]
 
+select_queue#:
     /* Select queue = rss_tbl[hash % NFP_NET_CFG_RSS_ITBL_SZ] */
-    alu[rss_table_idx, (NFP_NET_CFG_RSS_ITBL_SZ - 1), AND, *l$index2++]
+    alu[rss_table_idx, (NFP_NET_CFG_RSS_ITBL_SZ - 1), AND, *l$index2]
     cls[read, $rss_tbl_row, rss_table_addr, rss_table_idx, 1], sig_done[rss_tbl_sig]
-    ctx_arb[rss_tbl_sig], defer[2], br[finalize#]
-        pv_meta_push_type__sz1(in_pkt_vec, hash_type)
+    br_bset[BF_AL(args, INSTR_RSS_REBALANCE_bf), mark_bucket#]
+
+bucket_marked#:
+    pv_meta_push_type__sz1(in_pkt_vec, hash_type)
+    br=byte[l4_offset, 0, 0, rss_tbl#], defer[1]
         bits_set__sz1(BF_AL(in_pkt_vec, PV_TX_HOST_RX_RSS_bf), 1)
+    br_bclr[BF_AL(args, INSTR_RSS_ARFS_bf), rss_tbl#]
+
+    /* TCP and UDP flows steered by the driver (aRFS) override the RSS table.
+     * The app master only sets INSTR_RSS_ARFS while the vNIC has entries.
+     * The aRFS entry is fetched in parallel with the RSS table row, a miss
+     * falls back to the row. The entry layout is in cmsg_map_types.h.
+     */
+    alu[arfs_offset, --, B, *l$index2, <<(32 - NIC_ARFS_TBL_ENTRIES_LOG2)]
+    alu[arfs_offset, --, B, arfs_offset, >>(32 - NIC_ARFS_TBL_ENTRIES_LOG2 - NIC_ARFS_ENTRY_SZ_LOG2)]
+    move(arfs_base, (_nic_arfs_tbl >> 8))
+    mem[read32, $arfs_entry[0], arfs_base, <<8, arfs_offset, 3], sig_done[arfs_sig]
+    ctx_arb[rss_tbl_sig, arfs_sig]
+
+    alu[--, *l$index2++, XOR, $arfs_entry[1]]
+    bne[finalize#]
+    alu[--, l4_data, XOR, $arfs_entry[2]]
+    bne[finalize#]
+    alu[arfs_flow, rss_table_addr, XOR, 1, <<(log2(NIC_RSS_TBL_ADDR))]
+    alu[arfs_flow, arfs_flow, OR, hash_type, <<BF_L(NIC_ARFS_HASH_TYPE_bf)]
+    alu[arfs_flow, arfs_flow, OR, 1, <<BF_L(NIC_ARFS_VALID_bf)]
+    alu[queue, $arfs_entry[0], AND~, BF_MASK(NIC_ARFS_QUEUE_bf), <<BF_L(NIC_ARFS_QUEUE_bf)]
+    alu[--, arfs_flow, XOR, queue]
+    bne[finalize#]
+
+    /* driver supplied queues beyond the enabled rings take the RSS row */
+    bitfield_extract__sz1(max_queue, BF_AML(args, INSTR_RSS_MAX_QUEUE_bf))
+    alu[queue, --, B, $arfs_entry[0], >>BF_L(NIC_ARFS_QUEUE_bf)]
+    alu[--, max_queue, -, queue]
+    blo[finalize#]
+
+    __actions_restore_t_idx()
+
+    br_bset[BF_AL(args, INSTR_RSS_V1_META_bf), end#], defer[1]
+        ld_field[BF_A(in_pkt_vec, PV_QUEUE_OFFSET_bf), 0001, queue]; PV_QUEUE_OFFSET_bf
+
+    br[end#], defer[1]
+        pv_meta_push_type__sz1(in_pkt_vec, NFP_NET_META_HASH) // RSSv2
+
+rss_tbl#:
+    ctx_arb[rss_tbl_sig], defer[1], br[finalize#]
+        alu[--, --, B, *l$index2++]
+
+mark_bucket#:
+    /* Tell the rebalancer the bucket is in use, see cfg_act_rss_rebalance().
+     * The bit for bucket b of table t is at NIC_RSS_ACT_TBL + (t * 16) +
+     * (b / 32) * 4, bit b % 32. The word is read alongside the RSS table row
+     * and the bit only set if it is clear, so busy buckets cost a read.
+     */
+    passert(NIC_RSS_ACT_TBL_ADDR, "MULTIPLE_OF", 256)
+    passert((NFP_NET_CFG_RSS_ITBL_SZ / 8), "EQ", 16)
+    alu[act_addr, rss_table_addr, AND, BF_MASK(INSTR_RSS_TABLE_IDX_bf), <<BF_L(INSTR_RSS_TABLE_IDX_bf)]
+    alu[act_addr, --, B, act_addr, >>3]
+    alu[act_offset, rss_table_idx, AND~, 0x1f]
+    alu[act_addr, act_addr, +, act_offset, >>3]
+    alu[act_addr, act_addr, OR, (NIC_RSS_ACT_TBL_ADDR >> 8), <<8]
+    cls[read, $act_word, act_addr, 0, 1], defer[2], ctx_swap[act_sig]
+        alu[--, rss_table_idx, OR, 0]
+        alu[act_mask, --, B, 1, <<indirect]
+    alu[--, act_mask, AND, $act_word]
+    bne[bucket_marked#]
+    alu[$act_bit, --, B, act_mask]
+    cls[set, $act_bit, act_addr, 0, 1], ctx_swap[act_sig]
+    br[bucket_marked#]
 
 queue_selected#:
     bitfield_extract__sz1(max_queue, BF_AML(args, INSTR_RSS_MAX_QUEUE_bf))
@@ -482,6 +902,108 @@ queue_selected#:
     br[begin#], defer[1]
         pv_set_queue_offset__sz1(in_pkt_vec, 0)
 
+toeplitz#:
+    /* The table lookups swap context, so every input word is read after a
+     * fresh seek. This is cheap since the packet data stays cached. The L4
+     * ports cached in l4_data follow the addresses in the hash input and
+     * therefore use the table rows following those of the last address word.
+     */
+    passert(BF_L(INSTR_RSS_KEY_TBL_bf), "EQ", 0)
+    passert(BF_M(INSTR_RSS_KEY_TBL_bf), "EQ", 15)
+    ld_field_w_clr[rss_table_addr, 0011, BF_A(args, INSTR_RSS_KEY_TBL_bf)]
+    immed[hash, 0]
+    br_bset[BF_A(in_pkt_vec, PV_PROTO_bf), 1, toeplitz_l3#], defer[1] // branch if IPv4, 2 words hashed
+        alu[l3_end, l3_offset, +, 8]
+
+    alu[l3_end, l3_offset, +, 32]
+    alu[hash_type, hash_type, +, 1]
+
+toeplitz_l3#:
+    pv_seek(in_pkt_vec, l3_offset, PV_SEEK_PAD_INCLUDED)
+    byte_align_be[--, *$index++]
+    byte_align_be[data, *$index++]
+    __actions_rss_toeplitz_word(hash, data, rss_table_addr)
+    alu[l3_offset, l3_offset, +, 4]
+    alu[--, l3_end, -, l3_offset]
+    bgt[toeplitz_l3#]
+
+    br=byte[l4_offset, 0, 0, toeplitz_end#]
+
+    __actions_rss_toeplitz_word(hash, l4_data, rss_table_addr)
+
+    alu[proto_shf, BF_A(in_pkt_vec, PV_PROTO_bf), AND, 1]
+    alu[proto_delta, proto_shf, B, 3]
+    alu[proto_delta, --, B, proto_delta, <<indirect]
+    alu[hash_type, hash_type, +, proto_delta]
+
+toeplitz_end#:
+    alu[rss_table_addr, BF_A(args, INSTR_RSS_TABLE_IDX_bf), AND, BF_MASK(INSTR_RSS_TABLE_IDX_bf), <<BF_L(INSTR_RSS_TABLE_IDX_bf)]
+    alu[rss_table_addr, rss_table_addr, OR, 1, <<(log2(NIC_RSS_TBL_ADDR))]
+    br[select_queue#], defer[1]
+        alu[*l$index2, --, B, hash]
+
+symmetric#:
+    /* Order independent CRC32 input: the lower IPv4 address and the lower
+     * port are hashed first, IPv6 source and destination words are folded
+     * with XOR. l4_data is left as is for the aRFS lookup.
+     */
+    pv_seek(in_pkt_vec, l3_offset, PV_SEEK_PAD_INCLUDED)
+
+    alu[data, BF_A(args, INSTR_RSS_KEY_bf), AND~, ((1 << (31 - BF_M(INSTR_RSS_KEY_bf))) - 1), <<(BF_M(INSTR_RSS_KEY_bf) + 1)]
+    local_csr_wr[CRC_REMAINDER, data]
+    byte_align_be[--, *$index++]
+    byte_align_be[data, *$index++]
+    br_bclr[BF_A(in_pkt_vec, PV_PROTO_bf), 1, symmetric_ipv6#] // branch if IPv6
+    byte_align_be[sym_data, *$index++]
+    alu[--, sym_data, -, data]
+    blo[symmetric_ipv4_swap#]
+    crc_be[crc_32, --, data]
+    br[symmetric_l4#], defer[1]
+        crc_be[crc_32, --, sym_data]
+
+symmetric_ipv4_swap#:
+    crc_be[crc_32, --, sym_data]
+    br[symmetric_l4#], defer[1]
+        crc_be[crc_32, --, data]
+
+symmetric_ipv6#:
+    #define_eval LOOP (0)
+    #while (LOOP < 3)
+        byte_align_be[sym_src[LOOP], *$index++]
+        #define_eval LOOP (LOOP + 1)
+    #endloop
+    byte_align_be[sym_data, *$index++]
+    alu[sym_data, sym_data, XOR, data]
+    crc_be[crc_32, --, sym_data]
+    #define_eval LOOP (0)
+    #while (LOOP < 3)
+        byte_align_be[sym_data, *$index++]
+        alu[sym_data, sym_data, XOR, sym_src[LOOP]]
+        crc_be[crc_32, --, sym_data]
+        #define_eval LOOP (LOOP + 1)
+    #endloop
+    #undef LOOP
+
+    alu[hash_type, hash_type, +, 1]
+
+symmetric_l4#:
+    br=byte[l4_offset, 0, 0, skip_l4#], defer[1]
+        alu[rss_table_addr, BF_A(args, INSTR_RSS_TABLE_IDX_bf), AND, BF_MASK(INSTR_RSS_TABLE_IDX_bf), <<BF_L(INSTR_RSS_TABLE_IDX_bf)]
+
+    /* hash min(sport, dport) << 16 | max(sport, dport) */
+    alu[sym_data, --, B, l4_data, >>16]
+    ld_field_w_clr[sym_port, 0011, l4_data]
+    alu[--, sym_port, -, sym_data]
+    bhs[symmetric_l4_crc#], defer[1]
+        alu[sym_data, --, B, l4_data]
+
+    alu[sym_port, --, B, sym_port, <<16]
+    alu[sym_data, sym_port, OR, l4_data, >>16]
+
+symmetric_l4_crc#:
+    br[l4_hashed#], defer[1]
+        crc_be[crc_32, --, sym_data]
+
 finalize#:
     __actions_restore_t_idx()
 
@@ -922,6 +1444,227 @@ end#:
 #endm
 
 
+/* Header-data split offset. The length of the headers up to and including
+ * the innermost TCP or UDP header is passed in NIC_META_HDS, so the host
+ * can copy the headers out and keep the payload in the receive buffer. The
+ * packet itself is still delivered into a single freelist buffer. Anything
+ * else, or a packet without payload, is delivered without a split offset.
+ */
+#macro __actions_hds(io_pkt_vec)
+.begin
+    .reg hdr_len
+    .reg pkt_len
+    .reg tcp_w3
+
+    __actions_read()
+
+    br_bset[BF_A(io_pkt_vec, PV_PROTO_bf), 2, end#] ; PV_PROTO_bf
+    bitfield_extract__sz1(hdr_len, BF_AML(io_pkt_vec, PV_HEADER_OFFSET_INNER_L4_bf)) ; PV_HEADER_OFFSET_INNER_L4_bf
+    beq[end#]
+    br_bset[BF_AL(io_pkt_vec, PV_PROTO_UDP_bf), udp#] ; PV_PROTO_UDP_bf
+
+    pv_seek(io_pkt_vec, hdr_len)
+
+    byte_align_be[--, *$index++]
+    byte_align_be[--, *$index++]
+    byte_align_be[--, *$index++]
+    byte_align_be[--, *$index++]
+    byte_align_be[tcp_w3, *$index++]
+
+    __actions_restore_t_idx()
+
+    alu[tcp_w3, 0xf, AND, tcp_w3, >>BF_L(TCP_DATA_OFFSET_bf)]
+    br[payload#], defer[1]
+        alu[hdr_len, hdr_len, +, tcp_w3, <<2]
+
+udp#:
+    alu[hdr_len, hdr_len, +, 8]
+
+payload#:
+    pv_get_length(pkt_len, io_pkt_vec)
+    alu[--, hdr_len, -, pkt_len]
+    bhs[end#]
+
+    pv_meta_push_type__sz1(io_pkt_vec, NIC_META_HDS)
+    pv_meta_prepend(io_pkt_vec, hdr_len)
+
+end#:
+.end
+#endm
+
+
+/* Receive side coalescing of plain IPv4/TCP segments, see lro.h. The action
+ * always precedes TX_HOST and takes the host queue from its arguments.
+ *
+ * Segments are moved to their MU buffer and queued through GRO to the LRO ME
+ * context owning their flow, so that context sees the flow in wire order and
+ * coalesces it without locks or copies on this ME. Segments that can be
+ * coalesced carry NIC_META_LRO and are marked in the work queue
+ * descriptor, anything else is delivered by the LRO ME behind an aggregate
+ * of the same flow. Other packets continue to TX_HOST.
+ */
+#macro __actions_lro(io_pkt_vec, EGRESS_LABEL)
+.begin
+    .reg args
+    .reg buf_sz
+    .reg daddr
+    .reg doff
+    .reg hdr_end
+    .reg ip_w0
+    .reg l3_offset
+    .reg lro_idx
+    .reg lro_wq[NIC_LRO_WQ_DESC_LW]
+    .reg mergeable
+    .reg meta_len
+    .reg offset
+    .reg opt
+    .reg payload
+    .reg pci_isl
+    .reg pci_q
+    .reg pkt_len
+    .reg ports
+    .reg saddr
+    .reg tcp_w3
+    .reg tmp
+    .reg tx_args
+
+    __actions_read(args, 0xffff)
+    alu[args, args, AND~, 0x3, <<(BF_M(INSTR_LRO_MAX_LEN_bf) + 1)]
+
+    // host queue from the TX_HOST that follows
+    alu[tx_args, 0, +16, *$index]
+    #ifdef PV_MULTI_PCI
+        alu[pci_isl, 3, AND, tx_args, >>6]
+    #else
+        immed[pci_isl, 0]
+    #endif
+    alu[pci_q, tx_args, +8, BF_A(io_pkt_vec, PV_QUEUE_OFFSET_bf)]
+    alu[pci_q, pci_q, AND, 0x3f]
+
+    // plain IPv4/TCP to a unicast address with an MU buffer
+    br!=byte[BF_A(io_pkt_vec, PV_PROTO_bf), 0, PROTO_IPV4_TCP, end#] ; PV_PROTO_bf
+    br_bset[BF_AL(io_pkt_vec, PV_MAC_DST_MC_bf), end#] ; PV_MAC_DST_MC_bf
+    bitfield_extract__sz1(tmp, BF_AML(io_pkt_vec, PV_BLS_bf)) ; PV_BLS_bf
+    br=byte[tmp, 0, 3, end#]
+
+    bitfield_extract__sz1(l3_offset, BF_AML(io_pkt_vec, PV_HEADER_OFFSET_OUTER_IP_bf)) ; PV_HEADER_OFFSET_OUTER_IP_bf
+    pv_seek(io_pkt_vec, l3_offset)
+
+    byte_align_be[--, *$index++]
+    byte_align_be[ip_w0, *$index++]
+    byte_align_be[--, *$index++]
+    byte_align_be[--, *$index++]
+    byte_align_be[saddr, *$index++]
+    byte_align_be[daddr, *$index++]
+    byte_align_be[ports, *$index++]
+    byte_align_be[--, *$index++]
+    byte_align_be[--, *$index++]
+    byte_align_be[tcp_w3, *$index++]
+    byte_align_be[--, *$index++]
+    byte_align_be[opt, *$index++]
+
+    // IP options move the TCP header out of the words read above
+    alu[tmp, 0xf, AND, ip_w0, >>24]
+    alu[--, tmp, -, 5]
+    bne[restore#]
+
+    immed[mergeable, 0]
+
+    passert(BF_M(PV_TX_HOST_L3_bf), "EQ", (BF_L(PV_TX_HOST_CSUM_TCP_OK_bf) + 3))
+    alu[tmp, --, B, 0xf, <<BF_L(PV_TX_HOST_CSUM_TCP_OK_bf)]
+    alu[--, tmp, AND~, BF_A(io_pkt_vec, PV_TX_HOST_L3_bf)] ; PV_TX_HOST_L3_bf
+    bne[queue#]
+
+    // ACK only, any other flag ends the aggregate
+    alu[tmp, --, B, tcp_w3, >>BF_L(TCP_FLAGS_bf)]
+    alu[tmp, tmp, AND~, 0xf, <<12]
+    alu[--, tmp, XOR, NET_TCP_FLAG_ACK]
+    bne[queue#]
+
+    // no options or just the timestamp option
+    alu[doff, 0xf, AND, tcp_w3, >>BF_L(TCP_DATA_OFFSET_bf)]
+    alu[--, doff, -, 5]
+    beq[tcp_payload#]
+    alu[--, doff, -, 8]
+    bne[queue#]
+    move(tmp, 0x0101080a) // NOP, NOP, TS
+    alu[--, opt, XOR, tmp]
+    bne[queue#]
+
+tcp_payload#:
+    alu[hdr_end, l3_offset, +, 20]
+    alu[hdr_end, hdr_end, +, doff, <<2]
+    alu[payload, 0, +16, ip_w0]
+    alu[payload, payload, +, l3_offset]
+    alu[payload, payload, -, hdr_end]
+    ble[queue#]
+
+    // nothing trails the IP datagram and the segment fits an aggregate
+    pv_get_length(pkt_len, io_pkt_vec)
+    alu[tmp, hdr_end, +, payload]
+    alu[--, pkt_len, XOR, tmp]
+    bne[queue#]
+    alu[--, args, -, pkt_len]
+    blo[queue#]
+
+    // lro_fixup() updates the IP length and checksum as aligned words
+    alu[tmp, l3_offset, +16, BF_A(io_pkt_vec, PV_OFFSET_bf)] ; PV_OFFSET_bf
+    alu[tmp, tmp, AND, 3]
+    alu[--, tmp, XOR, 2]
+    bne[queue#]
+
+    immed[mergeable, 1]
+
+queue#:
+    lro_hash(lro_idx, saddr, daddr, ports)
+
+    // the LRO ME only reads the MU buffer
+    br_bclr[BF_AL(io_pkt_vec, PV_CTM_ALLOCATED_bf), meta#] ; PV_CTM_ALLOCATED_bf
+    bitfield_extract(tmp, BF_AML(io_pkt_vec, PV_NUMBER_bf)) ; PV_NUMBER_bf
+    pkt_buf_copy_ctm_to_mu_head(tmp, BF_A(io_pkt_vec, PV_MU_ADDR_bf), BF_A(io_pkt_vec, PV_OFFSET_bf))
+    pkt_buf_free_ctm_buffer(--, tmp)
+    bits_clr__sz1(BF_AL(io_pkt_vec, PV_CTM_ALLOCATED_bf), BF_MASK(PV_CTM_ALLOCATED_bf)) ; PV_CTM_ALLOCATED_bf
+
+meta#:
+    alu[--, --, B, mergeable]
+    beq[desc#]
+
+    // MSS and segment count, lro_fixup() rewrites the count
+    pv_meta_push_type__sz1(io_pkt_vec, NIC_META_LRO)
+    alu[tmp, 1, OR, payload, <<16]
+    pv_meta_prepend(io_pkt_vec, tmp)
+
+desc#:
+    pv_meta_write(meta_len, io_pkt_vec)
+    pv_get_required_host_buf_sz(buf_sz, io_pkt_vec, meta_len)
+
+    alu[lro_wq[NIC_LRO_WQ_BLS_wrd], BF_A(io_pkt_vec, PV_MU_ADDR_bf), AND~, ((BF_MASK(PV_SPLIT_bf) << BF_WIDTH(PV_CBS_bf)) | BF_MASK(PV_CBS_bf)), <<BF_L(PV_CBS_bf)]
+    bitfield_extract__sz1(tmp, BF_AML(io_pkt_vec, PV_BLS_bf)) ; PV_BLS_bf
+    alu[lro_wq[NIC_LRO_WQ_BLS_wrd], lro_wq[NIC_LRO_WQ_BLS_wrd], OR, tmp, <<NFD_OUT_BLS_shf]
+
+    alu[offset, BF_A(io_pkt_vec, PV_OFFSET_bf), -, meta_len] ; PV_OFFSET_bf
+    alu[lro_wq[NIC_LRO_WQ_LEN_wrd], buf_sz, OR, offset, <<BF_L(NIC_LRO_WQ_OFFSET_ODD_bf)]
+    alu[lro_wq[NIC_LRO_WQ_LEN_wrd], lro_wq[NIC_LRO_WQ_LEN_wrd], OR, meta_len, <<NFD_OUT_METALEN_shf]
+    alu[tmp, pci_q, OR, pci_isl, <<6]
+    alu[lro_wq[NIC_LRO_WQ_LEN_wrd], lro_wq[NIC_LRO_WQ_LEN_wrd], OR, tmp, <<NFD_OUT_QID_shf]
+
+    alu[lro_wq[NIC_LRO_WQ_INFO_wrd], --, B, BF_A(io_pkt_vec, PV_TX_FLAGS_bf), >>BF_L(PV_TX_FLAGS_bf)] ; PV_TX_FLAGS_bf
+    alu[lro_wq[NIC_LRO_WQ_INFO_wrd], lro_wq[NIC_LRO_WQ_INFO_wrd], OR, l3_offset, <<BF_L(NIC_LRO_WQ_L3_OFFSET_bf)]
+    alu[tmp, 0x7f, AND, offset, >>1]
+    alu[lro_wq[NIC_LRO_WQ_INFO_wrd], lro_wq[NIC_LRO_WQ_INFO_wrd], OR, tmp, <<BF_L(NIC_LRO_WQ_OFFSET_bf)]
+    alu[lro_wq[NIC_LRO_WQ_INFO_wrd], lro_wq[NIC_LRO_WQ_INFO_wrd], OR, mergeable, <<BF_L(NIC_LRO_WQ_MERGE_bf)]
+
+    lro_get_gro_workq_desc($__pkt_io_gro_meta, lro_idx, lro_wq)
+    pv_stats_tx_host(io_pkt_vec, pci_isl, pci_q, --, EGRESS_LABEL, --)
+
+restore#:
+    __actions_restore_t_idx()
+
+end#:
+.end
+#endm
+
+
 #macro actions_load(in_act_addr)
 .begin
     .reg pkt_vec_addr
@@ -937,6 +1680,10 @@ end#:
 
     pv_reset(pkt_vec_addr, in_act_addr, __actions_t_idx, (NIC_MAX_INSTR *4))
 
+    #ifdef ACTIONS_PROFILE
+        __actions_profile_begin(in_act_addr)
+    #endif
+
 .end
 #endm
 
@@ -949,7 +1696,7 @@ end#:
 
 next#:
     alu[jump_idx, --, B, *$index, >>INSTR_OPCODE_LSB]
-    jump[jump_idx, ins_0#], targets[ins_0#, ins_1#, ins_2#, ins_3#, ins_4#, ins_5#, ins_6#, ins_7#, ins_8#, ins_9#, ins_10#, ins_11#, ins_12#, ins_13#, ins_14#, ins_15#, ins_16#, ins_17#, ins_18#]
+    jump[jump_idx, ins_0#], targets[ins_0#, ins_1#, ins_2#, ins_3#, ins_4#, ins_5#, ins_6#, ins_7#, ins_8#, ins_9#, ins_10#, ins_11#, ins_12#, ins_13#, ins_14#, ins_15#, ins_16#, ins_17#, ins_18#, ins_19#, ins_20#, ins_21#, ins_22#]
 
     ins_0#: br[drop_act#]
     ins_1#: br[rx_wire#]
@@ -970,6 +1717,10 @@ next#:
     ins_16#: br[tx_vlan#]
     ins_17#: br[l2_switch_wire#]
     ins_18#: br[l2_switch_host#]
+    ins_19#: br[rx_wire_dmac_match#]
+    ins_20#: br[checksum_rss_tx_host#]
+    ins_21#: br[lro#]
+    ins_22#: br[hds#]
 
 error_pkt_stack#:
     pv_stats_update(io_pkt_vec, ERROR_PKT_STACK, drop#)
@@ -1058,6 +1809,32 @@ l2_switch_host#:
     __actions_l2_switch_host(io_pkt_vec)
     __actions_next()
 
+    /* Fused instructions, see cfg_act_fuse(). The constituent actions run
+     * back to back without testing the pipeline bit in between and must stay
+     * in opcode order so that RX_WIRE_DMAC_MATCH can pipeline into
+     * CHECKSUM_RSS_TX_HOST.
+     */
+rx_wire_dmac_match#:
+    __actions_rx_wire(io_pkt_vec)
+    __actions_dst_mac_match(io_pkt_vec, drop_mismatch#)
+    __actions_next()
+
+checksum_rss_tx_host#:
+    __actions_checksum(io_pkt_vec)
+    __actions_rss(io_pkt_vec)
+    __actions_read(tx_args, 0xffff)
+    pkt_io_tx_host(io_pkt_vec, tx_args, EGRESS_LABEL)
+    __actions_restore_t_idx()
+    __actions_next()
+
+lro#:
+    __actions_lro(io_pkt_vec, EGRESS_LABEL)
+    __actions_next()
+
+hds#:
+    __actions_hds(io_pkt_vec)
+    __actions_next()
+
 .end
 #endm
 
@@ -26,6 +26,42 @@
 
 #define VLAN_TO_VNICS_MAP_TBL_SIZE ((1<<12) * 8)
 
+/* Toeplitz RSS key tables, see upd_rss_key_table(). Each key has one row of
+ * 16 words per nibble of hash input (IPv6 addresses and L4 ports). */
+#define NIC_RSS_KEY_TBL_KEYS     2
+#define NIC_RSS_KEY_TBL_ROWS     ((16 + 16 + 4) * 2)
+#define NIC_RSS_KEY_TBL_KEY_SIZE (NIC_RSS_KEY_TBL_ROWS * 16 * 4)
+#define NIC_RSS_KEY_TBL_SIZE     (NIC_RSS_KEY_TBL_KEYS * NIC_RSS_KEY_TBL_KEY_SIZE)
+#define NIC_RSS_KEY_TBL_ADDR     (NIC_RSS_TBL_ADDR + 4096)
+
+#if (NIC_RSS_TBL_SIZE > 4096)
+    #error "NIC_RSS_TBL overlaps NIC_RSS_KEY_TBL"
+#endif
+
+/* RSS bucket activity, one bit per NIC_RSS_TBL entry set by the datapath for
+ * tables being rebalanced, see cfg_act_rss_rebalance(). */
+#define NIC_RSS_ACT_TBL_SIZE     (NIC_RSS_TBL_SIZE / 8)
+#define NIC_RSS_ACT_TBL_ADDR     (NIC_RSS_KEY_TBL_ADDR + NIC_RSS_KEY_TBL_SIZE)
+
+/* Host queues accepting UDP segmentation offload, one bit per
+ * (pcie << 6) | queue set while the vNIC has NIC_CFG_CTRL1_USO enabled,
+ * see cfg_act_write_uso() and __pv_lso_fixup(). */
+#define NIC_USO_QUEUE_TBL_SIZE   ((NFD_MAX_ISL * NUM_PCIE_Q) / 8)
+#define NIC_USO_QUEUE_TBL_ADDR   (NIC_RSS_ACT_TBL_ADDR + NIC_RSS_ACT_TBL_SIZE)
+
+/* Per island cache of resolved VEB lookups, see __actions_veb_lookup */
+#define NIC_VEB_CACHE_ENTRIES   256
+#define NIC_VEB_CACHE_SIZE      (NIC_VEB_CACHE_ENTRIES * NIC_MAX_INSTR * 4)
+#define NIC_VEB_CACHE_VALID_SHF 16
+
+/* Weights of the wire (NBI) and host (NFD) sources of pkt_io_rx, written to
+ * the worker NN registers by cfg_act_pkt_io_sched(). A source keeps priority
+ * for up to its weight of packets in a row, a weight of 0 counts as 1. */
+#define PKT_IO_SCHED_NN_IDX             112
+#define PKT_IO_SCHED_NBI_WEIGHT_shf     8
+#define PKT_IO_SCHED_NFD_WEIGHT_shf     0
+#define PKT_IO_SCHED_WEIGHT_MAX         255
+
 /* For host ports,
  *   use 0 to NIC_HOST_MAX_ENTRIES-1
  * For wire ports,
@@ -38,8 +74,19 @@
     .alloc_mem NIC_RSS_TBL cls+NIC_RSS_TBL_ADDR \
                 island NIC_RSS_TBL_SIZE addr40
 
+    .alloc_mem NIC_RSS_KEY_TBL cls+NIC_RSS_KEY_TBL_ADDR \
+                island NIC_RSS_KEY_TBL_SIZE addr40
+
+    .alloc_mem NIC_RSS_ACT_TBL cls+NIC_RSS_ACT_TBL_ADDR \
+                island NIC_RSS_ACT_TBL_SIZE addr40
+
+    .alloc_mem NIC_USO_QUEUE_TBL cls+NIC_USO_QUEUE_TBL_ADDR \
+                island NIC_USO_QUEUE_TBL_SIZE addr40
+
     .alloc_mem _vf_vlan_cache ctm island VLAN_TO_VNICS_MAP_TBL_SIZE 65536
 
+    .alloc_mem _veb_cache ctm island NIC_VEB_CACHE_SIZE NIC_VEB_CACHE_SIZE
+
     /* PCIe Queue RX BUF SZ table*/
     .alloc_mem _fl_buf_sz_cache imem global (64*4*4) 256
 
@@ -57,11 +104,34 @@
             island NIC_RSS_TBL_SIZE addr40
     }
 
+    __asm
+    {
+        .alloc_mem NIC_RSS_KEY_TBL cls + NIC_RSS_KEY_TBL_ADDR \
+            island NIC_RSS_KEY_TBL_SIZE addr40
+    }
+
+    __asm
+    {
+        .alloc_mem NIC_RSS_ACT_TBL cls + NIC_RSS_ACT_TBL_ADDR \
+            island NIC_RSS_ACT_TBL_SIZE addr40
+    }
+
+    __asm
+    {
+        .alloc_mem NIC_USO_QUEUE_TBL cls + NIC_USO_QUEUE_TBL_ADDR \
+            island NIC_USO_QUEUE_TBL_SIZE addr40
+    }
+
     __asm
     {
         .alloc_mem _vf_vlan_cache ctm island VLAN_TO_VNICS_MAP_TBL_SIZE 65536
     }
 
+    __asm
+    {
+        .alloc_mem _veb_cache ctm island NIC_VEB_CACHE_SIZE NIC_VEB_CACHE_SIZE
+    }
+
     /* PCIe Queue RX BUF SZ table*/
     __asm
     {
@@ -102,6 +172,10 @@
     #define    INSTR_TX_VLAN           16
     #define    INSTR_L2_SWITCH_WIRE    17
     #define    INSTR_L2_SWITCH_HOST    18
+    #define    INSTR_RX_WIRE_DMAC_MATCH    19
+    #define    INSTR_CHECKSUM_RSS_TX_HOST  20
+    #define    INSTR_LRO               21
+    #define    INSTR_HDS               22
 #elif defined(__NFP_LANG_MICROC)
 enum instruction_ops {
     INSTR_DROP = 0,
@@ -122,7 +196,11 @@ enum instruction_ops {
     INSTR_PUSH_PKT,
     INSTR_TX_VLAN,
     INSTR_L2_SWITCH_WIRE,
-    INSTR_L2_SWITCH_HOST
+    INSTR_L2_SWITCH_HOST,
+    INSTR_RX_WIRE_DMAC_MATCH,
+    INSTR_CHECKSUM_RSS_TX_HOST,
+    INSTR_LRO,
+    INSTR_HDS
 };
 
 /* this maping will eventually be replaced at build time with actual offsets
@@ -197,15 +275,23 @@ enum instruction_ops {
  * Word   1 0 9 8 7 6 5 4 3 2 1 0 9 8 7 6 5 4 3 2 1 0 9 8 7 6 5 4 3 2 1 0
  *       +-----------------------------+-+-+-+-+-+---------+-+-+---------+
  *    0  |              4              |P|u|t|U|T| Tbl idx |1| MAX Queue |
- *       +---------------+-------------+-+-+-+-+-+---------+-+-+---------+
- *    1  |                            RSS Key                            |
- *       +---------------------------------------------------------------+
+ *       +-+-+-+-+-------+-------------+-+-+-+-+-+---------+-+-+---------+
+ *    1  |Z|R|S|A|                      RSS Key                          |
+ *       +-+-+-+-+-------------------------------------------------------+
  *
  *       u - Enable IPV4_UDP
  *       t - Enable IPV4_TCP
  *       U - Enable IPV6_UDP
  *       T - Enable IPV6_TCP
  *       1 - RSSv1
+ *       Z - Toeplitz hash, RSS Key holds the CLS address of the key tables
+ *           in NIC_RSS_KEY_TBL instead of the CRC32 seed
+ *       R - Rebalanced table, mark the selected bucket in NIC_RSS_ACT_TBL
+ *       S - Symmetric CRC32 hash, both directions of a flow hash alike
+ *       A - The vNIC has aRFS entries, look TCP and UDP flows up in
+ *           _nic_arfs_tbl before the RSS table
+ *
+ *       CRC32 is seeded with the RSS Key bits only, Z, R, S and A are masked.
  *
  * INSTR_CHECKSUM:
  * Bit \  3 3 2 2 2 2 2 2 2 2 2 2 1 1 1 1 1 1 1 1 1 1 0 0 0 0 0 0 0 0 0 0
@@ -314,6 +400,58 @@ enum instruction_ops {
  *       +-----------------------------+-+-------------------------------+
  *    0  |              18             |P|                               |
  *       +-----------------------------+-+-------------------------------+
+ *
+ * Fused instructions (superinstructions) are not appended directly, they are
+ * substituted by cfg_act_fuse() for common chains of instructions. The
+ * argument words of the constituent instructions are kept in place, only the
+ * opcode of the first word is replaced.
+ *
+ * INSTR_RX_WIRE_DMAC_MATCH:
+ * Bit \  3 3 2 2 2 2 2 2 2 2 2 2 1 1 1 1 1 1 1 1 1 1 0 0 0 0 0 0 0 0 0 0
+ * Word   1 0 9 8 7 6 5 4 3 2 1 0 9 8 7 6 5 4 3 2 1 0 9 8 7 6 5 4 3 2 1 0
+ *       +-----------------------------+-+-------------------------------+
+ *    0  |              19             |P|         RX_WIRE args          |
+ *       +-----------------------------+-+-------------------------------+
+ *    1  |      INSTR_DST_MAC_MATCH    |X|            MAC HI             |
+ *       +-----------------------------+-+-------------------------------+
+ *    2  |                            MAC LO                             |
+ *       +---------------------------------------------------------------+
+ *
+ * INSTR_CHECKSUM_RSS_TX_HOST:
+ * Bit \  3 3 2 2 2 2 2 2 2 2 2 2 1 1 1 1 1 1 1 1 1 1 0 0 0 0 0 0 0 0 0 0
+ * Word   1 0 9 8 7 6 5 4 3 2 1 0 9 8 7 6 5 4 3 2 1 0 9 8 7 6 5 4 3 2 1 0
+ *       +-----------------------------+-+-------------------------------+
+ *    0  |              20             |P|         CHECKSUM args         |
+ *       +-----------------------------+-+-------------------------------+
+ *    1  |          INSTR_RSS          |X|           RSS args            |
+ *       +-----------------------------+-+-------------------------------+
+ *    2  |                            RSS Key                            |
+ *       +-----------------------------+-+-------------------------------+
+ *    3  |        INSTR_TX_HOST        |X|          TX_HOST args         |
+ *       +-----------------------------+-+-------------------------------+
+ *
+ *       X = Ignored
+ *
+ * INSTR_LRO:
+ * Bit \  3 3 2 2 2 2 2 2 2 2 2 2 1 1 1 1 1 1 1 1 1 1 0 0 0 0 0 0 0 0 0 0
+ * Word   1 0 9 8 7 6 5 4 3 2 1 0 9 8 7 6 5 4 3 2 1 0 9 8 7 6 5 4 3 2 1 0
+ *       +-----------------------------+-+---+---------------------------+
+ *    0  |              21             |P| 0 |          MAX LEN          |
+ *       +-----------------------------+-+---+---------------------------+
+ *
+ * MAX LEN - Upper bound on the length of an aggregate, excluding metadata.
+ * Always immediately followed by INSTR_TX_HOST.
+ *
+ * INSTR_HDS:
+ * Bit \  3 3 2 2 2 2 2 2 2 2 2 2 1 1 1 1 1 1 1 1 1 1 0 0 0 0 0 0 0 0 0 0
+ * Word   1 0 9 8 7 6 5 4 3 2 1 0 9 8 7 6 5 4 3 2 1 0 9 8 7 6 5 4 3 2 1 0
+ *       +-----------------------------+-+-------------------------------+
+ *    0  |              22             |P|           Reserved            |
+ *       +-----------------------------+-+-------------------------------+
+ *
+ * Prepends the header length as NIC_META_HDS metadata, ahead of LRO and
+ * TX_HOST. Only the split offset is provided, the packet is not scattered
+ * over separate header and payload buffers.
  */
 
 /* Instruction format of NIC_CFG_INSTR_TBL table. Some 32-bit words will
@@ -335,7 +473,11 @@ typedef union {
         uint32_t tbl_idx : 5;
         uint32_t v1_meta : 1;
         uint32_t max_queue : 6;
-        uint32_t key;
+        uint32_t toeplitz : 1;
+        uint32_t rebalance : 1;
+        uint32_t symmetric : 1;
+        uint32_t arfs : 1;
+        uint32_t key : 28;
     };
     uint32_t __raw[2];
 } instr_rss_t;
@@ -414,6 +556,16 @@ typedef union {
     };
     uint32_t __raw[1];
 } instr_checksum_t;
+
+typedef union {
+    struct {
+        uint32_t op: 15;
+        uint32_t pipeline: 1;
+        uint32_t reserved: 2;
+        uint32_t max_len: 14;
+    };
+    uint32_t __raw[1];
+} instr_lro_t;
 #endif
 
 #define INSTR_PIPELINE_BIT 16
@@ -423,7 +575,12 @@ typedef union {
 #define INSTR_RSS_TABLE_IDX_bf  0, 11, 7
 #define INSTR_RSS_V1_META_bf    0, 6, 6
 #define INSTR_RSS_MAX_QUEUE_bf  0, 5, 0
-#define INSTR_RSS_KEY_bf        1, 31, 0
+#define INSTR_RSS_TOEPLITZ_bf   1, 31, 31
+#define INSTR_RSS_REBALANCE_bf  1, 30, 30
+#define INSTR_RSS_SYMMETRIC_bf  1, 29, 29
+#define INSTR_RSS_ARFS_bf       1, 28, 28
+#define INSTR_RSS_KEY_bf        1, 27, 0
+#define INSTR_RSS_KEY_TBL_bf    1, 15, 0
 
 #define INSTR_RX_HOST_MTU_bf     0, 15, 2
 
@@ -451,6 +608,8 @@ typedef union {
 #define INSTR_DEL_OFFSET_bf      0, 14, 8
 #define INSTR_DEL_LENGTH_bf      0, 7, 0
 
+#define INSTR_LRO_MAX_LEN_bf     0, 13, 0
+
 #if defined(__NFP_LANG_ASM)
 
     #define __LOOP 0
@@ -34,6 +34,7 @@
 #include "app_config_tables.h"
 #include "app_config_instr.h"
 #include "ebpf.h"
+#include "lro.h"
 #include "nic_tables.h"
 
 /*
@@ -56,6 +57,12 @@
     Wire -> PF (promisc)
     RX_WIRE -> CHECKSUM(C) -> BPF -> RSS -> TX_HOST(PF)
 
+    Wire -> PF (LRO)
+    RX_WIRE -> MAC_MATCH -> BPF -> RSS -> LRO -> TX_HOST(PF)
+
+    Wire -> PF (header-data split)
+    RX_WIRE -> MAC_MATCH -> BPF -> RSS -> HDS -> LRO -> TX_HOST(PF)
+
     Host -> Wire
     RX_HOST -> CHECKSUM(I) -> TX_WIRE
 
@@ -103,6 +110,13 @@
 
     VF->PF
     RX_HOST -> VEB_LOOKUP -hit-> [CHECKSUM(O,I,C) -> BPF -> RSS -> TX_HOST(PF)]
+
+
+    ** FUSED INSTRUCTIONS **
+    Applied by cfg_act_fuse() when the lists above are written
+
+    RX_WIRE -> MAC_MATCH            => RX_WIRE_DMAC_MATCH
+    CHECKSUM -> RSS -> TX_HOST      => CHECKSUM_RSS_TX_HOST
  */
 
 uint32_t cfg_act_map[] = {
@@ -260,7 +274,8 @@ void ct_nn_write(__xwrite void *xfer,
 
 /* Write the RSS table to NN registers for all MEs */
 /* RSS table uses 0-63 NN registers (max of 2 VNIC ports, 1 RSS tbl per port) */
-/* HASH table uses 64-103, EPOCH uses NN 127  */
+/* HASH table uses 64-103, VXLAN ports 104-111, pkt_io_rx weights 112-113,
+ * EPOCH uses NN 127  */
 __intrinsic void
 upd_nn_table_instr(__xwrite uint32_t *xwr_instr, uint32_t start_offset,
                    uint32_t count)
@@ -466,6 +481,10 @@ upd_ctm_vlan_members(uint32_t pcie)
 }
 
 
+/* Bumped whenever the host rewrites an RSS table, the rebalancer abandons
+ * changes based on an older copy of the table. */
+__shared __lmem uint32_t rss_tbl_gen = 0;
+
 //for each port there must be call to this.
 //for each port size of table must be known and configured accordingly
 __intrinsic
@@ -487,9 +506,481 @@ void upd_rss_table(uint32_t start_offset, __emem __addr40 uint8_t *bar_base,
     for (i = 0; i < RSS_TBL_SIZE_LW; i++)
         rss_wr[i] = rss_rd[i];
 
+    rss_tbl_gen++;
     wr_rss_tbl(rss_wr, start_offset, RSS_TBL_SIZE_LW);
 }
 
+
+/* Toeplitz key held by each NIC_RSS_KEY_TBL slot, bitmask of slots with
+ * loaded tables and slot + 1 used by each RSS table, 0 if it uses CRC32. */
+#define RSS_KEY_SZ_wrd  (NFP_NET_CFG_RSS_KEY_SZ / sizeof(uint32_t))
+#define RSS_TBL_COUNT   (NIC_RSS_TBL_SIZE / NFP_NET_CFG_RSS_ITBL_SZ)
+
+__shared __lmem uint32_t rss_key_tbl_keys[NIC_RSS_KEY_TBL_KEYS][RSS_KEY_SZ_wrd];
+__shared __lmem uint32_t rss_key_tbl_loaded = 0;
+__shared __lmem uint32_t rss_key_tbl_slot[RSS_TBL_COUNT];
+
+/* Write Toeplitz key table rows */
+__intrinsic void
+wr_rss_key_tbl(__xwrite uint32_t *xwr_rss, uint32_t start_offset,
+               uint32_t count)
+{
+    __cls __addr32 void *nic_rss_key_tbl = (__cls __addr32 void*)
+                                            __link_sym("NIC_RSS_KEY_TBL");
+    SIGNAL sig;
+    uint32_t addr_hi;
+    uint32_t addr_lo;
+    uint32_t isl;
+    struct nfp_mecsr_prev_alu ind;
+
+    ctassert(count <= 32);
+
+    for (isl = 0; isl < sizeof(app_isl_ids) / sizeof(uint32_t); isl++) {
+        addr_lo = (uint32_t) nic_rss_key_tbl + start_offset;
+        addr_hi = app_isl_ids[isl] >> 4; /* only use island, mask out ME */
+        addr_hi = (addr_hi << (34 - 8)); /* address shifted by 8 in instr */
+
+        ind.__raw = 0;
+        ind.ov_len = 1;
+        ind.length = count - 1;
+        __asm {
+            alu[--, --, B, ind.__raw]
+            cls[write, *xwr_rss, addr_hi, <<8, addr_lo, \
+                __ct_const_val(count)], ctx_swap[sig], indirect_ref
+        }
+    }
+}
+
+/* 32 bits of the Toeplitz key starting at bit offset (MSB first) */
+__intrinsic uint32_t
+rss_key_window(__lmem uint32_t *key, uint32_t offset)
+{
+    uint32_t wrd = offset >> 5;
+    uint32_t shf = offset & 31;
+
+    if (shf == 0)
+        return key[wrd];
+
+    return (key[wrd] << shf) | (key[wrd + 1] >> (32 - shf));
+}
+
+/* Precompute the Toeplitz tables of a key slot in NIC_RSS_KEY_TBL. Row r
+ * holds, for every value of the r-th nibble of hash input, the XOR of the
+ * key windows selected by the bits set in the nibble. The datapath then
+ * computes the hash with one lookup per input nibble. */
+__intrinsic void
+upd_rss_key_table(uint32_t slot, __lmem uint32_t *key)
+{
+    __xwrite uint32_t key_wr[32];
+    uint32_t window[4];
+    uint32_t entry;
+    uint32_t row, i, j, b;
+
+    for (row = 0; row < NIC_RSS_KEY_TBL_ROWS; row += 2) {
+        for (i = 0; i < 2; i++) {
+            for (b = 0; b < 4; b++)
+                window[b] = rss_key_window(key, (row + i) * 4 + b);
+
+            for (j = 0; j < 16; j++) {
+                entry = 0;
+                for (b = 0; b < 4; b++) {
+                    if (j & (8 >> b))
+                        entry ^= window[b];
+                }
+                key_wr[i * 16 + j] = entry;
+            }
+        }
+
+        wr_rss_key_tbl(key_wr, slot * NIC_RSS_KEY_TBL_KEY_SIZE + row * 64, 32);
+    }
+}
+
+/* Find the NIC_RSS_KEY_TBL slot for the Toeplitz key of an RSS table.
+ * Tables with the same key (the Linux default) share a slot, otherwise a
+ * slot not used by any other table is loaded with the key. Returns -1 if
+ * all slots hold the keys of other tables. */
+__intrinsic int
+rss_key_tbl_assign(uint32_t rss_tbl_idx, __lmem uint32_t *key)
+{
+    uint32_t users[NIC_RSS_KEY_TBL_KEYS];
+    uint32_t i, slot;
+    int free_slot = -1;
+
+    for (slot = 0; slot < NIC_RSS_KEY_TBL_KEYS; slot++)
+        users[slot] = 0;
+
+    for (i = 0; i < RSS_TBL_COUNT; i++) {
+        if (i != rss_tbl_idx && rss_key_tbl_slot[i])
+            users[rss_key_tbl_slot[i] - 1]++;
+    }
+
+    for (slot = 0; slot < NIC_RSS_KEY_TBL_KEYS; slot++) {
+        if (rss_key_tbl_loaded & (1 << slot)) {
+            for (i = 0; i < RSS_KEY_SZ_wrd; i++) {
+                if (rss_key_tbl_keys[slot][i] != key[i])
+                    break;
+            }
+
+            if (i == RSS_KEY_SZ_wrd) {
+                rss_key_tbl_slot[rss_tbl_idx] = slot + 1;
+                return slot;
+            }
+        }
+
+        if (free_slot < 0 && users[slot] == 0)
+            free_slot = slot;
+    }
+
+    if (free_slot < 0) {
+        rss_key_tbl_slot[rss_tbl_idx] = 0;
+        cfg_error_rss_cntr++;
+        return -1;
+    }
+
+    slot = free_slot;
+    for (i = 0; i < RSS_KEY_SZ_wrd; i++)
+        rss_key_tbl_keys[slot][i] = key[i];
+    upd_rss_key_table(slot, key);
+    rss_key_tbl_loaded |= (1 << slot);
+    rss_key_tbl_slot[rss_tbl_idx] = slot + 1;
+
+    return slot;
+}
+
+/* Give up the key table slot of a PF's RSS table once the PF goes down or
+ * stops hashing, so the slot can be loaded with another key. */
+__intrinsic void
+rss_key_tbl_release(uint32_t pcie, uint32_t vid)
+{
+    uint32_t type, vnic;
+
+    NFD_VID2VNIC(type, vnic, vid);
+    rss_key_tbl_slot[vnic + pcie * NS_PLATFORM_NUM_PORTS] = 0;
+}
+
+/* RSS tables of the vNICs with aRFS entries, as last read from
+ * _nic_arfs_vnics, see cfg_act_arfs_sync() */
+__shared __lmem uint32_t arfs_vnics = 0;
+
+uint32_t
+cfg_act_arfs_sync()
+{
+    __xread uint32_t vnics;
+    __emem __addr40 uint32_t *nic_arfs_vnics =
+        (__emem __addr40 uint32_t *) __link_sym("_nic_arfs_vnics");
+    uint32_t changed;
+
+    mem_read32(&vnics, nic_arfs_vnics, sizeof(vnics));
+    changed = vnics ^ arfs_vnics;
+    arfs_vnics = vnics;
+
+    return changed;
+}
+
+/* RSS rebalancing, see cfg_act_rss_rebalance() */
+#define RSS_REBAL_TICKS_PER_MS  (NS_PLATFORM_TCLK * 1000 / 16)
+#define RSS_REBAL_TBL_COUNT     RSS_TBL_COUNT
+#define RSS_REBAL_ACT_SZ_wrd    (NFP_NET_CFG_RSS_ITBL_SZ / 32)
+
+__export __emem struct rss_rebal_cfg abi_rss_rebalance = {
+    0,      /* vnic_mask */
+    100,    /* interval_ms */
+    24,     /* threshold, 1.5 times the mean */
+    1000,   /* min_load */
+    4,      /* max_moves */
+    0,      /* flags */
+    0,      /* moves */
+    0
+};
+
+/* Tables marking bucket activity, tables with a load snapshot, the time of
+ * the last round and the per queue counters sampled on it. */
+__shared __lmem uint32_t rss_rebal_tbls = 0;
+__shared __lmem uint32_t rss_rebal_primed = 0;
+__shared __lmem uint32_t rss_rebal_last = 0;
+__shared __lmem uint32_t rss_rebal_interval = 0;
+__shared __lmem uint32_t rss_rebal_moves = 0;
+__shared __lmem uint32_t rss_rebal_tbl[RSS_TBL_SIZE_LW];
+__shared __lmem uint32_t rss_rebal_act[RSS_REBAL_ACT_SZ_wrd];
+__shared __lmem uint32_t rss_rebal_load[NUM_PCIE_Q_PER_PORT];
+__emem uint32_t rss_rebal_prev[RSS_REBAL_TBL_COUNT][NUM_PCIE_Q_PER_PORT];
+
+/* Enable bucket activity marking if the host wants the table rebalanced */
+__intrinsic uint32_t
+rss_rebal_enable(uint32_t rss_tbl_idx)
+{
+    __xread uint32_t vnic_mask;
+
+    ctassert(RSS_REBAL_TBL_COUNT <= 32);
+
+    if (rss_tbl_idx >= RSS_REBAL_TBL_COUNT)
+        return 0;
+
+    mem_read32(&vnic_mask, &abi_rss_rebalance.vnic_mask, sizeof(vnic_mask));
+
+    rss_rebal_primed &= ~(1 << rss_tbl_idx);
+    if (vnic_mask & (1 << rss_tbl_idx)) {
+        rss_rebal_tbls |= (1 << rss_tbl_idx);
+        return 1;
+    }
+
+    rss_rebal_tbls &= ~(1 << rss_tbl_idx);
+    return 0;
+}
+
+/* Read back an RSS table from the first worker island */
+__intrinsic void
+rd_rss_tbl(__xread uint32_t *xrd_rss, uint32_t start_offset, uint32_t count)
+{
+    __cls __addr32 void *nic_rss_tbl = (__cls __addr32 void*)
+                                        __link_sym("NIC_RSS_TBL");
+    SIGNAL sig;
+    uint32_t addr_hi;
+    uint32_t addr_lo;
+    struct nfp_mecsr_prev_alu ind;
+
+    ctassert(count <= 32);
+
+    addr_lo = (uint32_t) nic_rss_tbl + start_offset;
+    addr_hi = app_isl_ids[0] >> 4; /* only use island, mask out ME */
+    addr_hi = (addr_hi << (34 - 8)); /* address shifted by 8 in instr */
+
+    ind.__raw = 0;
+    ind.ov_len = 1;
+    ind.length = count - 1;
+    __asm {
+        alu[--, --, B, ind.__raw]
+        cls[read, *xrd_rss, addr_hi, <<8, addr_lo, \
+            __ct_const_val(count)], ctx_swap[sig], indirect_ref
+    }
+}
+
+/* Collect and clear the bucket activity of an RSS table on all islands */
+__intrinsic void
+rss_rebal_collect(uint32_t rss_tbl_idx)
+{
+    __cls __addr32 void *nic_rss_act_tbl = (__cls __addr32 void*)
+                                            __link_sym("NIC_RSS_ACT_TBL");
+    __xrw uint32_t act[RSS_REBAL_ACT_SZ_wrd];
+    SIGNAL sig;
+    uint32_t addr_hi;
+    uint32_t addr_lo;
+    uint32_t isl;
+    uint32_t i;
+
+    for (i = 0; i < RSS_REBAL_ACT_SZ_wrd; i++)
+        rss_rebal_act[i] = 0;
+
+    addr_lo = (uint32_t) nic_rss_act_tbl +
+              rss_tbl_idx * RSS_REBAL_ACT_SZ_wrd * sizeof(uint32_t);
+
+    for (isl = 0; isl < sizeof(app_isl_ids) / sizeof(uint32_t); isl++) {
+        addr_hi = app_isl_ids[isl] >> 4; /* only use island, mask out ME */
+        addr_hi = (addr_hi << (34 - 8)); /* address shifted by 8 in instr */
+
+        for (i = 0; i < RSS_REBAL_ACT_SZ_wrd; i++)
+            act[i] = 0xffffffff;
+
+        __asm {
+            cls[test_and_clear, *act, addr_hi, <<8, addr_lo, \
+                __ct_const_val(RSS_REBAL_ACT_SZ_wrd)], ctx_swap[sig]
+        }
+
+        for (i = 0; i < RSS_REBAL_ACT_SZ_wrd; i++)
+            rss_rebal_act[i] |= act[i];
+    }
+}
+
+/* Write one RSS table word on all islands. Returns non-zero, leaving the
+ * word to the host, if the host rewrote the table since generation gen. */
+__intrinsic int
+wr_rss_tbl_word(uint32_t start_offset, uint32_t value, uint32_t gen)
+{
+    __cls __addr32 void *nic_rss_tbl = (__cls __addr32 void*)
+                                        __link_sym("NIC_RSS_TBL");
+    __xwrite uint32_t xwr_rss;
+    SIGNAL sig;
+    uint32_t addr_hi;
+    uint32_t addr_lo;
+    uint32_t isl;
+
+    xwr_rss = value;
+    addr_lo = (uint32_t) nic_rss_tbl + start_offset;
+
+    for (isl = 0; isl < sizeof(app_isl_ids) / sizeof(uint32_t); isl++) {
+        if (rss_tbl_gen != gen)
+            return 1;
+
+        addr_hi = app_isl_ids[isl] >> 4; /* only use island, mask out ME */
+        addr_hi = (addr_hi << (34 - 8)); /* address shifted by 8 in instr */
+
+        __asm {
+            cls[write, xwr_rss, addr_hi, <<8, addr_lo, 1], ctx_swap[sig]
+        }
+    }
+
+    return 0;
+}
+
+/* Rebalance one RSS table. Queue loads are the deltas of the per queue RX
+ * counters in the control BAR since the previous round. Only entries whose
+ * buckets saw no packets since the previous round are moved, so flows in
+ * flight keep their queue. Returns the number of entries moved. */
+__intrinsic uint32_t
+rss_rebal_tbl_update(uint32_t rss_tbl_idx, __xread struct rss_rebal_cfg *cfg)
+{
+    __xread uint32_t rss_rd[RSS_TBL_SIZE_LW];
+    __xread uint32_t stats[4];
+    __emem __addr40 uint8_t *bar_base;
+    uint64_t queues = 0;
+    uint64_t hot_load, mean_load;
+    uint32_t start_offset = rss_tbl_idx * NFP_NET_CFG_RSS_ITBL_SZ;
+    uint32_t gen = rss_tbl_gen;
+    uint32_t cur, sum, n;
+    uint32_t hot = 0;
+    uint32_t cold = 0;
+    uint32_t dirty = 0;
+    uint32_t moves = 0;
+    uint32_t q, b, shf;
+
+    rd_rss_tbl(rss_rd, start_offset, RSS_TBL_SIZE_LW);
+    for (b = 0; b < RSS_TBL_SIZE_LW; b++)
+        rss_rebal_tbl[b] = rss_rd[b];
+
+    rss_rebal_collect(rss_tbl_idx);
+
+    /* Queue of bucket b is byte b of the table, MSB first in each word */
+    for (b = 0; b < NFP_NET_CFG_RSS_ITBL_SZ; b++) {
+        q = (rss_rebal_tbl[b >> 2] >> (24 - 8 * (b & 3))) & 0xff;
+        if (q >= NUM_PCIE_Q_PER_PORT)
+            return 0;
+        queues |= (1ull << q);
+    }
+
+    /* Counters are 64-bit little endian, word 0 holds the low 32 bits */
+    bar_base = nfd_cfg_bar_base(rss_tbl_idx / NS_PLATFORM_NUM_PORTS,
+                                NFD_PF2VID(rss_tbl_idx % NS_PLATFORM_NUM_PORTS));
+    sum = 0;
+    n = 0;
+    for (q = 0; q < NUM_PCIE_Q_PER_PORT; q++) {
+        if (!(queues & (1ull << q)))
+            continue;
+
+        mem_read32(stats, bar_base + NFP_NET_CFG_RXR_STATS(q), sizeof(stats));
+        cur = (cfg->flags & RSS_REBAL_FLAG_BYTES) ? stats[2] : stats[0];
+        rss_rebal_load[q] = cur - rss_rebal_prev[rss_tbl_idx][q];
+        rss_rebal_prev[rss_tbl_idx][q] = cur;
+
+        if (n == 0 || rss_rebal_load[q] > rss_rebal_load[hot])
+            hot = q;
+        if (n == 0 || rss_rebal_load[q] < rss_rebal_load[cold])
+            cold = q;
+        sum += rss_rebal_load[q];
+        n++;
+    }
+
+    if (!(rss_rebal_primed & (1 << rss_tbl_idx))) {
+        rss_rebal_primed |= (1 << rss_tbl_idx);
+        return 0;
+    }
+
+    if (n < 2 || rss_rebal_load[hot] < cfg->min_load)
+        return 0;
+
+    hot_load = (uint64_t) rss_rebal_load[hot] * 16;
+    mean_load = (uint64_t) (sum / n) * cfg->threshold;
+    if (hot_load <= mean_load)
+        return 0;
+
+    for (b = 0; b < NFP_NET_CFG_RSS_ITBL_SZ && moves < cfg->max_moves; b++) {
+        if (rss_rebal_act[b >> 5] & (1 << (b & 31)))
+            continue;
+
+        shf = 24 - 8 * (b & 3);
+        if (((rss_rebal_tbl[b >> 2] >> shf) & 0xff) != hot)
+            continue;
+
+        rss_rebal_tbl[b >> 2] &= ~(0xff << shf);
+        rss_rebal_tbl[b >> 2] |= (cold << shf);
+        dirty |= (1 << (b >> 2));
+        moves++;
+    }
+
+    for (b = 0; b < RSS_TBL_SIZE_LW; b++) {
+        if (!(dirty & (1 << b)))
+            continue;
+
+        if (wr_rss_tbl_word(start_offset + b * sizeof(uint32_t),
+                            rss_rebal_tbl[b], gen))
+            return 0;
+    }
+
+    return moves;
+}
+
+void
+cfg_act_rss_rebalance()
+{
+    __xread struct rss_rebal_cfg cfg;
+    __xwrite uint32_t moves;
+    uint32_t now;
+    uint32_t tbl;
+
+    now = local_csr_read(local_csr_timestamp_low);
+    if (now - rss_rebal_last < rss_rebal_interval)
+        return;
+
+    mem_read32(&cfg, &abi_rss_rebalance, sizeof(cfg));
+    rss_rebal_last = now;
+    rss_rebal_interval = cfg.interval_ms * RSS_REBAL_TICKS_PER_MS;
+
+    for (tbl = 0; tbl < RSS_REBAL_TBL_COUNT; tbl++) {
+        if (rss_rebal_tbls & cfg.vnic_mask & (1 << tbl))
+            rss_rebal_moves += rss_rebal_tbl_update(tbl, &cfg);
+    }
+
+    moves = rss_rebal_moves;
+    mem_write32(&moves, &abi_rss_rebalance.moves, sizeof(moves));
+}
+
+/* Receive scheduling weights, see cfg_act_pkt_io_sched() */
+__export __emem struct pkt_io_sched_cfg abi_pkt_io_sched = {
+    1,      /* nbi_weight */
+    1,      /* nfd_weight */
+};
+
+/* Weights last written to the worker NN registers */
+__shared __lmem uint32_t pkt_io_sched_nn = 0;
+
+void
+cfg_act_pkt_io_sched()
+{
+    __xread struct pkt_io_sched_cfg cfg;
+    __xwrite uint32_t xwr_nn_info[2];
+    uint32_t nbi_weight;
+    uint32_t nfd_weight;
+    uint32_t nn;
+
+    mem_read32(&cfg, &abi_pkt_io_sched, sizeof(cfg));
+
+    nbi_weight = cfg.nbi_weight;
+    if (nbi_weight > PKT_IO_SCHED_WEIGHT_MAX)
+        nbi_weight = PKT_IO_SCHED_WEIGHT_MAX;
+    nfd_weight = cfg.nfd_weight;
+    if (nfd_weight > PKT_IO_SCHED_WEIGHT_MAX)
+        nfd_weight = PKT_IO_SCHED_WEIGHT_MAX;
+
+    nn = (nbi_weight << PKT_IO_SCHED_NBI_WEIGHT_shf) |
+         (nfd_weight << PKT_IO_SCHED_NFD_WEIGHT_shf);
+    if (nn == pkt_io_sched_nn)
+        return;
+
+    xwr_nn_info[0] = nn;
+    xwr_nn_info[1] = 0;
+    upd_nn_table_instr(xwr_nn_info, PKT_IO_SCHED_NN_IDX, 2);
+    pkt_io_sched_nn = nn;
+}
+
 __intrinsic void
 upd_slicc_hash_table(void)
 {
@@ -587,11 +1078,68 @@ cfg_act_write_queue(uint32_t qid, action_list_t *acts)
 }
 
 
+/* Number of words occupied by an instruction including its argument words */
+__intrinsic uint32_t
+cfg_act_len(uint32_t op)
+{
+    switch (op) {
+    case INSTR_DST_MAC_MATCH:
+    case INSTR_SRC_MAC_MATCH:
+    case INSTR_VEB_LOOKUP:
+    case INSTR_RSS:
+        return 2;
+    case INSTR_RX_WIRE_DMAC_MATCH:
+        return 3;
+    case INSTR_CHECKSUM_RSS_TX_HOST:
+        return 4;
+    default:
+        return 1;
+    }
+}
+
+
+/* Replace common chains of instructions with fused instructions so that the
+ * worker executes them as one straight-line block. The argument words stay in
+ * place, only the opcode of the first instruction in the chain changes. The
+ * pipeline bits are derived again afterwards since fusing changes which
+ * instructions are adjacent in code store. Fusing an already fused list is a
+ * no-op.
+ */
+__intrinsic void
+cfg_act_fuse(action_list_t *acts)
+{
+    uint32_t i;
+    uint32_t op;
+    uint32_t prev = 0;
+    uint32_t precursor_act;
+
+    for (i = 0; i < acts->count; i += cfg_act_len(op)) {
+        op = acts->instr[i].op;
+
+        if (op == INSTR_RX_WIRE && i + 2 < acts->count &&
+            acts->instr[i + 1].op == INSTR_DST_MAC_MATCH) {
+            op = INSTR_RX_WIRE_DMAC_MATCH;
+        } else if (op == INSTR_CHECKSUM && i + 3 < acts->count &&
+                   acts->instr[i + 1].op == INSTR_RSS &&
+                   acts->instr[i + 3].op == INSTR_TX_HOST) {
+            op = INSTR_CHECKSUM_RSS_TX_HOST;
+        }
+
+        precursor_act = 2 * cfg_act_map[op] - cfg_act_map[op + 1];
+        acts->instr[i].pipeline = (i && prev == precursor_act) ? 1 : 0;
+        acts->instr[i].op = cfg_act_map[op];
+        prev = cfg_act_map[op];
+    }
+}
+
+
 __intrinsic void
 cfg_act_write_host(uint32_t pcie, uint32_t vid, action_list_t *acts)
 {
     uint32_t i;
 
+    cfg_act_fuse(acts);
+
     for (i = 0; i < NFD_VID_MAXQS(vid); ++i)
         cfg_act_write_queue((pcie << 6) | NFD_VID2QID(vid, i), acts);
 }
@@ -600,10 +1148,63 @@ cfg_act_write_host(uint32_t pcie, uint32_t vid, action_list_t *acts)
 __intrinsic void
 cfg_act_write_wire(uint32_t port, action_list_t *acts)
 {
+    cfg_act_fuse(acts);
     cfg_act_write_queue((1 << 8) | port, acts);
 }
 
 
+/* Read NFP_NET_CFG_CTRL_WORD1 of a vNIC, it holds the firmware specific
+ * NIC_CFG_CTRL1_* bits. */
+__intrinsic uint32_t
+cfg_act_read_ctrl1(uint32_t pcie, uint32_t vid)
+{
+    __xread uint32_t ctrl1_xr;
+
+    mem_read32(&ctrl1_xr, (__mem void*) (nfd_cfg_bar_base(pcie, vid) +
+               NFP_NET_CFG_CTRL_WORD1), sizeof(ctrl1_xr));
+
+    return ctrl1_xr;
+}
+
+
+/* Set or clear the NIC_USO_QUEUE_TBL bits of the queues of a host vNIC on
+ * all islands. USO requests on queues without the bit are dropped. */
+__intrinsic void
+cfg_act_write_uso(uint32_t pcie, uint32_t vid, uint32_t enable)
+{
+    __cls __addr32 void *nic_uso_queue_tbl = (__cls __addr32 void*)
+                                              __link_sym("NIC_USO_QUEUE_TBL");
+    __xwrite uint32_t xwr_mask;
+    SIGNAL sig;
+    uint32_t addr_hi;
+    uint32_t addr_lo;
+    uint32_t isl;
+    uint32_t qid;
+    uint32_t i;
+
+    for (i = 0; i < NFD_VID_MAXQS(vid); ++i) {
+        qid = (pcie << 6) | NFD_VID2QID(vid, i);
+        addr_lo = (uint32_t) nic_uso_queue_tbl + (qid >> 5) * 4;
+        xwr_mask = 1 << (qid & 0x1f);
+
+        for (isl = 0; isl < sizeof(app_isl_ids) / sizeof(uint32_t); isl++) {
+            addr_hi = app_isl_ids[isl] >> 4; /* only use island, mask out ME */
+            addr_hi = (addr_hi << (34 - 8)); /* address shifted by 8 in instr */
+
+            if (enable) {
+                __asm {
+                    cls[set, xwr_mask, addr_hi, <<8, addr_lo, 1], ctx_swap[sig]
+                }
+            } else {
+                __asm {
+                    cls[clr, xwr_mask, addr_hi, <<8, addr_lo, 1], ctx_swap[sig]
+                }
+            }
+        }
+    }
+}
+
+
 __intrinsic void
 cfg_act_append(action_list_t *acts, uint16_t op, uint16_t args)
 {
@@ -735,8 +1336,13 @@ cfg_act_append_rss(action_list_t *acts, uint32_t pcie, uint32_t vid,
     __xread uint32_t rss_ctrl;
     __xread uint32_t rx_rings[2];
     __xread uint32_t rss_key[NFP_NET_CFG_RSS_KEY_SZ / sizeof(uint32_t)];
+    __shared __lmem uint32_t key[RSS_KEY_SZ_wrd];
+    __cls __addr32 void *nic_rss_key_tbl = (__cls __addr32 void*)
+                                            __link_sym("NIC_RSS_KEY_TBL");
     uint32_t rss_tbl_idx;
     uint32_t type, vnic;
+    uint32_t i;
+    int slot = -1;
     instr_rss_t instr_rss;
 
     bar_base = nfd_cfg_bar_base(pcie, vid);
@@ -756,7 +1362,30 @@ cfg_act_append_rss(action_list_t *acts, uint32_t pcie, uint32_t vid,
     __mem_read64(&rx_rings, (__mem void*) (bar_base + NFP_NET_CFG_RXRS_ENABLE),
                  sizeof(uint64_t), sizeof(uint64_t), sig_done, &sig3);
     wait_for_all(&sig1, &sig2, &sig3);
-    instr_rss.key = rss_key[0];
+
+    /* The symmetric hash is only implemented for CRC32 */
+    instr_rss.symmetric = (rss_ctrl & NFP_NET_CFG_RSS_SYMMETRIC) ? 1 : 0;
+
+    if ((rss_ctrl & NFP_NET_CFG_RSS_TOEPLITZ) && !instr_rss.symmetric) {
+        for (i = 0; i < RSS_KEY_SZ_wrd; i++)
+            key[i] = rss_key[i];
+        slot = rss_key_tbl_assign(rss_tbl_idx, key);
+    } else {
+        rss_key_tbl_slot[rss_tbl_idx] = 0;
+    }
+
+    /* Fall back to CRC32 if no key table is available */
+    if (slot >= 0) {
+        instr_rss.toeplitz = 1;
+        instr_rss.key = (uint32_t) nic_rss_key_tbl +
+                        slot * NIC_RSS_KEY_TBL_KEY_SIZE;
+    } else {
+        instr_rss.toeplitz = 0;
+        instr_rss.key = rss_key[0];
+    }
+
+    instr_rss.rebalance = rss_rebal_enable(rss_tbl_idx);
+    instr_rss.arfs = (arfs_vnics >> rss_tbl_idx) & 1;
 
     // Driver does L3 unconditionally, so we only care about L4 combinations
     instr_rss.cfg_proto = 0;
@@ -907,6 +1536,38 @@ cfg_act_append_tx_host(action_list_t *acts, uint32_t pcie, uint32_t vid,
 }
 
 
+/* The aggregate must fit the freelist buffers of the vNIC, leaving room for
+ * the metadata the host buffer also holds. */
+__intrinsic void
+cfg_act_append_lro(action_list_t *acts, uint32_t pcie, uint32_t vid)
+{
+    __imem uint32_t *fl_buf_sz_cache = (__imem uint32_t *)
+                                        __link_sym("_fl_buf_sz_cache");
+    instr_lro_t instr_lro;
+    __xread uint32_t flbuf_sz;
+    uint32_t max_len;
+
+    mem_read32(&flbuf_sz, &fl_buf_sz_cache[pcie * 64 + NFD_VID2NATQ(vid, 0)],
+               sizeof(flbuf_sz));
+
+    max_len = (flbuf_sz > NIC_LRO_MAX_LEN) ? NIC_LRO_MAX_LEN : flbuf_sz;
+    if (max_len <= NIC_LRO_META_MAX)
+        return;
+
+    instr_lro.__raw[0] = 0;
+    instr_lro.max_len = max_len - NIC_LRO_META_MAX;
+
+    cfg_act_append(acts, INSTR_LRO, instr_lro.__raw[0]);
+}
+
+
+__intrinsic void
+cfg_act_append_hds(action_list_t *acts)
+{
+    cfg_act_append(acts, INSTR_HDS, 0);
+}
+
+
 __intrinsic void
 cfg_act_append_tx_vlan(action_list_t *acts)
 {
@@ -1059,6 +1720,13 @@ cfg_act_build_nbi(action_list_t *acts, uint32_t pcie, uint32_t vid,
         (update & NFP_NET_CFG_UPDATE_RSS || update & NFP_NET_CFG_CTRL_BPF);
     uint32_t rss_v1 =
         (NFD_CFG_MAJOR_PF < 4 && !(control & NFP_NET_CFG_CTRL_CHAIN_META));
+    /* aggregates rely on the host trusting the stale TCP checksum and on
+     * chained metadata to carry the segment count */
+    uint32_t lro = ((cfg_act_read_ctrl1(pcie, vid) & NIC_CFG_CTRL1_LRO) &&
+                    rx_csum && !csum_compl && !rss_v1);
+    /* the split offset is carried in chained metadata */
+    uint32_t hds = ((cfg_act_read_ctrl1(pcie, vid) & NIC_CFG_CTRL1_HDS) &&
+                    !rss_v1);
 
     cfg_act_init(acts);
 
@@ -1083,6 +1751,12 @@ cfg_act_build_nbi(action_list_t *acts, uint32_t pcie, uint32_t vid,
     if (control & NFP_NET_CFG_CTRL_RSS_ANY || control & NFP_NET_CFG_CTRL_BPF)
         cfg_act_append_rss(acts, pcie, vid, update_rss, rss_v1);
 
+    if (hds)
+        cfg_act_append_hds(acts);
+
+    if (lro)
+        cfg_act_append_lro(acts, pcie, vid);
+
     cfg_act_append_tx_host(acts, pcie, vid, 0, veb_up);
 
     if (veb_up) {
@@ -1127,6 +1801,9 @@ cfg_act_build_veb_pf(action_list_t *acts, uint32_t pcie, uint32_t vid,
     if (control & NFP_NET_CFG_CTRL_RSS_ANY || control & NFP_NET_CFG_CTRL_BPF)
         cfg_act_append_rss(acts, pcie, vid, update_rss, rss_v1);
 
+    if ((cfg_act_read_ctrl1(pcie, vid) & NIC_CFG_CTRL1_HDS) && !rss_v1)
+        cfg_act_append_hds(acts);
+
     cfg_act_append_tx_host(acts, pcie, vid, 0, 0);
 }
 
@@ -1228,6 +1905,7 @@ cfg_act_write_veb(uint32_t vid, __lmem struct nic_mac_vlan_key *veb_key,
                     (new_vlan_id == 0 && vlan_id == NIC_NO_VLAN_ID)) {
                 if (vlan_id == NIC_NO_VLAN_ID)
                     cfg_act_remove_strip_vlan(acts);
+                cfg_act_fuse(acts);
                 veb_key->vlan_id = vlan_id;
                 if (nic_mac_vlan_entry_op_cmsg(veb_key,
                             (__lmem uint32_t *) acts->instr,
@@ -1261,6 +1939,57 @@ cfg_act_write_veb(uint32_t vid, __lmem struct nic_mac_vlan_key *veb_key,
 }
 
 
+/* MAC+VLAN table generation sampled on the previous call and flushed */
+__shared __lmem uint32_t veb_cache_gen_seen = 0;
+__shared __lmem uint32_t veb_cache_gen_flushed = 0;
+
+void
+cfg_act_veb_cache_sync()
+{
+    __ctm __addr40 void *veb_cache =
+        (__ctm __addr40 void*) __link_sym("_veb_cache");
+    __xread uint32_t gen;
+    __xwrite uint32_t zero[NIC_MAX_INSTR];
+    SIGNAL sig;
+    uint32_t addr_hi;
+    uint32_t addr_lo;
+    uint32_t isl;
+    uint32_t offset;
+    struct nfp_mecsr_prev_alu ind;
+
+    /* A table update seen on the previous call happened before the epoch
+     * that has completed since, so no datapath context can still fill the
+     * cache with a lookup that raced with it. */
+    if (veb_cache_gen_seen != veb_cache_gen_flushed) {
+        reg_zero(zero, sizeof(zero));
+
+        ind.__raw = 0;
+        ind.ov_len = 1;
+        ind.length = NIC_MAX_INSTR - 1;
+
+        for (isl = 0; isl < sizeof(app_isl_ids) / sizeof(uint32_t); isl++) {
+            addr_hi = app_isl_ids[isl] >> 4; /* only use island, mask out ME */
+            addr_hi = (addr_hi << (32 - 8)) | (1 << (39 - 8));
+
+            for (offset = 0; offset < NIC_VEB_CACHE_SIZE;
+                 offset += sizeof(zero)) {
+                addr_lo = (uint32_t) veb_cache + offset;
+                __asm {
+                    alu[--, --, B, ind.__raw]
+                    mem[write32, zero, addr_hi, <<8, addr_lo, \
+                        max_16], ctx_swap[sig], indirect_ref
+                }
+            }
+        }
+
+        veb_cache_gen_flushed = veb_cache_gen_seen;
+    }
+
+    mem_read32(&gen, NIC_MAC_VLAN_GEN_LINK, sizeof(gen));
+    veb_cache_gen_seen = gen;
+}
+
+
 int
 cfg_act_vf_up(uint32_t pcie, uint32_t vid, uint32_t pf_control,
               uint32_t vf_control, uint32_t update)
@@ -1367,6 +2096,11 @@ cfg_act_pf_up(uint32_t pcie, uint32_t vid, uint32_t veb_up,
 
     cfg_act_build_pf(&acts, pcie, vid, veb_up, control, update);
     cfg_act_write_host(pcie, vid, &acts);
+    cfg_act_write_uso(pcie, vid,
+                      cfg_act_read_ctrl1(pcie, vid) & NIC_CFG_CTRL1_USO);
+
+    if (!(control & NFP_NET_CFG_CTRL_RSS_ANY || control & NFP_NET_CFG_CTRL_BPF))
+        rss_key_tbl_release(pcie, vid);
 
     mem_read64(&mac_xr.mac_word[0], (__mem void*) (nfd_cfg_bar_base(pcie, vid) +
                 NFP_NET_CFG_MACADDR), sizeof(mac_xr));
@@ -1405,6 +2139,8 @@ int cfg_act_pf_down(uint32_t pcie, uint32_t vid)
     cfg_act_write_wire(vnic, &acts);
     cfg_act_build_pcie_down(&acts, pcie, vid);
     cfg_act_write_host(pcie, vid, &acts);
+    cfg_act_write_uso(pcie, vid, 0);
+    rss_key_tbl_release(pcie, vid);
 
     mac = nvnic_macs[pcie][vid];
     nvnic_macs[pcie][vid].mac_dword = 0;
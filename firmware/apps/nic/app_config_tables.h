@@ -65,6 +65,10 @@ void cfg_act_build_nbi(action_list_t *acts, uint32_t pcie, uint32_t vid,
 
 void cfg_act_write_wire(uint32_t port, action_list_t *acts);
 
+uint32_t cfg_act_read_ctrl1(uint32_t pcie, uint32_t vid);
+
+void cfg_act_write_uso(uint32_t pcie, uint32_t vid, uint32_t enable);
+
 void cfg_act_write_host(uint32_t pcie, uint32_t vid, action_list_t *acts);
 
 void cfg_act_build_nbi_down(action_list_t *acts, uint32_t pcie, uint32_t vid);
@@ -75,6 +79,64 @@ enum cfg_msg_err cfg_act_write_veb(uint32_t vid,
                                    __lmem struct nic_mac_vlan_key *veb_key,
                                    action_list_t *acts);
 
+/**
+ * Flush the datapath VEB caches once the MAC+VLAN table has changed.
+ * Must be called after each nic_local_epoch().
+ */
+void cfg_act_veb_cache_sync();
+
+/**
+ * Pick up the vNICs that gained their first or lost their last aRFS entry
+ * since the previous call, as published by the cmsg handler. Returns the
+ * mask of RSS table indices that changed, the RSS action of those vNICs has
+ * to be rebuilt for the change to take effect.
+ */
+uint32_t cfg_act_arfs_sync();
+
+/**
+ * RSS rebalancing policy, written by the host through the abi_rss_rebalance
+ * rtsym. Enabling a vNIC takes effect on its next reconfiguration.
+ */
+struct rss_rebal_cfg {
+    uint32_t vnic_mask;     /**< PF vNICs to rebalance, bit
+                                 pcie * NS_PLATFORM_NUM_PORTS + vNIC,
+                                 0 disables */
+    uint32_t interval_ms;   /**< Time between rebalancing rounds */
+    uint32_t threshold;     /**< Hottest queue load over the mean, in 1/16 */
+    uint32_t min_load;      /**< Hottest queue load per round worth acting on */
+    uint32_t max_moves;     /**< RSS table entries moved per vNIC per round */
+    uint32_t flags;         /**< RSS_REBAL_FLAG_* */
+    uint32_t moves;         /**< Entries moved so far, maintained by the ME */
+    uint32_t reserved;
+};
+
+#define RSS_REBAL_FLAG_BYTES    (1 << 0) /* balance bytes instead of packets */
+
+/**
+ * Move idle RSS table entries from the busiest to the least busy RX queue
+ * of the vNICs enabled in abi_rss_rebalance. Rate limited by interval_ms,
+ * so it can be called on every pass of a polling loop.
+ */
+void cfg_act_rss_rebalance();
+
+/**
+ * Receive scheduling policy of the worker contexts, written by the host
+ * through the abi_pkt_io_sched rtsym. When both sources have a packet ready
+ * pkt_io_rx serves up to nbi_weight wire packets in a row, then up to
+ * nfd_weight host packets in a row. Weights are clamped to
+ * PKT_IO_SCHED_WEIGHT_MAX, 1:1 alternates between the sources.
+ */
+struct pkt_io_sched_cfg {
+    uint32_t nbi_weight;    /**< Wire (NBI) packets per round */
+    uint32_t nfd_weight;    /**< Host (NFD) packets per round */
+};
+
+/**
+ * Push changes of abi_pkt_io_sched to the worker NN registers. Cheap when
+ * nothing changed, so it can be called on every pass of a polling loop.
+ */
+void cfg_act_pkt_io_sched();
+
 int cfg_act_vf_up(uint32_t pcie, uint32_t vid, uint32_t pf_control,
                   uint32_t vf_control, uint32_t update);
 
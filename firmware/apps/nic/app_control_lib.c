@@ -401,6 +401,11 @@ process_pf_reconfig(int pcie, uint32_t control, uint32_t update, uint32_t vid,
         return 1;
     }
 
+    if (cfg_act_read_ctrl1(pcie, vid) & ~(NIC_CFG_CTRL1_CAP)) {
+        cfg_msg->error = 1;
+        return 1;
+    }
+
     if (update & ~(NFD_CFG_PF_LEGAL_UPD)) {
         cfg_msg->error = 1;
         return 1;
@@ -570,6 +575,49 @@ process_vf_reconfig(int pcie, uint32_t control, uint32_t update, uint32_t vid,
     return 0;
 }
 
+/*
+ * Rebuild the action lists of the PFs whose RSS action has to start or stop
+ * looking up the aRFS table, see cfg_act_arfs_sync().
+ */
+static void
+process_arfs_update(void)
+{
+    uint32_t changed;
+    uint32_t rss_tbl_idx;
+    uint32_t pcie, vid;
+    uint32_t control;
+    uint32_t veb_up;
+    __gpr int i;
+
+    changed = cfg_act_arfs_sync();
+
+    while (changed) {
+        rss_tbl_idx = ffs(changed);
+        changed &= ~(1 << rss_tbl_idx);
+
+        pcie = rss_tbl_idx / NS_PLATFORM_NUM_PORTS;
+        vid = NFD_PF2VID(rss_tbl_idx % NS_PLATFORM_NUM_PORTS);
+        if (pcie >= NFD_MAX_ISL)
+            continue;
+
+        control = nic_control_word[pcie][vid];
+        if (!(control & NFP_NET_CFG_CTRL_ENABLE))
+            continue;
+
+        /* VFs in promiscuous mode share the RSS action of the first PF */
+        veb_up = 0;
+        for (i = 0; i < NFD_MAX_VFS; i++) {
+            if (nic_control_word[pcie][NFD_VF2VID(i)] & NFP_NET_CFG_CTRL_ENABLE) {
+                cfg_act_vf_up(pcie, NFD_VF2VID(i), control,
+                              nic_control_word[pcie][NFD_VF2VID(i)], 0);
+                veb_up = 1;
+            }
+        }
+
+        cfg_act_pf_up(pcie, vid, veb_up, control, 0);
+    }
+}
+
 __intrinsic static int
 next_nfd_cfg_msg(int *pcie, struct nfd_cfg_msg *cfg_msg)
 {
@@ -30,6 +30,15 @@
 #define CMESG_DISPATCH_OK       1
 #define CMESG_DISPATCH_FAIL     0xffffffff
 
+/* Bumped by the map cmsg handler after every MAC+VLAN table operation */
+#if defined(__NFP_LANG_ASM)
+    .alloc_mem _nic_mac_vlan_gen emem global 8 256
+#elif defined(__NFP_LANG_MICROC)
+    __asm {.alloc_mem _nic_mac_vlan_gen emem global 8 256}
+    #define NIC_MAC_VLAN_GEN_LINK \
+        (__emem __addr40 uint32_t *) _link_sym(_nic_mac_vlan_gen)
+#endif
+
 /** Lookup key for the MAC+VLAN table. */
 #if defined(__NFP_LANG_MICROC)
     struct nic_mac_vlan_key {
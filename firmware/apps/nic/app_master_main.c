@@ -65,7 +65,8 @@
  *   ME (this ME) of any changes to the configuration BAR.  It is then
  *   up to this ME to disseminate these configuration changes to any
  *   application MEs which need to be informed.  One context in this
- *   handles this.
+ *   handles this.  The same context rebuilds the RSS action of PFs
+ *   that gained their first or lost their last aRFS entry.
  *
  * - Periodically read and update the stats maintained by the NFP
  *   MACs. The MAC stats can wrap and need to be read periodically.
@@ -75,7 +76,8 @@
  * - Maintain per queue counters.  The PCIe MEs (NFD) maintain
  *   counters in some local (fast) memory.  One context in this ME is
  *   periodically updating the corresponding fields in the control
- *   BAR.
+ *   BAR.  The same context uses the RX queue counters to rebalance
+ *   the RSS tables of vNICs selected by the host.
  *
  * - Link state change monitoring.  One context in this ME is
  *   monitoring the Link state of the Ethernet port and updates the
@@ -293,6 +295,7 @@ error:
             nfd_cfg_app_complete_cfg_msg(pcie, &cfg_msg,
                                          nfd_cfg_bar_base(pcie, 0));
         }
+        process_arfs_update();
         ctx_swap();
     }
     /* NOTREACHED */
@@ -304,6 +307,9 @@ error:
  *
  * - Periodically push TX and RX queue counters maintained by the PCIe
  *   MEs to the control BAR.
+ * - Rebalance RSS tables from the RX queue counters (@cfg_act_rss_rebalance()).
+ * - Push the receive scheduling weights to the workers
+ *   (@cfg_act_pkt_io_sched()).
  */
 static void
 perq_stats_loop(void)
@@ -338,6 +344,9 @@ perq_stats_loop(void)
         sleep(PERQ_STATS_SLEEP);
 
         nic_local_epoch();
+        cfg_act_veb_cache_sync();
+        cfg_act_rss_rebalance();
+        cfg_act_pkt_io_sched();
     }
     /* NOTREACHED */
 }
@@ -695,22 +695,27 @@
 
 /* Ingress sequencer numbers (0/1/2/3/4) for packets from the wire will
    be mapped to GRO CTX numbers 0/2/3/4/5; those for packets from NFD
-   (0/1) will be mapped to GRO CTX numbers 8/9/10/11/12/13/14/15.  So
-   we need 16 GRO CTX's total.  The number of GRO blocks is expected
-   to be passed in from the build via -D define, so we need to calculate
-   GRO CTX's per block so that we always have (at least) 16.
+   (0..NFD_IN_NUM_SEQRS-1, per PCIe island) will be mapped to GRO CTX
+   numbers 8 and up, see PV_GRO_NFD_START.  A packet only waits for
+   earlier packets of its own GRO CTX, so the NFD queues are spread over
+   16 sequencers and we need 24 GRO CTX's, rounded up to 32.  The number of GRO
+   blocks is expected to be passed in from the build via -D define, so we
+   need to calculate GRO CTX's per block so that we always have (at
+   least) GRO_NUM_CTX.
 */
+#define GRO_NUM_CTX         32
+
 #ifndef GRO_NUM_BLOCKS
     #error "GRO_NUM_BLOCKS must be defined"
 #endif
 
-#if (GRO_NUM_BLOCKS > 16)
+#if (GRO_NUM_BLOCKS > GRO_NUM_CTX)
     #define GRO_CTX_PER_BLOCK       1
     #warning "Cannot properly configure GRO, GRO_NUM_BLOCKS is" GRO_NUM_BLOCKS "GRO_CTX_PER_BLOCK set to" GRO_CTX_PER_BLOCK
 #elif (GRO_NUM_BLOCKS < 1)
     #error "Cannot properly configure GRO, GRO_NUM_BLOCKS must be >0 but is set to" GRO_NUM_BLOCKS
 #else
-    #define GRO_CTX_PER_BLOCK (16/GRO_NUM_BLOCKS)
+    #define GRO_CTX_PER_BLOCK (GRO_NUM_CTX/GRO_NUM_BLOCKS)
 #endif
 
 /*
@@ -19,6 +19,7 @@
 
 // kick off processing loop
 pkt_io_init(pkt_vec)
+actions_profile_init()
 br[ingress#]
 
 PV_HDR_PARSE_SUBROUTINE#:
@@ -32,6 +33,7 @@ drop#:
 
 egress#:
     pkt_io_reorder(pkt_vec)
+    actions_profile_end()
 
 ingress#:
     pkt_io_rx(act_addr, pkt_vec)
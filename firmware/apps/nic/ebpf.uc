@@ -20,6 +20,8 @@
 #include "slicc_hash.h"
 
 #define EBPF_CAP_FUNC_ID_LOOKUP 1
+#define EBPF_CAP_FUNC_ID_UPDATE 2
+#define EBPF_CAP_FUNC_ID_DELETE 3
 
 #define EBPF_CAP_ADJUST_HEAD_FLAG_NO_META (1 << 0)
 
@@ -29,6 +31,8 @@
 #define NFP_BPF_CAP_TYPE_RANDOM       4
 #define NFP_BPF_CAP_TYPE_QUEUE_SELECT 5
 #define NFP_BPF_CAP_TYPE_ADJUST_TAIL  6
+#define NFP_BPF_CAP_TYPE_MAP_BATCH    7
+#define NFP_BPF_CAP_TYPE_MAP_DUMP     8
 
 #define EBPF_DEBUG
 #define EBPF_MAPS
@@ -74,6 +78,18 @@
 #endm
 
 
+#macro ebpf_init_cap_map_batch(max_data_sz)
+    #define_eval __EBPF_CAP_DATA '__EBPF_CAP_DATA,NFP_BPF_CAP_TYPE_MAP_BATCH,4,(max_data_sz)'
+    #define_eval __EBPF_CAP_LENGTH (__EBPF_CAP_LENGTH + 12)
+#endm
+
+
+#macro ebpf_init_cap_map_dump(max_data_sz)
+    #define_eval __EBPF_CAP_DATA '__EBPF_CAP_DATA,NFP_BPF_CAP_TYPE_MAP_DUMP,4,(max_data_sz)'
+    #define_eval __EBPF_CAP_LENGTH (__EBPF_CAP_LENGTH + 12)
+#endm
+
+
 #macro ebpf_init_cap_empty(type)
     #define_eval __EBPF_CAP_DATA '__EBPF_CAP_DATA,(type),0'
     #define_eval __EBPF_CAP_LENGTH (__EBPF_CAP_LENGTH + 8)
@@ -98,9 +114,14 @@ ebpf_init_cap_empty(NFP_BPF_CAP_TYPE_RANDOM)
 ebpf_init_cap_empty(NFP_BPF_CAP_TYPE_QUEUE_SELECT)
 ebpf_init_cap_empty(NFP_BPF_CAP_TYPE_ADJUST_TAIL)
 ebpf_init_cap_adjust_head(EBPF_CAP_ADJUST_HEAD_FLAG_NO_META, 44, 248, 84, 112)
-ebpf_init_cap_maps(((1 << BPF_MAP_TYPE_HASH)+(1<<BPF_MAP_TYPE_ARRAY)), HASHMAP_MAX_TID_EBPF, HASHMAP_MAX_ENTRIES, HASHMAP_MAX_KEYS_SZ, HASHMAP_MAX_VALU_SZ, \
+ebpf_init_cap_maps(((1 << BPF_MAP_TYPE_HASH)+(1<<BPF_MAP_TYPE_ARRAY)+(1<<BPF_MAP_TYPE_LRU_HASH)+ \
+                    (1<<BPF_MAP_TYPE_PERCPU_HASH)+(1<<BPF_MAP_TYPE_PERCPU_ARRAY)), HASHMAP_MAX_TID_EBPF, HASHMAP_MAX_ENTRIES, HASHMAP_MAX_KEYS_SZ, HASHMAP_MAX_VALU_SZ, \
                    (HASHMAP_KEYS_VALU_SZ))
+ebpf_init_cap_map_batch(CMSG_MAP_BATCH_DATA_SZ)
+ebpf_init_cap_map_dump(CMSG_MAP_DUMP_DATA_SZ)
 ebpf_init_cap_func(EBPF_CAP_FUNC_ID_LOOKUP, HTAB_MAP_LOOKUP_SUBROUTINE#)
+ebpf_init_cap_func(EBPF_CAP_FUNC_ID_UPDATE, HTAB_MAP_UPDATE_SUBROUTINE#)
+ebpf_init_cap_func(EBPF_CAP_FUNC_ID_DELETE, HTAB_MAP_DELETE_SUBROUTINE#)
 ebpf_init_cap_finalize()
 
 #define EBPF_STACK_SIZE 512
@@ -161,6 +182,9 @@ ebpf_init_cap_finalize()
     pv_invalidate_cache(_ebpf_pkt_vec)
 
     __actions_restore_t_idx()
+    #ifdef ACTIONS_PROFILE
+        __actions_profile_switch()
+    #endif
     br_bset[rc, EBPF_RET_PASS, actions#]
 
     // EBF_RET_REDIR
@@ -194,7 +218,7 @@ dummy0#:
 dummy1#:
     nop
 
-    br_addr[NFD_BPF_START_OFF], rtn[ebpf_reentry#], targets[HTAB_MAP_LOOKUP_SUBROUTINE#]
+    br_addr[NFD_BPF_START_OFF], rtn[ebpf_reentry#], targets[HTAB_MAP_LOOKUP_SUBROUTINE#, HTAB_MAP_UPDATE_SUBROUTINE#, HTAB_MAP_DELETE_SUBROUTINE#]
 .end
 #endm
 
@@ -209,10 +233,9 @@ cmsg_init()
 HTAB_MAP_LOOKUP_SUBROUTINE#:
 	htab_map_lookup_subr_func()
 HTAB_MAP_UPDATE_SUBROUTINE#:
-//	htab_map_update_subr_func()
-
+	htab_map_update_subr_func()
 HTAB_MAP_DELETE_SUBROUTINE#:
-//	htab_map_delete_subr_func()
+	htab_map_delete_subr_func()
 
 	#pragma warning(pop)
 .endif
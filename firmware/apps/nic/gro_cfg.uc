@@ -24,7 +24,7 @@
 #endif
 
 #ifndef GRO_CTX_PER_BLOCK
-    #define GRO_CTX_PER_BLOCK       4
+    #define GRO_CTX_PER_BLOCK       8
 #endif
 
 #if 0
@@ -87,6 +87,38 @@
 
         gro_declare_ctx(BLOCKNUM, CALLER, 15, GRO_ISL, (25 | GRO_USE_CACHE_UPPER), 2048, 1024)
 
+        gro_declare_ctx(BLOCKNUM, CALLER, 16, GRO_ISL, (24 | GRO_USE_CACHE_UPPER), 2048, 1024)
+
+        gro_declare_ctx(BLOCKNUM, CALLER, 17, GRO_ISL, (24 | GRO_USE_CACHE_UPPER), 2048, 1024)
+
+        gro_declare_ctx(BLOCKNUM, CALLER, 18, GRO_ISL, (24 | GRO_USE_CACHE_UPPER), 2048, 1024)
+
+        gro_declare_ctx(BLOCKNUM, CALLER, 19, GRO_ISL, (24 | GRO_USE_CACHE_UPPER), 2048, 1024)
+
+        gro_declare_ctx(BLOCKNUM, CALLER, 20, GRO_ISL, (25 | GRO_USE_CACHE_UPPER), 2048, 1024)
+
+        gro_declare_ctx(BLOCKNUM, CALLER, 21, GRO_ISL, (25 | GRO_USE_CACHE_UPPER), 2048, 1024)
+
+        gro_declare_ctx(BLOCKNUM, CALLER, 22, GRO_ISL, (25 | GRO_USE_CACHE_UPPER), 2048, 1024)
+
+        gro_declare_ctx(BLOCKNUM, CALLER, 23, GRO_ISL, (25 | GRO_USE_CACHE_UPPER), 2048, 1024)
+
+        gro_declare_ctx(BLOCKNUM, CALLER, 24, GRO_ISL, (24 | GRO_USE_CACHE_UPPER), 2048, 1024)
+
+        gro_declare_ctx(BLOCKNUM, CALLER, 25, GRO_ISL, (24 | GRO_USE_CACHE_UPPER), 2048, 1024)
+
+        gro_declare_ctx(BLOCKNUM, CALLER, 26, GRO_ISL, (24 | GRO_USE_CACHE_UPPER), 2048, 1024)
+
+        gro_declare_ctx(BLOCKNUM, CALLER, 27, GRO_ISL, (24 | GRO_USE_CACHE_UPPER), 2048, 1024)
+
+        gro_declare_ctx(BLOCKNUM, CALLER, 28, GRO_ISL, (25 | GRO_USE_CACHE_UPPER), 2048, 1024)
+
+        gro_declare_ctx(BLOCKNUM, CALLER, 29, GRO_ISL, (25 | GRO_USE_CACHE_UPPER), 2048, 1024)
+
+        gro_declare_ctx(BLOCKNUM, CALLER, 30, GRO_ISL, (25 | GRO_USE_CACHE_UPPER), 2048, 1024)
+
+        gro_declare_ctx(BLOCKNUM, CALLER, 31, GRO_ISL, (25 | GRO_USE_CACHE_UPPER), 2048, 1024)
+
     /* Netdev wire does not send to NBI, so no NBI dest         */
     /* gro_declare_dest_nbi(BLOCKNUM, CALLER, 0, GRO_1_SEQR)    */
     /* gro_declare_dest_nbi(BLOCKNUM, CALLER, 1, GRO_1_SEQR)    */
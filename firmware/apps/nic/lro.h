@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) 2017-2020 Netronome Systems, Inc.  All rights reserved.
+ *
+ * @file   lro.h
+ * @brief  Receive side coalescing (LRO) table shared by the datapath and
+ *         the LRO ME.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef _LRO_H_
+#define _LRO_H_
+
+/**
+ * LRO work queues. The LRO action hands every plain IPv4/TCP segment of an
+ * LRO enabled host queue to an LRO ME through GRO, so the segments of a flow
+ * arrive in wire order. Flows are spread over NIC_LRO_MES MEs by the upper
+ * bits of their table index and over the NIC_LRO_RINGS rings of each ME by
+ * the low bits, see lro_hash(). Context n of LRO ME m owns ring
+ * m * NIC_LRO_RINGS + n and the table entries of its flows, no locks are
+ * taken.
+ *
+ * Bit    3 3 2 2 2 2 2 2 2 2 2 2 1 1 1 1 1 1 1 1 1 1 0 0 0 0 0 0 0 0 0 0
+ * -----\ 1 0 9 8 7 6 5 4 3 2 1 0 9 8 7 6 5 4 3 2 1 0 9 8 7 6 5 4 3 2 1 0
+ * Word  +-+---+---------------------------------------------------------+
+ *    0  |N|BLS|           MU Buffer Address [39:11]                     |
+ *       +-+---+---------+---+-----------+-------------------------------+
+ *    1  |O| Meta Length |PCI|   Queue   |           Data Length         |
+ *       +-+-------------+---+-----------+-------------------------------+
+ *    2  |M| offset >> 1 |   L3 offset   |             Flags             |
+ *       +-+-------------+---------------+-------------------------------+
+ *
+ * The packet is in its MU buffer only, words 0 and 1 and the flags are those
+ * of its NFD out descriptor, see pv_get_nfd_host_desc().
+ *
+ * O - Bit 0 of the offset of the metadata in the MU buffer
+ * M - Segment can be coalesced, it carries NIC_META_LRO metadata
+ *
+ * A descriptor with word 0 clear asks the owner to sweep its entries.
+ */
+#ifndef NIC_LRO_MES
+    #define NIC_LRO_MES             1
+#endif
+#if ((NIC_LRO_MES & (NIC_LRO_MES - 1)) != 0)
+    #error "NIC_LRO_MES must be a power of 2"
+#endif
+
+#define NIC_LRO_RINGS_LOG2          2
+#define NIC_LRO_RINGS               (1 << NIC_LRO_RINGS_LOG2)
+#define NIC_LRO_RINGS_TOTAL         (NIC_LRO_RINGS * NIC_LRO_MES)
+#define NIC_LRO_WQ_SZ               65536
+#define NIC_LRO_WQ_DESC_LW          3
+
+#define NIC_LRO_WQ_BLS_wrd          0
+#define NIC_LRO_WQ_LEN_wrd          1
+#define NIC_LRO_WQ_OFFSET_ODD_bf    1, 31, 31
+#define NIC_LRO_WQ_PCI_bf           1, 23, 22
+#define NIC_LRO_WQ_INFO_wrd         2
+#define NIC_LRO_WQ_MERGE_bf         2, 31, 31
+#define NIC_LRO_WQ_OFFSET_bf        2, 30, 24
+#define NIC_LRO_WQ_L3_OFFSET_bf     2, 23, 16
+#define NIC_LRO_WQ_FLAGS_bf         2, 15, 0
+
+/**
+ * LRO aggregation table, direct mapped by a fold of the IPv4 addresses and
+ * TCP ports. Each LRO ME owns a slice of NIC_LRO_ME_ENTRIES consecutive
+ * entries. An entry holds at most one aggregate: the MU buffer of the
+ * first segment of a flow, with the payload of later in-order segments
+ * appended to it, and the NFD descriptor that delivers it to the host.
+ *
+ * Bit    3 3 2 2 2 2 2 2 2 2 2 2 1 1 1 1 1 1 1 1 1 1 0 0 0 0 0 0 0 0 0 0
+ * -----\ 1 0 9 8 7 6 5 4 3 2 1 0 9 8 7 6 5 4 3 2 1 0 9 8 7 6 5 4 3 2 1 0
+ * Word  +---------------------------------------------------------------+
+ *    0  |                       IPv4 source address                     |
+ *       +---------------------------------------------------------------+
+ *    1  |                     IPv4 destination address                  |
+ *       +-------------------------------+-------------------------------+
+ *    2  |          source port          |        destination port       |
+ *       +-------------------------------+-------------------------------+
+ *    3  |                   next expected sequence number               |
+ *       +---------------------------------------------------------------+
+ *    4  |                      acknowledgment number                    |
+ *       +-------+-------+---------------+-------------------------------+
+ *    5  | doff  | flags                 |             window            |
+ *       +-------+-----------------------+-------------------------------+
+ *    6  |                    TSval (0 without timestamps)               |
+ *       +---------------------------------------------------------------+
+ *    7  |                    TSecr (0 without timestamps)               |
+ *       +---------------------------------------------------------------+
+ *  8-11 |              NFD out descriptor of the aggregate              |
+ *       +-------------------------------+-------------------------------+
+ *   12  |                0              |   data length limit           |
+ *       +-------------------------------+-------------------------------+
+ * 13-15 |                            reserved                           |
+ *       +---------------------------------------------------------------+
+ *
+ * The control word of each entry is kept in the local memory of its LRO ME:
+ *
+ *       +-+-+-+---------+---------------+---+-----------+---------------+
+ *       |0|V|A|    0    |   segments    |PCI|     0     |   L3 offset   |
+ *       +-+-+-+---------+---------------+---+-----------+---------------+
+ *
+ * V - Entry holds an aggregate
+ * A - Aggregate seen by one sweep, flushed on the next unless it grows
+ */
+#define NIC_LRO_ME_ENTRIES_LOG2     8
+#define NIC_LRO_ME_ENTRIES          (1 << NIC_LRO_ME_ENTRIES_LOG2)
+#define NIC_LRO_TBL_ENTRIES         (NIC_LRO_ME_ENTRIES * NIC_LRO_MES)
+#define NIC_LRO_ENTRY_SZ_LOG2       6
+#define NIC_LRO_ME_TBL_SIZE         (NIC_LRO_ME_ENTRIES << NIC_LRO_ENTRY_SZ_LOG2)
+#define NIC_LRO_TBL_SIZE            (NIC_LRO_TBL_ENTRIES << NIC_LRO_ENTRY_SZ_LOG2)
+
+#define NIC_LRO_VALID_bf            0, 30, 30
+#define NIC_LRO_AGED_bf             0, 29, 29
+#define NIC_LRO_SEGS_bf             0, 23, 16
+#define NIC_LRO_PCI_bf              0, 15, 14
+#define NIC_LRO_L3_OFFSET_bf        0, 7, 0
+
+#define NIC_LRO_KEY_wrd             0
+#define NIC_LRO_KEY_LW              8
+#define NIC_LRO_DESC_wrd            8
+#define NIC_LRO_DESC_LW             4
+#define NIC_LRO_LIMIT_wrd           12
+#define NIC_LRO_ENTRY_LW            13
+
+/* Upper bound on the aggregate length, excluding metadata */
+#define NIC_LRO_MAX_LEN             8192
+/* Room reserved in the host buffer for the metadata of the aggregate */
+#define NIC_LRO_META_MAX            32
+#define NIC_LRO_MAX_SEGS            32
+/* Period of the LRO ME sweeps, an aggregate is held for one to two sweeps
+ * when no further segments arrive */
+#define NIC_LRO_SWEEP_US            10
+
+#if defined(__NFP_LANG_ASM)
+    .alloc_mem _nic_lro_tbl emem global NIC_LRO_TBL_SIZE 256
+    .init _nic_lro_tbl 0
+
+    #define_eval __LRO_RING 0
+    #while (__LRO_RING < NIC_LRO_RINGS_TOTAL)
+        .alloc_resource NIC_LRO_Q_IDX_/**/__LRO_RING emem0_queues global 1
+        #define_eval __LRO_RING (__LRO_RING + 1)
+    #endloop
+    #undef __LRO_RING
+#endif
+
+#endif /* _LRO_H_ */
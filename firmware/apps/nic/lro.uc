@@ -0,0 +1,404 @@
+/*
+ * Copyright (C) 2017-2020 Netronome Systems, Inc.  All rights reserved.
+ *
+ * @file   lro.uc
+ * @brief  Receive side coalescing (LRO) work queues and aggregates, shared
+ *         by the LRO action and the LRO ME.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef _LRO_UC
+#define _LRO_UC
+
+#include <aggregate.uc>
+#include <nfd_out.uc>
+#include <ov.uc>
+#include <passert.uc>
+
+#include "lro.h"
+#include "pkt_buf.uc"
+#include "protocols.h"
+
+#if (defined(NFD_PCIE1_EMEM) || defined(NFD_PCIE2_EMEM) || defined(NFD_PCIE3_EMEM))
+    #define LRO_MULTI_PCI
+#endif
+
+/** lro_hash
+ *
+ * Index of the LRO table entry of a flow. The bits above
+ * NIC_LRO_ME_ENTRIES_LOG2 select the LRO ME and the low NIC_LRO_RINGS_LOG2
+ * bits its work queue, and with it the context owning the entry.
+ *
+ * @param out_idx   Table entry index
+ * @param in_saddr  IPv4 source address
+ * @param in_daddr  IPv4 destination address
+ * @param in_ports  TCP source and destination ports
+ */
+#macro lro_hash(out_idx, in_saddr, in_daddr, in_ports)
+.begin
+    .reg tmp
+
+    alu[out_idx, in_saddr, XOR, in_daddr]
+    alu[out_idx, out_idx, XOR, in_ports]
+    alu[tmp, --, B, out_idx, >>16]
+    alu[out_idx, out_idx, XOR, tmp]
+    alu[tmp, --, B, out_idx, >>8]
+    alu[out_idx, out_idx, XOR, tmp]
+    #if (NIC_LRO_TBL_ENTRIES > 256)
+        alu[out_idx, --, B, out_idx, <<(32 - log2(NIC_LRO_TBL_ENTRIES))]
+        alu[out_idx, --, B, out_idx, >>(32 - log2(NIC_LRO_TBL_ENTRIES))]
+    #else
+        alu[out_idx, out_idx, AND, (NIC_LRO_TBL_ENTRIES - 1)]
+    #endif
+.end
+#endm
+
+
+/** lro_get_gro_workq_desc
+ *
+ * GRO descriptor queueing an LRO work queue descriptor to the ring of
+ * table entry in_idx, see cmsg_get_gro_workq_desc().
+ *
+ * @param out_desc  GRO metadata, 4 words
+ * @param in_idx    Table entry index, see lro_hash()
+ * @param in_wq     LRO work queue descriptor, 3 words
+ */
+#macro lro_get_gro_workq_desc(out_desc, in_idx, in_wq)
+.begin
+    .reg desc
+    .reg q_idx
+    .reg ring
+
+    alu[ring, in_idx, AND, (NIC_LRO_RINGS - 1)]
+    #if (NIC_LRO_MES > 1)
+        alu[q_idx, --, B, in_idx, >>NIC_LRO_ME_ENTRIES_LOG2]
+        alu[ring, ring, OR, q_idx, <<NIC_LRO_RINGS_LOG2]
+    #endif
+    #define_eval __LRO_RING 0
+    #while (__LRO_RING < NIC_LRO_RINGS_TOTAL)
+        immed[q_idx, NIC_LRO_Q_IDX_/**/__LRO_RING]
+        alu[--, ring, -, __LRO_RING]
+        beq[ring_found#]
+        #define_eval __LRO_RING (__LRO_RING + 1)
+    #endloop
+    #undef __LRO_RING
+
+ring_found#:
+    move(desc, NIC_LRO_WQ_DESC_LW | ((24 | 0x80) << GRO_META_RINGHI_shf))
+    alu_shf[desc, desc, OR, q_idx, <<GRO_META_MEM_RING_RINGLO_shf]
+    alu_shf[out_desc[0], desc, OR, GRO_DEST_MEM_RING_3WORD, <<GRO_META_DEST_shf]
+    alu[out_desc[1], --, B, in_wq[NIC_LRO_WQ_BLS_wrd]]
+    alu[out_desc[2], --, B, in_wq[NIC_LRO_WQ_LEN_wrd]]
+    alu[out_desc[3], --, B, in_wq[NIC_LRO_WQ_INFO_wrd]]
+.end
+#endm
+
+
+/** lro_get_nfd_desc
+ *
+ * NFD out descriptor delivering the packet of an LRO work queue descriptor
+ * as it is.
+ *
+ * @param out_desc  NFD out descriptor, 4 GPRs
+ * @param in_wq     LRO work queue descriptor, 3 words
+ */
+#macro lro_get_nfd_desc(out_desc, in_wq)
+.begin
+    .reg offset
+    .reg odd
+
+    alu[offset, 0x7f, AND, in_wq[NIC_LRO_WQ_INFO_wrd], >>BF_L(NIC_LRO_WQ_OFFSET_bf)]
+    alu[odd, --, B, in_wq[NIC_LRO_WQ_LEN_wrd], >>BF_L(NIC_LRO_WQ_OFFSET_ODD_bf)]
+    alu[out_desc[NFD_OUT_OFFSET_wrd], odd, OR, offset, <<1]
+    alu[out_desc[NFD_OUT_BLS_wrd], --, B, in_wq[NIC_LRO_WQ_BLS_wrd]]
+    alu[out_desc[NFD_OUT_QID_wrd], in_wq[NIC_LRO_WQ_LEN_wrd], AND~, 0x3, <<BF_L(NIC_LRO_WQ_PCI_bf)]
+    alu[out_desc[NFD_OUT_QID_wrd], out_desc[NFD_OUT_QID_wrd], OR, 1, <<31]
+    ld_field_w_clr[out_desc[NFD_OUT_FLAGS_wrd], 0011, in_wq[NIC_LRO_WQ_INFO_wrd]]
+.end
+#endm
+
+
+/** lro_send
+ *
+ * Hand a packet in its MU buffer to NFD, or free the buffer if the host
+ * queue has no credits.
+ *
+ * @param in_desc       NFD out descriptor, 4 GPRs
+ * @param in_pci_isl    PCIe island of the host queue
+ * @param in_sig        Signal the caller has outstanding writes to the
+ *                      buffer on, waited for before NFD may DMA it, or --
+ */
+#macro lro_send(in_desc, in_pci_isl, in_sig)
+.begin
+    .reg addr_hi
+    .reg addr_lo
+    .reg bls
+    .reg mu_addr
+    .reg pci_q
+
+    .reg $credits
+    .reg write $desc[4]
+    .xfer_order $desc
+    .sig sig_credits
+    .sig sig_desc
+
+    alu[pci_q, 0x3f, AND, in_desc[NFD_OUT_QID_wrd], >>NFD_OUT_QID_shf]
+    #ifdef LRO_MULTI_PCI
+        alu[addr_hi, (__NFD_DIRECT_ACCESS | NFD_PCIE_ISL_BASE), OR, in_pci_isl]
+        alu[addr_hi, --, B, addr_hi, <<24]
+    #else
+        alu[addr_hi, --, B, (__NFD_DIRECT_ACCESS | NFD_PCIE_ISL_BASE), <<24]
+    #endif
+    alu[addr_lo, --, B, pci_q, <<(log2(NFD_OUT_ATOMICS_SZ))]
+    ov_single(OV_IMMED8, 1)
+    mem[test_subsat_imm, $credits, addr_hi, <<8, addr_lo, 1], indirect_ref, sig_done[sig_credits]
+
+    #if (streq('in_sig', '--'))
+        ctx_arb[sig_credits]
+    #else
+        ctx_arb[sig_credits, in_sig]
+    #endif
+
+    alu[--, --, B, $credits]
+    beq[no_credits#]
+
+    immed[addr_lo, nfd_out_ring_info]
+    #ifdef LRO_MULTI_PCI
+        alu[addr_lo, addr_lo, OR, in_pci_isl, <<(log2(NFD_OUT_RING_INFO_ITEM_SZ))]
+    #endif
+    local_csr_wr[ACTIVE_LM_ADDR_0, addr_lo]
+
+    alu[$desc[0], --, B, in_desc[0]]
+    alu[$desc[1], --, B, in_desc[1]]
+    alu[$desc[2], --, B, in_desc[2]]
+    alu[$desc[3], --, B, in_desc[3]]
+
+    alu[addr_hi, *l$index0, AND, 0xff, <<24]
+    ld_field_w_clr[addr_lo, 0011, *l$index0]
+    mem[qadd_work, $desc[0], addr_hi, <<8, addr_lo, 4], sig_done[sig_desc]
+    ctx_arb[sig_desc], br[end#]
+
+no_credits#:
+    // host ring is full, recycle the buffer
+    alu[bls, 3, AND, in_desc[NFD_OUT_BLS_wrd], >>NFD_OUT_BLS_shf]
+    alu[mu_addr, in_desc[NFD_OUT_BLS_wrd], AND~, 0x7, <<29]
+    pkt_buf_free_mu_buffer(bls, mu_addr)
+
+end#:
+.end
+#endm
+
+
+/** lro_fixup
+ *
+ * Finish an aggregate for delivery. The IPv4 total length and header
+ * checksum are updated for the appended payload and the segment count is
+ * written into the NIC_META_LRO field of the prepended metadata. The TCP
+ * checksum is left stale, the descriptor flags report it as verified.
+ *
+ * @param in_ctl    Control word of the LRO table entry
+ * @param in_desc   NFD out descriptor of the aggregate, 4 GPRs
+ * @param out_sig   Signal raised once both writes are done
+ */
+#macro lro_fixup(in_ctl, in_desc, out_sig)
+.begin
+    .reg addr_hi
+    .reg buf_lo
+    .reg carry
+    .reg csum
+    .reg ip_addr
+    .reg ip_len
+    .reg l3_offset
+    .reg mask16
+    .reg meta_len
+
+    .reg read $ip[3]
+    .xfer_order $ip
+    .reg write $ip_wr[3]
+    .xfer_order $ip_wr
+    .reg write $segs
+    .sig sig_ip
+
+    // MU buffer of the aggregate, N and BLS shift out
+    alu[addr_hi, --, B, in_desc[NFD_OUT_BLS_wrd], <<3]
+    ld_field_w_clr[buf_lo, 0011, in_desc[NFD_OUT_OFFSET_wrd]]
+    alu[meta_len, 0x7f, AND, in_desc[NFD_OUT_QID_wrd], >>NFD_OUT_METALEN_shf]
+    alu[l3_offset, BF_MASK(NIC_LRO_L3_OFFSET_bf), AND, in_ctl]
+
+    alu[ip_addr, buf_lo, +, meta_len]
+    alu[ip_addr, ip_addr, +, l3_offset]
+    alu[ip_addr, ip_addr, +, IPV4_LEN_OFFS]
+    mem[read32, $ip[0], addr_hi, <<8, ip_addr, 3], ctx_swap[sig_ip]
+
+    /* IP length = data_len - meta_len - l3_off */
+    ld_field_w_clr[ip_len, 0011, in_desc[NFD_OUT_QID_wrd]]
+    alu[ip_len, ip_len, -, meta_len]
+    alu[ip_len, ip_len, -, l3_offset]
+
+    /* HC' = ~(~HC + ~m + m'), RFC 1624 */
+    immed[mask16, 0xffff]
+    alu[csum, mask16, AND~, $ip[2], >>16]
+    alu[csum, csum, +, ip_len]
+    alu[csum, csum, +, mask16]
+    alu[csum, csum, -, $ip[0], >>16]
+    alu[carry, --, B, csum, >>16]
+    alu[csum, carry, +16, csum]
+    alu[carry, --, B, csum, >>16]
+    alu[csum, carry, +16, csum]
+    alu[csum, mask16, AND~, csum]
+
+    alu[ip_len, --, B, ip_len, <<16]
+    alu[$ip_wr[0], ip_len, +16, $ip[0]]
+    alu[$ip_wr[1], --, B, $ip[1]]
+    alu[csum, --, B, csum, <<16]
+    alu[$ip_wr[2], csum, +16, $ip[2]]
+    mem[write32, $ip_wr[0], addr_hi, <<8, ip_addr, 3], ctx_swap[sig_ip]
+
+    // segment count, low half of the first metadata value
+    passert(BF_L(NIC_LRO_SEGS_bf), "EQ", 16)
+    alu[$segs, in_ctl, AND~, 0xff, <<24]
+    alu[buf_lo, buf_lo, +, 6]
+    mem[write8, $segs, addr_hi, <<8, buf_lo, 2], sig_done[out_sig]
+.end
+#endm
+
+
+/** lro_flush
+ *
+ * Finish an aggregate and hand it to NFD, see lro_fixup() and lro_send().
+ * The caller clears the control word of the entry afterwards.
+ *
+ * @param in_ctl    Control word of the LRO table entry
+ * @param in_desc   NFD out descriptor of the aggregate, 4 GPRs
+ */
+#macro lro_flush(in_ctl, in_desc)
+.begin
+    .reg pci_isl
+    .sig sig_fixup
+
+    lro_fixup(in_ctl, in_desc, sig_fixup)
+    alu[pci_isl, 3, AND, in_ctl, >>BF_L(NIC_LRO_PCI_bf)]
+    lro_send(in_desc, pci_isl, sig_fixup)
+.end
+#endm
+
+
+/** lro_hold
+ *
+ * Start an aggregate with a segment that can be coalesced.
+ *
+ * @param out_ctl       Control word of the entry
+ * @param in_entry_hi   Upper address bits of the table, >>8
+ * @param in_entry_lo   Offset of the entry in the table
+ * @param in_hdr        Segment headers: saddr, daddr, ports, seq, ack, TCP
+ *                      word 3, TSval and TSecr, 8 GPRs
+ * @param in_payload    TCP payload length of the segment
+ * @param in_desc       NFD out descriptor of the segment, 4 GPRs
+ * @param in_limit      Largest data length of the aggregate
+ * @param in_pci_isl    PCIe island of the host queue
+ * @param in_l3_offset  Offset of the IPv4 header in the packet
+ */
+#macro lro_hold(out_ctl, in_entry_hi, in_entry_lo, in_hdr, in_payload, in_desc, in_limit, in_pci_isl, in_l3_offset)
+.begin
+    .reg write $entry[NIC_LRO_ENTRY_LW]
+    .xfer_order $entry
+    .sig sig_entry
+
+    alu[$entry[0], --, B, in_hdr[0]]
+    alu[$entry[1], --, B, in_hdr[1]]
+    alu[$entry[2], --, B, in_hdr[2]]
+    alu[$entry[3], in_hdr[3], +, in_payload]
+    alu[$entry[4], --, B, in_hdr[4]]
+    alu[$entry[5], --, B, in_hdr[5]]
+    alu[$entry[6], --, B, in_hdr[6]]
+    alu[$entry[7], --, B, in_hdr[7]]
+    alu[$entry[8], --, B, in_desc[0]]
+    alu[$entry[9], --, B, in_desc[1]]
+    alu[$entry[10], --, B, in_desc[2]]
+    alu[$entry[11], --, B, in_desc[3]]
+    alu[$entry[12], --, B, in_limit]
+    ov_single(OV_LENGTH, NIC_LRO_ENTRY_LW, OVF_SUBTRACT_ONE)
+    mem[write32, $entry[0], in_entry_hi, <<8, in_entry_lo, max_16], indirect_ref, sig_done[sig_entry]
+
+    alu[out_ctl, in_l3_offset, OR, 1, <<BF_L(NIC_LRO_SEGS_bf)]
+    alu[out_ctl, out_ctl, OR, in_pci_isl, <<BF_L(NIC_LRO_PCI_bf)]
+    alu[out_ctl, out_ctl, OR, 1, <<BF_L(NIC_LRO_VALID_bf)]
+    ctx_arb[sig_entry]
+.end
+#endm
+
+
+/** lro_append
+ *
+ * Append the payload of an in-order segment to the aggregate of its flow.
+ * The payload is copied 32 bytes at a time, the read of each chunk overlaps
+ * the write of the previous one. The aggregate buffer has room for the
+ * excess of the last chunk. Growing the aggregate clears
+ * NIC_LRO_AGED_bf so the next sweep does not flush it. The caller frees the
+ * MU buffer of the segment.
+ *
+ * @param io_ctl        Control word of the entry
+ * @param in_entry_hi   Upper address bits of the table, >>8
+ * @param in_entry_lo   Offset of the entry in the table
+ * @param in_desc       NFD out descriptor of the aggregate, 4 GPRs
+ * @param in_seq        Sequence number of the segment
+ * @param in_seg_hi     Upper address bits of the segment buffer, >>8
+ * @param in_seg_lo     Offset of the TCP payload in the segment buffer
+ * @param in_payload    TCP payload length of the segment
+ */
+#macro lro_append(io_ctl, in_entry_hi, in_entry_lo, in_desc, in_seq, in_seg_hi, in_seg_lo, in_payload)
+.begin
+    .reg copy_len
+    .reg dst_hi
+    .reg dst_lo
+    .reg src_lo
+    .reg tmp
+
+    .reg read $copy_rd[8]
+    .xfer_order $copy_rd
+    .reg write $copy_wr[8]
+    .xfer_order $copy_wr
+    .reg write $seq
+    .reg write $len
+    .sig sig_copy_rd
+    .sig sig_copy_wr
+    .sig sig_len
+    .sig sig_seq
+
+    // end of the aggregate data
+    alu[dst_hi, --, B, in_desc[NFD_OUT_BLS_wrd], <<3]
+    ld_field_w_clr[dst_lo, 0011, in_desc[NFD_OUT_OFFSET_wrd]]
+    alu[dst_lo, dst_lo, +16, in_desc[NFD_OUT_QID_wrd]]
+    alu[src_lo, --, B, in_seg_lo]
+    alu[copy_len, --, B, in_payload]
+
+    mem[read8, $copy_rd[0], in_seg_hi, <<8, src_lo, 32], ctx_swap[sig_copy_rd]
+
+copy#:
+    aggregate_copy($copy_wr, $copy_rd, 8)
+    mem[write8, $copy_wr[0], dst_hi, <<8, dst_lo, 32], sig_done[sig_copy_wr]
+    alu[src_lo, src_lo, +, 32]
+    alu[dst_lo, dst_lo, +, 32]
+    alu[copy_len, copy_len, -, 32]
+    ble[copy_last#]
+    mem[read8, $copy_rd[0], in_seg_hi, <<8, src_lo, 32], sig_done[sig_copy_rd]
+    ctx_arb[sig_copy_rd, sig_copy_wr], br[copy#]
+
+copy_last#:
+    ctx_arb[sig_copy_wr]
+
+    alu[$seq, in_seq, +, in_payload]
+    alu[tmp, in_entry_lo, +, ((NIC_LRO_KEY_wrd + 3) * 4)]
+    mem[write32, $seq, in_entry_hi, <<8, tmp, 1], sig_done[sig_seq]
+    alu[$len, in_desc[NFD_OUT_QID_wrd], +, in_payload]
+    alu[tmp, in_entry_lo, +, ((NIC_LRO_DESC_wrd + NFD_OUT_QID_wrd) * 4)]
+    mem[write32, $len, in_entry_hi, <<8, tmp, 1], sig_done[sig_len]
+
+    alu[io_ctl, io_ctl, +, 1, <<BF_L(NIC_LRO_SEGS_bf)]
+    alu[io_ctl, io_ctl, AND~, 1, <<BF_L(NIC_LRO_AGED_bf)]
+    ctx_arb[sig_seq, sig_len]
+.end
+#endm
+
+#endif
@@ -0,0 +1,309 @@
+/*
+ * Copyright (C) 2017-2020 Netronome Systems, Inc.  All rights reserved.
+ *
+ * @file   lro_flush.uc
+ * @brief  LRO ME: coalesce the segments queued by the LRO action and
+ *         deliver aggregates that stopped growing.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/* LRO ME NIC_LRO_ME_INDEX of NIC_LRO_MES owns NIC_LRO_RINGS rings and a
+ * slice of the table, see lro.h. Context n < NIC_LRO_RINGS pops the n-th
+ * ring of the ME and owns the table entries of its flows, their control
+ * words are kept in local memory. A segment that continues the aggregate of
+ * its flow has its payload appended to it, any other packet first flushes
+ * the aggregate of its flow, so the host sees every flow in wire order.
+ *
+ * Context NIC_LRO_RINGS queues a sweep descriptor to every ring of the ME
+ * each NIC_LRO_SWEEP_US. An aggregate is marked aged by the first sweep that
+ * finds it and flushed by the next unless it grew in between.
+ */
+
+#include <aggregate.uc>
+#include <nfd_user_cfg.h>
+#include <nfd_out.uc>
+#include <ov.uc>
+#include <passert.uc>
+#include <timestamp.uc>
+
+#include "app_config_instr.h"
+#include "license.h"
+#include "lro.h"
+#include "lro.uc"
+
+nfd_out_send_init()
+
+#ifndef NIC_LRO_ME_INDEX
+    #define NIC_LRO_ME_INDEX        0
+#endif
+#if (NIC_LRO_ME_INDEX >= NIC_LRO_MES)
+    #error "NIC_LRO_ME_INDEX out of range" (NIC_LRO_ME_INDEX)
+#endif
+
+passert(NIC_LRO_RINGS, "LT", 8)
+
+#define NIC_LRO_ME_RING0            (NIC_LRO_ME_INDEX * NIC_LRO_RINGS)
+
+#define_eval __LRO_RING NIC_LRO_ME_RING0
+#while (__LRO_RING < (NIC_LRO_ME_RING0 + NIC_LRO_RINGS))
+    .alloc_mem NIC_LRO_Q_BASE_/**/__LRO_RING emem0 global NIC_LRO_WQ_SZ NIC_LRO_WQ_SZ
+    .init_mu_ring NIC_LRO_Q_IDX_/**/__LRO_RING NIC_LRO_Q_BASE_/**/__LRO_RING 0
+    #define_eval __LRO_RING (__LRO_RING + 1)
+#endloop
+#undef __LRO_RING
+
+/* Control words of the table entries, see lro.h */
+.alloc_mem LM_LRO_CTL lm me (4 * NIC_LRO_ME_ENTRIES) 8
+.init LM_LRO_CTL 0
+
+.reg ctl
+.reg ctx_num
+.reg entry_off
+.reg hdr[NIC_LRO_KEY_LW]
+.reg l3_offset
+.reg limit
+.reg lm_addr
+.reg lro_base
+.reg lro_desc[NIC_LRO_DESC_LW]
+.reg lro_idx
+.reg payload
+.reg pci_isl
+.reg pkt_desc[NIC_LRO_DESC_LW]
+.reg q_base_hi
+.reg q_idx
+.reg seg_hi
+.reg seg_lo
+.reg tmp
+.reg wq[NIC_LRO_WQ_DESC_LW]
+.reg read $x[8]
+.xfer_order $x
+.reg read $rxb
+.sig sig_rd
+.sig sig_wq
+
+/* Point *l$index1 at the control word of entry in_idx of the slice */
+#macro lro_ctl_lm(in_idx)
+    alu[lm_addr, --, B, in_idx, <<2]
+    immed[tmp, LM_LRO_CTL]
+    alu[lm_addr, lm_addr, +, tmp]
+    local_csr_wr[ACTIVE_LM_ADDR_1, lm_addr]
+    nop
+    nop
+    nop
+#endm
+
+/* Flush the aggregate of the entry *l$index1 points at */
+#macro lro_ctl_flush()
+    alu[tmp, entry_off, +, (NIC_LRO_DESC_wrd * 4)]
+    mem[read32, $x[0], lro_base, <<8, tmp, NIC_LRO_DESC_LW], ctx_swap[sig_rd]
+    aggregate_copy(lro_desc, $x, NIC_LRO_DESC_LW)
+    lro_flush(ctl, lro_desc)
+    immed[ctl, 0]
+    alu[*l$index1, --, B, ctl]
+#endm
+
+move(lro_base, ((_nic_lro_tbl + NIC_LRO_ME_INDEX * NIC_LRO_ME_TBL_SIZE) >> 8))
+move(q_base_hi, (((NIC_LRO_Q_BASE_0 >> 32) & 0xff) << 24))
+local_csr_rd[ACTIVE_CTX_STS]
+immed[ctx_num, 0]
+alu[ctx_num, 7, AND, ctx_num]
+
+alu[--, ctx_num, -, NIC_LRO_RINGS]
+beq[tick#]
+bgt[idle#]
+
+#define_eval __LRO_RING NIC_LRO_ME_RING0
+#while (__LRO_RING < (NIC_LRO_ME_RING0 + NIC_LRO_RINGS))
+    immed[q_idx, NIC_LRO_Q_IDX_/**/__LRO_RING]
+    alu[--, ctx_num, -, (__LRO_RING - NIC_LRO_ME_RING0)]
+    beq[wait#]
+    #define_eval __LRO_RING (__LRO_RING + 1)
+#endloop
+#undef __LRO_RING
+
+wait#:
+    mem[qadd_thread, $x[0], q_base_hi, <<8, q_idx, NIC_LRO_WQ_DESC_LW], ctx_swap[sig_wq]
+    alu[wq[NIC_LRO_WQ_BLS_wrd], --, B, $x[NIC_LRO_WQ_BLS_wrd]]
+    beq[sweep#]
+    alu[wq[NIC_LRO_WQ_LEN_wrd], --, B, $x[NIC_LRO_WQ_LEN_wrd]]
+    alu[wq[NIC_LRO_WQ_INFO_wrd], --, B, $x[NIC_LRO_WQ_INFO_wrd]]
+
+    lro_get_nfd_desc(pkt_desc, wq)
+    alu[pci_isl, 3, AND, wq[NIC_LRO_WQ_LEN_wrd], >>BF_L(NIC_LRO_WQ_PCI_bf)]
+    alu[l3_offset, 0xff, AND, wq[NIC_LRO_WQ_INFO_wrd], >>BF_L(NIC_LRO_WQ_L3_OFFSET_bf)]
+
+    // freelist buffer size of the host queue
+    alu[tmp, 0x3f, AND, pkt_desc[NFD_OUT_QID_wrd], >>NFD_OUT_QID_shf]
+    alu[tmp, tmp, OR, pci_isl, <<6]
+    alu[tmp, --, B, tmp, <<2]
+    move(limit, (_fl_buf_sz_cache >> 8))
+    mem[read32, $rxb, limit, <<8, tmp, 1], sig_done[sig_rd]
+
+    // IPv4 addresses and the TCP header up to the first option word
+    alu[seg_hi, --, B, wq[NIC_LRO_WQ_BLS_wrd], <<3]
+    alu[seg_lo, 0x7f, AND, pkt_desc[NFD_OUT_QID_wrd], >>NFD_OUT_METALEN_shf]
+    alu[seg_lo, seg_lo, +, pkt_desc[NFD_OUT_OFFSET_wrd]]
+    alu[seg_lo, seg_lo, +, l3_offset]
+    alu[tmp, seg_lo, +, 12]
+    ctx_arb[sig_rd]
+    alu[limit, --, B, $rxb]
+    mem[read8, $x[0], seg_hi, <<8, tmp, 32], ctx_swap[sig_rd]
+    aggregate_copy(hdr, $x, 6)
+
+    lro_hash(lro_idx, hdr[0], hdr[1], hdr[2])
+    alu[lro_idx, lro_idx, AND, (NIC_LRO_ME_ENTRIES - 1)]
+    lro_ctl_lm(lro_idx)
+    alu[entry_off, --, B, lro_idx, <<NIC_LRO_ENTRY_SZ_LOG2]
+    alu[ctl, --, B, *l$index1]
+    br_bset[wq[NIC_LRO_WQ_INFO_wrd], BF_L(NIC_LRO_WQ_MERGE_bf), merge#]
+
+    // any other packet of the flow goes after its aggregate
+    br_bclr[ctl, BF_L(NIC_LRO_VALID_bf), deliver#]
+    mem[read32, $x[0], lro_base, <<8, entry_off, 3], ctx_swap[sig_rd]
+    alu[--, hdr[0], XOR, $x[0]]
+    bne[deliver#]
+    alu[--, hdr[1], XOR, $x[1]]
+    bne[deliver#]
+    alu[--, hdr[2], XOR, $x[2]]
+    bne[deliver#]
+    lro_ctl_flush()
+
+deliver#:
+    ld_field_w_clr[tmp, 0011, pkt_desc[NFD_OUT_QID_wrd]]
+    alu[--, limit, -, tmp]
+    blo[drop#]
+    lro_send(pkt_desc, pci_isl, --)
+    br[wait#]
+
+drop#:
+    // too large for the freelist buffers, as pkt_io_tx_host()
+    alu[tmp, 3, AND, pkt_desc[NFD_OUT_BLS_wrd], >>NFD_OUT_BLS_shf]
+    alu[seg_hi, pkt_desc[NFD_OUT_BLS_wrd], AND~, 0x7, <<29]
+    pkt_buf_free_mu_buffer(tmp, seg_hi)
+    br[wait#]
+
+merge#:
+    // the LRO action only marks segments with no options or just TS
+    alu[tmp, 0xf, AND, hdr[5], >>BF_L(TCP_DATA_OFFSET_bf)]
+    alu[payload, --, B, tmp, <<2]
+    alu[--, tmp, -, 5]
+    beq[no_ts#], defer[2]
+        immed[hdr[6], 0]
+        immed[hdr[7], 0]
+    alu[tmp, seg_lo, +, (12 + 32)]
+    mem[read8, $x[0], seg_hi, <<8, tmp, 8], ctx_swap[sig_rd]
+    alu[hdr[6], --, B, $x[0]]
+    alu[hdr[7], --, B, $x[1]]
+
+no_ts#:
+    /* payload = data_len - meta_len - l3_offset - 20 - doff * 4, the
+     * LRO action checked nothing trails the IP datagram */
+    ld_field_w_clr[tmp, 0011, pkt_desc[NFD_OUT_QID_wrd]]
+    alu[seg_lo, seg_lo, +, 20]
+    alu[seg_lo, seg_lo, +, payload]
+    alu[payload, tmp, +, pkt_desc[NFD_OUT_OFFSET_wrd]]
+    alu[payload, payload, -, seg_lo]
+
+    // the aggregate keeps to the buffers of the queue and NIC_LRO_MAX_LEN
+    alu[tmp, 0x7f, AND, pkt_desc[NFD_OUT_QID_wrd], >>NFD_OUT_METALEN_shf]
+    alu[tmp, tmp, +, NIC_LRO_MAX_LEN]
+    alu[--, limit, -, tmp]
+    blo[check#]
+    alu[limit, --, B, tmp]
+
+check#:
+    br_bclr[ctl, BF_L(NIC_LRO_VALID_bf), hold#]
+    mem[read32, $x[0], lro_base, <<8, entry_off, NIC_LRO_KEY_LW], ctx_swap[sig_rd]
+    alu[--, hdr[0], XOR, $x[0]]
+    bne[flush#]
+    alu[--, hdr[1], XOR, $x[1]]
+    bne[flush#]
+    alu[--, hdr[2], XOR, $x[2]]
+    bne[flush#]
+
+    // same flow, appending needs the next segment with identical headers
+    alu[--, hdr[3], XOR, $x[3]]
+    bne[flush#]
+    alu[--, hdr[4], XOR, $x[4]]
+    bne[flush#]
+    alu[--, hdr[5], XOR, $x[5]]
+    bne[flush#]
+    alu[--, hdr[6], XOR, $x[6]]
+    bne[flush#]
+    alu[--, hdr[7], XOR, $x[7]]
+    bne[flush#]
+    alu[tmp, 0xff, AND, ctl, >>BF_L(NIC_LRO_SEGS_bf)]
+    alu[--, tmp, -, NIC_LRO_MAX_SEGS]
+    bge[flush#]
+
+    alu[tmp, entry_off, +, (NIC_LRO_DESC_wrd * 4)]
+    mem[read32, $x[0], lro_base, <<8, tmp, (NIC_LRO_DESC_LW + 1)], ctx_swap[sig_rd]
+    aggregate_copy(lro_desc, $x, NIC_LRO_DESC_LW)
+    ld_field_w_clr[tmp, 0011, lro_desc[NFD_OUT_QID_wrd]]
+    alu[tmp, tmp, +, payload]
+    alu[--, $x[NIC_LRO_DESC_LW], -, tmp]
+    blo[flush#]
+
+    lro_append(ctl, lro_base, entry_off, lro_desc, hdr[3], seg_hi, seg_lo, payload)
+    alu[*l$index1, --, B, ctl]
+
+    // only the payload was kept
+    alu[tmp, 3, AND, pkt_desc[NFD_OUT_BLS_wrd], >>NFD_OUT_BLS_shf]
+    alu[seg_hi, pkt_desc[NFD_OUT_BLS_wrd], AND~, 0x7, <<29]
+    pkt_buf_free_mu_buffer(tmp, seg_hi)
+    br[wait#]
+
+flush#:
+    lro_ctl_flush()
+
+hold#:
+    // the segment starts an aggregate
+    lro_hold(ctl, lro_base, entry_off, hdr, payload, pkt_desc, limit, pci_isl, l3_offset)
+    alu[*l$index1, --, B, ctl]
+    br[wait#]
+
+sweep#:
+    alu[lro_idx, --, B, ctx_num]
+
+sweep_entry#:
+    lro_ctl_lm(lro_idx)
+    alu[ctl, --, B, *l$index1]
+    br_bclr[ctl, BF_L(NIC_LRO_VALID_bf), sweep_next#]
+    br_bset[ctl, BF_L(NIC_LRO_AGED_bf), sweep_flush#]
+    alu[*l$index1, ctl, OR, 1, <<BF_L(NIC_LRO_AGED_bf)]
+    br[sweep_next#]
+
+sweep_flush#:
+    alu[entry_off, --, B, lro_idx, <<NIC_LRO_ENTRY_SZ_LOG2]
+    lro_ctl_flush()
+
+sweep_next#:
+    alu[lro_idx, lro_idx, +, NIC_LRO_RINGS]
+    alu[--, lro_idx, -, NIC_LRO_ME_ENTRIES]
+    blo[sweep_entry#]
+    br[wait#]
+
+tick#:
+.begin
+    .reg write $sweep[NIC_LRO_WQ_DESC_LW]
+    .xfer_order $sweep
+    .sig sig_sweep
+
+    timestamp_enable()
+    aggregate_zero($sweep, NIC_LRO_WQ_DESC_LW)
+
+tick_loop#:
+    timestamp_sleep_us(NIC_LRO_SWEEP_US)
+    #define_eval __LRO_RING NIC_LRO_ME_RING0
+    #while (__LRO_RING < (NIC_LRO_ME_RING0 + NIC_LRO_RINGS))
+        immed[q_idx, NIC_LRO_Q_IDX_/**/__LRO_RING]
+        mem[qadd_work, $sweep[0], q_base_hi, <<8, q_idx, NIC_LRO_WQ_DESC_LW], ctx_swap[sig_sweep]
+        #define_eval __LRO_RING (__LRO_RING + 1)
+    #endloop
+    #undef __LRO_RING
+    br[tick_loop#]
+.end
+
+idle#:
+    ctx_arb[kill]
@@ -55,15 +55,15 @@ cmsg_init()
     immed[my_act_ctx, 0]
     alu[my_act_ctx, my_act_ctx, and, 7]
 
+#if (CMSG_ME_INDEX == 0)
     .if (ctx() == 0)
 	        hashmap_alloc_fd(SRIOV_TID, 8, 56, NIC_MAC_VLAN_TABLE__NUM_ENTRIES, --, swap, BPF_MAP_TYPE_HASH)
     .endif
+#endif
 
 main_loop#:
-	ctx_sig_next()
-    cmsg_rx()
-
 	ctx_arb[g_ordersig]
+    cmsg_rx(g_ordersig)
     br[main_loop#]
 
 done#:
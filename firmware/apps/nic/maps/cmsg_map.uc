@@ -7,7 +7,8 @@
  * API calls:
  *	 cmsg_init() - declare global and local resources
  *	 cmsg_rx() - receive from workq and process cmsg
- *	 cmsg_desc_workq() - create GRO descriptors destined for cmsg workq
+ *	 cmsg_desc_workq() - create GRO descriptors destined for the workq of
+ *	                     the cmsg ME owning the map fd
  *
  * typical use
  *	 from datapath action
@@ -22,7 +23,7 @@
  *	from cmsg handler ME
  *		cmsg_init()
  *
- *		cmsg_rx()
+ *		cmsg_rx(order_sig)
  *
  * SPDX-License-Identifier: BSD-2-Clause
  */
@@ -106,11 +107,45 @@
 #define CMSG_LM_FIELD_SZ	(CMSG_MAP_KEY_VALUE_LW * 4)
 #define_eval CMSG_LM_FIELD_SZ_SHFT	(LOG2(CMSG_LM_FIELD_SZ))
 #define MAP_CMSG_IN_WQ_SZ	4096
+/* one more free region of the array pool than there can be array maps */
+#define CMSG_ARRAY_REGIONS	(HASHMAP_MAX_TID_EBPF + 1)
+
+/*
+ * The map control plane can be spread over CMSG_NUM_MES MEs, CMSG_ME_INDEX
+ * is the index of this one. cmsg_desc_workq() queues map operations to the
+ * sub-queue of ME (fd & (CMSG_NUM_MES - 1)), so the messages of one map are
+ * handled in order by a single ME while different maps proceed in parallel.
+ * Map alloc and free, aRFS and anything malformed go to MAP_CMSG_Q_IDX and
+ * ME 0, which owns the fd bitmap and the array pool. The host does not free
+ * a map with operations outstanding on it.
+ */
+#ifndef CMSG_NUM_MES
+	#define CMSG_NUM_MES	1
+#endif
+#ifndef CMSG_ME_INDEX
+	#define CMSG_ME_INDEX	0
+#endif
+#if ((CMSG_NUM_MES & (CMSG_NUM_MES - 1)) != 0)
+	#error "CMSG_NUM_MES must be a power of 2"
+#endif
+#if (CMSG_ME_INDEX >= CMSG_NUM_MES)
+	#error "CMSG_ME_INDEX out of range" (CMSG_ME_INDEX)
+#endif
+
+/* message types forwarded by map fd, the map ops and their batches */
+#define CMSG_FD_OP_TYPES	((0x1f << CMSG_TYPE_MAP_LOOKUP) | (0xf << CMSG_TYPE_MAP_LOOKUP_BATCH))
 
 #macro cmsg_init()
 
 	.alloc_resource MAP_CMSG_Q_IDX emem0_queues global 1
 
+	#define_eval __CMSG_SUBQ 1
+	#while (__CMSG_SUBQ < CMSG_NUM_MES)
+		.alloc_resource MAP_CMSG_SUBQ_IDX_/**/__CMSG_SUBQ emem0_queues global 1
+		#define_eval __CMSG_SUBQ (__CMSG_SUBQ + 1)
+	#endloop
+	#undef __CMSG_SUBQ
+
 #ifdef CMSG_MAP_PROC
 	.init_csr mecsr:CtxEnables.NNreceiveConfig 0x2 const ; 0x2=NN path from CTM MiscEngine
 	slicc_hash_init_nn()
@@ -127,10 +162,30 @@
 	.alloc_mem MAP_CMSG_Q_BASE emem0 global MAP_CMSG_IN_WQ_SZ MAP_CMSG_IN_WQ_SZ
 	.init_mu_ring MAP_CMSG_Q_IDX MAP_CMSG_Q_BASE 0
 
+	#define_eval __CMSG_SUBQ 1
+	#while (__CMSG_SUBQ < CMSG_NUM_MES)
+		.alloc_mem MAP_CMSG_SUBQ_BASE_/**/__CMSG_SUBQ emem0 global MAP_CMSG_IN_WQ_SZ MAP_CMSG_IN_WQ_SZ
+		.init_mu_ring MAP_CMSG_SUBQ_IDX_/**/__CMSG_SUBQ MAP_CMSG_SUBQ_BASE_/**/__CMSG_SUBQ 0
+		#define_eval __CMSG_SUBQ (__CMSG_SUBQ + 1)
+	#endloop
+	#undef __CMSG_SUBQ
+
 	#define CMSG_NUM_FD_BM_LW	((HASHMAP_MAX_TID_EBPF+31)/32)
 	.alloc_mem LM_CMSG_FD_BITMAP lm me (CMSG_NUM_FD_BM_LW * 4) 8
 	.init LM_CMSG_FD_BITMAP 0
 
+	/* free regions of the array pool, [2n] offset and [2n + 1] size */
+	.alloc_mem LM_CMSG_ARRAY_ALLOC lm me (CMSG_ARRAY_REGIONS * 8) 8
+	.init LM_CMSG_ARRAY_ALLOC 0 HASHMAP_ARRAY_POOL_SZ
+
+	/* elements of the per-ME pool reserved by live per-ME maps */
+	.alloc_mem LM_CMSG_PERCPU_ALLOC lm me 4 8
+	.init LM_CMSG_PERCPU_ALLOC 0
+
+	/* [0] aRFS request lock, [1 + v] aRFS entries held by vNIC v */
+	.alloc_mem LM_CMSG_ARFS lm me (4 * (1 + NIC_ARFS_VNICS)) 8
+	.init LM_CMSG_ARFS 0
+
 	.alloc_mem LM_CMSG_BASE	lm me (NUM_CONTEXT * (CMSG_LM_FIELD_SZ * 4)) 8
 	.init LM_CMSG_BASE 0
 
@@ -263,6 +318,203 @@ ret#:
 .end
 #endm
 
+/*
+ * Array map regions are carved from the free regions of the array pool,
+ * first fit, and given back on free, merged with the free regions on either
+ * side. Free regions are separated by live array maps, so there are never
+ * more than CMSG_ARRAY_REGIONS of them. A slot of size 0 is unused.
+ */
+#macro cmsg_array_size(out_size, in_max_entries, in_shft)
+	alu[--, in_shft, or, 0]
+	alu[out_size, --, b, in_max_entries, <<indirect]
+	alu[out_size, out_size, +, (HASHMAP_ARRAY_ALIGN - 1)]
+	alu[out_size, out_size, and~, (HASHMAP_ARRAY_ALIGN - 1)]
+#endm
+
+#macro cmsg_array_alloc(out_offset, out_size, in_max_entries, in_shft, NO_SPACE_LABEL)
+.begin
+	.reg lm_addr
+	.reg limit
+	.reg count
+	.reg region_off
+	.reg region_sz
+	.reg allocated
+
+	immed[allocated, 0]
+	move(limit, HASHMAP_ARRAY_POOL_SZ)
+	alu[--, in_shft, or, 0]
+	alu[limit, --, b, limit, >>indirect]
+	alu[--, in_max_entries, -, 0]
+	beq[NO_SPACE_LABEL]
+	alu[--, limit, -, in_max_entries]
+	blo[NO_SPACE_LABEL]
+
+	cmsg_array_size(out_size, in_max_entries, in_shft)
+
+	immed[lm_addr, LM_CMSG_ARRAY_ALLOC]
+	immed[count, CMSG_ARRAY_REGIONS]
+	cmsg_bm_lm_define()
+	local_csr_wr[ACTIVE_LM_ADDR_/**/CMSG_BM_LM_HANDLE, lm_addr]
+	nop
+	nop
+	nop
+loop#:
+	alu[region_off, --, b, CMSG_BM_LM_INDEX++]
+	alu[region_sz, --, b, CMSG_BM_LM_INDEX++]
+	alu[--, region_sz, -, out_size]
+	bhs[found#]
+	alu[count, count, -, 1]
+	bne[loop#], defer[1]
+		alu[lm_addr, lm_addr, +, 8]
+	br[done#]
+
+found#:
+	local_csr_wr[ACTIVE_LM_ADDR_/**/CMSG_BM_LM_HANDLE, lm_addr]
+	alu[out_offset, --, b, region_off]
+	alu[region_off, region_off, +, out_size]
+	alu[region_sz, region_sz, -, out_size]
+	alu[CMSG_BM_LM_INDEX++, --, b, region_off]
+	alu[CMSG_BM_LM_INDEX, --, b, region_sz]
+	immed[allocated, 1]
+done#:
+	cmsg_bm_lm_undef()
+	alu[--, allocated, -, 0]
+	beq[NO_SPACE_LABEL]
+.end
+#endm
+
+#macro cmsg_array_free(in_offset, in_max_entries, in_shft)
+.begin
+	.reg lm_addr
+	.reg count
+	.reg offset
+	.reg size
+	.reg end
+	.reg region_off
+	.reg region_sz
+	.reg region_end
+	.reg prev_addr
+	.reg prev_off
+	.reg next_addr
+	.reg next_end
+	.reg slot
+
+	cmsg_array_size(size, in_max_entries, in_shft)
+	alu[offset, --, b, in_offset]
+	alu[end, offset, +, size]
+
+	/* find the free regions ending at offset and starting at end */
+	alu[prev_addr, --, ~b, 0]
+	alu[next_addr, --, ~b, 0]
+	immed[lm_addr, LM_CMSG_ARRAY_ALLOC]
+	immed[count, CMSG_ARRAY_REGIONS]
+	cmsg_bm_lm_define()
+	local_csr_wr[ACTIVE_LM_ADDR_/**/CMSG_BM_LM_HANDLE, lm_addr]
+	nop
+	nop
+	nop
+loop#:
+	alu[region_off, --, b, CMSG_BM_LM_INDEX++]
+	alu[region_sz, --, b, CMSG_BM_LM_INDEX++]
+	bne[used#]
+	br[next#], defer[1]
+		alu[slot, --, b, lm_addr]
+used#:
+	alu[region_end, region_off, +, region_sz]
+	alu[--, region_end, -, offset]
+	bne[not_prev#]
+	alu[prev_addr, --, b, lm_addr]
+	alu[prev_off, --, b, region_off]
+not_prev#:
+	alu[--, region_off, -, end]
+	bne[next#]
+	alu[next_addr, --, b, lm_addr]
+	alu[next_end, --, b, region_end]
+next#:
+	alu[count, count, -, 1]
+	bne[loop#], defer[1]
+		alu[lm_addr, lm_addr, +, 8]
+
+	/* grow a neighbour, or take an unused slot */
+	br_bset[next_addr, 31, no_next#]
+	alu[slot, --, b, next_addr]
+	alu[end, --, b, next_end]
+no_next#:
+	br_bset[prev_addr, 31, write#]
+	alu[offset, --, b, prev_off]
+	br_bset[next_addr, 31, prev#]
+
+	/* the region closes the gap between two free regions */
+	local_csr_wr[ACTIVE_LM_ADDR_/**/CMSG_BM_LM_HANDLE, next_addr]
+	nop
+	nop
+	nop
+	alu[CMSG_BM_LM_INDEX++, --, b, 0]
+	alu[CMSG_BM_LM_INDEX, --, b, 0]
+prev#:
+	alu[slot, --, b, prev_addr]
+write#:
+	local_csr_wr[ACTIVE_LM_ADDR_/**/CMSG_BM_LM_HANDLE, slot]
+	alu[size, end, -, offset]
+	nop
+	nop
+	alu[CMSG_BM_LM_INDEX++, --, b, offset]
+	alu[CMSG_BM_LM_INDEX, --, b, size]
+	cmsg_bm_lm_undef()
+.end
+#endm
+
+/*
+ * Per-ME maps reserve max_entries elements of the per-ME pool up front, so
+ * the pool cannot run dry under a map that was accepted.
+ */
+#macro cmsg_percpu_alloc(in_max_entries, NO_SPACE_LABEL)
+.begin
+	.reg lm_addr
+	.reg limit
+	.reg reserved
+	.reg allocated
+
+	immed[allocated, 0]
+	move(limit, HASHMAP_PERCPU_ENTRIES)
+	alu[--, in_max_entries, -, 0]
+	beq[NO_SPACE_LABEL]
+	alu[--, limit, -, in_max_entries]
+	blo[NO_SPACE_LABEL]
+
+	immed[lm_addr, LM_CMSG_PERCPU_ALLOC]
+	cmsg_bm_lm_define()
+	local_csr_wr[ACTIVE_LM_ADDR_/**/CMSG_BM_LM_HANDLE, lm_addr]
+	nop
+	nop
+	nop
+	alu[reserved, CMSG_BM_LM_INDEX, +, in_max_entries]
+	alu[--, limit, -, reserved]
+	blo[done#]
+	alu[CMSG_BM_LM_INDEX, --, b, reserved]
+	immed[allocated, 1]
+done#:
+	cmsg_bm_lm_undef()
+	alu[--, allocated, -, 0]
+	beq[NO_SPACE_LABEL]
+.end
+#endm
+
+#macro cmsg_percpu_free(in_max_entries)
+.begin
+	.reg lm_addr
+
+	immed[lm_addr, LM_CMSG_PERCPU_ALLOC]
+	cmsg_bm_lm_define()
+	local_csr_wr[ACTIVE_LM_ADDR_/**/CMSG_BM_LM_HANDLE, lm_addr]
+	nop
+	nop
+	nop
+	alu[CMSG_BM_LM_INDEX, CMSG_BM_LM_INDEX, -, in_max_entries]
+	cmsg_bm_lm_undef()
+.end
+#endm
+
 
 /*
  * we're working on nfd out descriptor format
@@ -410,8 +662,46 @@ ret#:
 	.reg word, dest
 	.reg desc
 	.reg msk
+#if (CMSG_NUM_MES > 1)
+	.reg cmsg_type
+	.reg fd_types
+	.reg hdr_w0
+	.reg map_fd
+	.reg sub
+	.reg type_bit
+#endif
 
 	move(q_idx, MAP_CMSG_Q_IDX)
+
+#if (CMSG_NUM_MES > 1)
+	/* map operations go to the sub-queue of the ME owning the map fd */
+	pv_seek(in_vec, 0)
+	byte_align_be[--, *$index++]
+	byte_align_be[hdr_w0, *$index++]
+	byte_align_be[map_fd, *$index++]
+
+	ld_field_w_clr[cmsg_type, 0001, hdr_w0, >>24]
+	alu[--, cmsg_type, -, CMSG_TYPE_MAX]
+	bgt[queue#]
+	alu[--, cmsg_type, or, 0]
+	alu[type_bit, --, b, 1, <<indirect]
+	move(fd_types, CMSG_FD_OP_TYPES)
+	alu[--, type_bit, and, fd_types]
+	beq[queue#]
+	alu[sub, map_fd, and, (CMSG_NUM_MES - 1)]
+	beq[queue#]
+
+	#define_eval __CMSG_SUBQ 1
+	#while (__CMSG_SUBQ < CMSG_NUM_MES)
+		immed[q_idx, MAP_CMSG_SUBQ_IDX_/**/__CMSG_SUBQ]
+		alu[--, sub, -, __CMSG_SUBQ]
+		beq[queue#]
+		#define_eval __CMSG_SUBQ (__CMSG_SUBQ + 1)
+	#endloop
+	#undef __CMSG_SUBQ
+
+queue#:
+#endif
 	cmsg_get_gro_workq_desc(o_gro_meta, in_vec, q_idx)
 
 	br[SUCCESS_LABEL]
@@ -437,7 +727,17 @@ ret#:
 #endm
 
 
-#macro cmsg_rx()
+/* pass the receive order on to the next context of this ME */
+#macro cmsg_order_next(ORDER_SIG)
+	local_csr_wr[SAME_ME_SIGNAL, ((&ORDER_SIG<<3)|(1<<7))]
+#endm
+
+/*
+ * Receive and process one control message. Contexts take turns to receive,
+ * a context holds ORDER_SIG and passes it on to the next once its request
+ * for a message is on the queue.
+ */
+#macro cmsg_rx(ORDER_SIG)
 .begin
 	.reg q_base_hi
 	.reg q_idx
@@ -457,16 +757,17 @@ ret#:
 	.reg cmsg_tag
 
     // Fetch work from queue.
-	#define_eval __CMSG_Q_BASE__	MAP_CMSG_Q_BASE
-	#define_eval __CMSG_Q_IDX__		MAP_CMSG_Q_IDX
-
-    move(q_base_hi, (((__CMSG_Q_BASE__ >>32) & 0xff) <<24))
-    immed[q_idx, __CMSG_Q_IDX__]
-
-	#undef __CMSG_Q_BASE__
-	#undef __CMSG_Q_IDX__
+	#if (CMSG_ME_INDEX == 0)
+		move(q_base_hi, (((MAP_CMSG_Q_BASE >>32) & 0xff) <<24))
+		immed[q_idx, MAP_CMSG_Q_IDX]
+	#else
+		move(q_base_hi, (((MAP_CMSG_SUBQ_BASE_/**/CMSG_ME_INDEX >>32) & 0xff) <<24))
+		immed[q_idx, MAP_CMSG_SUBQ_IDX_/**/CMSG_ME_INDEX]
+	#endif
 
-    mem[qadd_thread, $nfd_data[0], q_base_hi, <<8, q_idx, CMSG_DESC_LW], ctx_swap[q_sig]
+	mem[qadd_thread, $nfd_data[0], q_base_hi, <<8, q_idx, CMSG_DESC_LW], sig_done[q_sig]
+	cmsg_order_next(ORDER_SIG)
+	ctx_arb[q_sig]
 	pkt_counter_incr(cmsg_rx)
 
 	alu[nfd_pkt_meta[0], --, b, $nfd_data[0]]
@@ -515,7 +816,7 @@ cmsg_exit#:
 	.reg version
 
 	ld_field_w_clr[o_msg_type, 0001, in_ctrl_w0, >>24]
-    .if(o_msg_type > CMSG_TYPE_MAP_MAX)
+    .if(o_msg_type > CMSG_TYPE_MAX)
 		br[ERROR_LABEL]
     .endif
 
@@ -573,7 +874,7 @@ cmsg_exit#:
 
     // cmsg type  has been validated
     // Process the control message.
-    #define_eval MAX_JUMP (CMSG_TYPE_MAP_MAX + 1)
+    #define_eval MAX_JUMP (CMSG_TYPE_MAX + 1)
     preproc_jump_targets(j, MAX_JUMP)
 
     #ifdef _CMSG_LOOP
@@ -609,12 +910,30 @@ alloc_cont#:
 			_cmsg_free_fd(cur_fd)
 			br[cmsg_proc_ret#]
 
+    s/**/CMSG_TYPE_PRINT#:
+			br[ERROR_LABEL]
+
+    s/**/CMSG_TYPE_ARFS_ADD#:
+    s/**/CMSG_TYPE_ARFS_DELETE#:
+			_cmsg_arfs_op(cmsg_type, HDR_DATA)
+			br[cmsg_proc_ret#]
+
+    s/**/CMSG_TYPE_MAP_DUMP#:
+			_cmsg_map_dump(HDR_DATA)
+			br[cmsg_proc_ret#]
+
     s/**/CMSG_TYPE_MAP_LOOKUP#:
     s/**/CMSG_TYPE_MAP_ADD#:
     s/**/CMSG_TYPE_MAP_DELETE#:
     s/**/CMSG_TYPE_MAP_GETNEXT#:
     s/**/CMSG_TYPE_MAP_GETFIRST#:
+    s/**/CMSG_TYPE_MAP_LOOKUP_BATCH#:
+    s/**/CMSG_TYPE_MAP_UPDATE_BATCH#:
+    s/**/CMSG_TYPE_MAP_DELETE_BATCH#:
 		.begin
+			.reg batch
+			.reg key_step
+			.reg value_step
 			.reg lm_key_offset
 			.reg lm_value_offset
 			.reg save_rc
@@ -642,7 +961,25 @@ alloc_cont#:
 			hashmap_get_fd_attr(cur_fd, map_type, max_entries, done#)
 			immed[save_rc, CMSG_RC_SUCCESS]
 
-			.if (cmsg_type == CMSG_TYPE_MAP_ADD)
+			/* each op takes a 64 byte key and value slot, batches pack them */
+			immed[batch, 0]
+			immed[key_step, 64]
+			immed[value_step, 64]
+			.if (cmsg_type >= CMSG_TYPE_MAP_LOOKUP_BATCH)
+				passert((CMSG_TYPE_MAP_UPDATE_BATCH - CMSG_TYPE_MAP_ADD), "EQ", (CMSG_TYPE_MAP_LOOKUP_BATCH - CMSG_TYPE_MAP_LOOKUP))
+				passert((CMSG_TYPE_MAP_DELETE_BATCH - CMSG_TYPE_MAP_DELETE), "EQ", (CMSG_TYPE_MAP_LOOKUP_BATCH - CMSG_TYPE_MAP_LOOKUP))
+				immed[batch, 1]
+				alu[l_cmsg_type, cmsg_type, -, (CMSG_TYPE_MAP_LOOKUP_BATCH - CMSG_TYPE_MAP_LOOKUP)]
+				ld_field_w_clr[key_step, 0011, MAP_RDXR[__HASHMAP_FD_NDX_KEY], >>16]
+				alu[key_step, --, b, key_step, <<2]
+				ld_field_w_clr[value_step, 0011, MAP_RDXR[__HASHMAP_FD_NDX_VALUE]]
+				alu[value_step, --, b, value_step, <<2]
+				.if (l_cmsg_type == CMSG_TYPE_MAP_DELETE)
+					immed[value_step, 0]
+				.endif
+			.endif
+
+			.if (l_cmsg_type == CMSG_TYPE_MAP_ADD)
 				.if (flags == CMSG_BPF_NOEXIST)
 					immed[l_cmsg_type, HASHMAP_OP_ADD_ONLY]
 				.elif (flags == CMSG_BPF_EXIST)
@@ -658,6 +995,8 @@ proc_loop#:
 
 			alu[--, map_type, -, BPF_MAP_TYPE_ARRAY]
 			beq[proc_array_map#]
+			alu[--, map_type, -, BPF_MAP_TYPE_PERCPU_ARRAY]
+			beq[proc_array_map#]
     		ov_single(OV_LENGTH, CMSG_TXFR_COUNT, OVF_SUBTRACT_ONE) // Length in 32-bit LWs
     		mem[read32_swap, $pkt_data[0], cmsg_addr_hi, <<8, key_offset, max_/**/CMSG_TXFR_COUNT], indirect_ref, sig_done[rd_sig]
 			ctx_arb[rd_sig]
@@ -682,14 +1021,15 @@ proc_array_map#:
             alu[--, max_entries, -, cur_key]
             bgt[array_map_setkey#]
             immed[save_rc, CMSG_RC_ERR_E2BIG]
+            alu[value_offset, key_offset, +, key_step]
             br[done#], defer[2]
-                alu[value_offset, key_offset, +,64]
-                alu[cmsg_reply_pktlen, cmsg_reply_pktlen, +, (64*2)]
+                alu[cmsg_reply_pktlen, cmsg_reply_pktlen, +, key_step]
+                alu[cmsg_reply_pktlen, cmsg_reply_pktlen, +, value_step]
         array_map_setkey#:
 			alu[CMSG_KEY_LM_INDEX++, --, b, cur_key]
 
 proc_loop_cont#:
-			alu[value_offset, key_offset, +, 64]		; value & key offset in cmsg
+			alu[value_offset, key_offset, +, key_step]		; value & key offset in cmsg
 
     		ov_single(OV_LENGTH, CMSG_TXFR_COUNT, OVF_SUBTRACT_ONE) // Length in 32-bit LWs
     		mem[read32_swap, $pkt_data[0], cmsg_addr_hi, <<8, value_offset, max_/**/CMSG_TXFR_COUNT], indirect_ref, sig_done[rd_sig]
@@ -702,15 +1042,32 @@ proc_loop_cont#:
 do_op#:
 			swap(le_key, cur_key, NO_LOAD_CC)
 
-			_cmsg_hashmap_op(l_cmsg_type, cur_fd, lm_key_offset, lm_value_offset, cmsg_addr_hi, key_offset, value_offset, flags, rc, swap, le_key, cur_key)
+			_cmsg_hashmap_op(l_cmsg_type, cur_fd, lm_key_offset, lm_value_offset, cmsg_addr_hi, key_offset, value_offset, flags, batch, rc, swap, le_key, cur_key)
     /* check if reply required */
-            alu[--, cur_fd, -, SRIOV_TID]
-            beq[FREE_LABEL]
-			alu[key_offset, value_offset, +, 64]
-			alu[cmsg_reply_pktlen, cmsg_reply_pktlen, +, (64*2)]
+			.if (cur_fd == SRIOV_TID)
+				/* datapath VEB caches are flushed once this changes, only
+				 * entries that were added or removed invalidate them */
+				.if (rc == CMSG_RC_SUCCESS)
+					.if ((l_cmsg_type == CMSG_TYPE_MAP_ADD) || (l_cmsg_type == CMSG_TYPE_MAP_DELETE) || (l_cmsg_type >= HASHMAP_OP_UPDATE))
+						.if (l_cmsg_type <= HASHMAP_OP_MAX)
+							.begin
+								.reg gen_addr
+								move(gen_addr, (_nic_mac_vlan_gen >> 8))
+								mem[incr, --, gen_addr, <<8, 0, 1]
+							.end
+						.endif
+					.endif
+				.endif
+				br[FREE_LABEL]
+			.endif
+			alu[key_offset, value_offset, +, value_step]
+			alu[cmsg_reply_pktlen, cmsg_reply_pktlen, +, key_step]
+			alu[cmsg_reply_pktlen, cmsg_reply_pktlen, +, value_step]
 			alu[save_rc, save_rc, or, rc]
 			.if (rc == CMSG_RC_SUCCESS)
 				alu[rtn_count, 1, +, rtn_count]
+			.elif (batch != 0)
+				br[done#]							; batches stop at the first failure
 			.endif
 			alu[count, count, -, 1]
 			beq[done#]
@@ -722,13 +1079,13 @@ do_op#:
 					br[done#]
 				.endif
 				br[do_op#], defer[1]
-				alu[value_offset, key_offset, +, 64]
+				alu[value_offset, key_offset, +, key_step]
 			.elif (l_cmsg_type == CMSG_TYPE_MAP_ARRAY_GETNEXT)
 				alu[cur_key, cur_key, +, 1]
 				alu[--, max_entries, -, cur_key]
 				beq[done#]
 				br[do_op#], defer[1]
-				alu[value_offset, key_offset, +, 64]
+				alu[value_offset, key_offset, +, key_step]
 			.endif
 			br[proc_loop#]
 
@@ -755,7 +1112,9 @@ cmsg_proc_ret#:
 		.xfer_order $reply
 		.sig sig_reply_map_alloc
 		.reg addr_lo
-
+		.reg array_offset
+		.reg array_size
+		.reg array_shft
 
 		immed[$reply[1], CMSG_RC_ERR_MAP_FD]		; error
 		immed[fd, 0]
@@ -763,11 +1122,30 @@ cmsg_proc_ret#:
 
 		cmsg_alloc_fd_from_bm(fd, cont#)			; skip alloc if no free slots
 
-		// driver will initialize arraymap
-		hashmap_alloc_fd(fd, key_sz, value_sz, max_entries, cont#, endian, map_type)
+		immed[array_offset, 0]
+		immed[array_shft, 0]
+		.if ((map_type == BPF_MAP_TYPE_ARRAY) || (map_type == BPF_MAP_TYPE_PERCPU_ARRAY))
+			hashmap_array_shft(value_sz, array_shft)
+			/* per-ME arrays keep a value per datapath ME at each index */
+			.if (map_type == BPF_MAP_TYPE_PERCPU_ARRAY)
+				alu[array_shft, array_shft, +, HASHMAP_PERCPU_SLOTS_LOG2]
+			.endif
+			cmsg_array_alloc(array_offset, array_size, max_entries, array_shft, no_space#)
+			hashmap_array_clear(array_offset, array_size)
+		.endif
+
+		__hashmap_is_percpu(map_type, alloc_fd#)
+		cmsg_percpu_alloc(max_entries, no_space#)
+
+alloc_fd#:
+		hashmap_alloc_fd(fd, key_sz, value_sz, max_entries, cont#, endian, map_type, array_offset, array_shft)
 
 		immed[$reply[1], CMSG_RC_SUCCESS]			; success
 		alu[$reply[2], --, b, fd]
+		br[cont#]
+
+no_space#:
+		cmsg_free_fd_from_bm(fd, cont#)
 
 cont#:
 		cmsg_set_reply($reply[0], CMSG_TYPE_MAP_ALLOC, cmsg_tag)
@@ -781,6 +1159,186 @@ ret#:
 .end
 #endm
 
+/* Requests on the aRFS table are handled one at a time, so the entry counts
+ * follow the slots. The lock lives in LM, testing and taking it does not
+ * swap out, so no other context of the ME can slip in between.
+ */
+#macro _cmsg_arfs_lock()
+.begin
+	.reg lm_addr
+
+	immed[lm_addr, LM_CMSG_ARFS]
+	cmsg_bm_lm_define()
+	local_csr_wr[ACTIVE_LM_ADDR_/**/CMSG_BM_LM_HANDLE, lm_addr]
+	nop
+	nop
+	nop
+retry#:
+	alu[--, --, b, CMSG_BM_LM_INDEX]
+	beq[locked#]
+	ctx_arb[voluntary], br[retry#]
+locked#:
+	immed[CMSG_BM_LM_INDEX, 1]
+	cmsg_bm_lm_undef()
+.end
+#endm
+
+#macro _cmsg_arfs_unlock()
+.begin
+	.reg lm_addr
+
+	immed[lm_addr, LM_CMSG_ARFS]
+	cmsg_bm_lm_define()
+	local_csr_wr[ACTIVE_LM_ADDR_/**/CMSG_BM_LM_HANDLE, lm_addr]
+	nop
+	nop
+	nop
+	immed[CMSG_BM_LM_INDEX, 0]
+	cmsg_bm_lm_undef()
+.end
+#endm
+
+/* Count an entry in (OP inc) or out (OP dec) of the vNIC it belongs to,
+ * in_entry is word 0 of the entry. The vNIC bit in _nic_arfs_vnics follows
+ * the count through zero.
+ */
+#macro _cmsg_arfs_count(in_entry, OP)
+.begin
+	.reg lm_addr
+	.reg vnic
+	.reg count
+	.reg addr_hi
+	.reg write $vnic_bit
+	.sig sig_vnic_bit
+
+	alu[vnic, BF_MASK(NIC_ARFS_VNIC_bf), and, in_entry, >>BF_L(NIC_ARFS_VNIC_bf)]
+	alu[lm_addr, --, b, vnic, <<2]
+	alu[lm_addr, lm_addr, +, 4]
+	immed[count, LM_CMSG_ARFS]
+	alu[lm_addr, lm_addr, +, count]
+	cmsg_bm_lm_define()
+	local_csr_wr[ACTIVE_LM_ADDR_/**/CMSG_BM_LM_HANDLE, lm_addr]
+	nop
+	nop
+	nop
+	#if (streq('OP', 'inc'))
+		alu[count, CMSG_BM_LM_INDEX, +, 1]
+		alu[CMSG_BM_LM_INDEX, --, b, count]
+		alu[--, count, -, 1]
+	#else
+		alu[count, CMSG_BM_LM_INDEX, -, 1]
+		alu[CMSG_BM_LM_INDEX, --, b, count]
+	#endif
+	bne[done#]
+
+	alu[--, vnic, or, 0]
+	alu[$vnic_bit, --, b, 1, <<indirect]
+	move(addr_hi, (_nic_arfs_vnics >> 8))
+	#if (streq('OP', 'inc'))
+		mem[set, $vnic_bit, addr_hi, <<8, (_nic_arfs_vnics & 0xff), 1], ctx_swap[sig_vnic_bit]
+	#else
+		mem[clr, $vnic_bit, addr_hi, <<8, (_nic_arfs_vnics & 0xff), 1], ctx_swap[sig_vnic_bit]
+	#endif
+done#:
+	cmsg_bm_lm_undef()
+.end
+#endm
+
+/* Add or remove an aRFS steering entry. The table is direct mapped, so an
+ * add replaces whichever flow held the slot, while a delete only clears the
+ * slot if it still holds the flow described by the request.
+ */
+#macro _cmsg_arfs_op(in_cmsg_type, HDR_DATA)
+.begin
+		.reg read $arfs_entry[3]
+		.xfer_order $arfs_entry
+		.reg write $arfs_wr[3]
+		.xfer_order $arfs_wr
+		.reg write $reply[2]
+		.xfer_order $reply
+		.sig sig_arfs
+		.sig sig_reply_arfs
+		.reg addr_lo
+		.reg arfs_base, arfs_offset
+		.reg entry, cur_entry
+		.reg hash, ports
+		.reg hash_type, queue, vnic
+		.reg vnic_diff
+		.reg rc
+
+		alu[vnic, --, b, HDR_DATA[CMSG_ARFS_VNIC_IDX]]
+		alu[queue, --, b, HDR_DATA[CMSG_ARFS_QUEUE_IDX]]
+		alu[hash_type, --, b, HDR_DATA[CMSG_ARFS_HASH_TYPE_IDX]]
+		alu[hash, --, b, HDR_DATA[CMSG_ARFS_HASH_IDX]]
+		alu[ports, --, b, HDR_DATA[CMSG_ARFS_PORTS_IDX]]
+
+		immed[rc, CMSG_RC_ERR_EINVAL]
+		.if (vnic > BF_MASK(NIC_ARFS_VNIC_bf))
+			br[reply#]
+		.elif (queue > BF_MASK(NIC_ARFS_QUEUE_bf))
+			br[reply#]
+		.elif (hash_type > BF_MASK(NIC_ARFS_HASH_TYPE_bf))
+			br[reply#]
+		.endif
+
+		/* word 0 of the entry without the queue identifies the flow */
+		alu[entry, --, b, vnic, <<BF_L(NIC_ARFS_VNIC_bf)]
+		alu[entry, entry, or, hash_type, <<BF_L(NIC_ARFS_HASH_TYPE_bf)]
+		alu[entry, entry, or, 1, <<BF_L(NIC_ARFS_VALID_bf)]
+
+		alu[arfs_offset, --, b, hash, <<(32 - NIC_ARFS_TBL_ENTRIES_LOG2)]
+		alu[arfs_offset, --, b, arfs_offset, >>(32 - NIC_ARFS_TBL_ENTRIES_LOG2 - NIC_ARFS_ENTRY_SZ_LOG2)]
+		move(arfs_base, (_nic_arfs_tbl >> 8))
+
+		_cmsg_arfs_lock()
+		mem[read32, $arfs_entry[0], arfs_base, <<8, arfs_offset, 3], ctx_swap[sig_arfs]
+		alu[cur_entry, $arfs_entry[0], and~, BF_MASK(NIC_ARFS_QUEUE_bf), <<BF_L(NIC_ARFS_QUEUE_bf)]
+
+		.if (in_cmsg_type == CMSG_TYPE_ARFS_ADD)
+			alu[$arfs_wr[0], entry, or, queue, <<BF_L(NIC_ARFS_QUEUE_bf)]
+			alu[$arfs_wr[1], --, b, hash]
+			alu[$arfs_wr[2], --, b, ports]
+		.else
+			immed[rc, CMSG_RC_ERR_ENOENT]
+			alu[--, hash, xor, $arfs_entry[1]]
+			bne[unlock#]
+			alu[--, ports, xor, $arfs_entry[2]]
+			bne[unlock#]
+			alu[--, entry, xor, cur_entry]
+			bne[unlock#]
+			immed[$arfs_wr[0], 0]
+			immed[$arfs_wr[1], 0]
+			immed[$arfs_wr[2], 0]
+		.endif
+		mem[write32, $arfs_wr[0], arfs_base, <<8, arfs_offset, 3], ctx_swap[sig_arfs]
+		immed[rc, CMSG_RC_SUCCESS]
+
+		/* the flow that held the slot leaves, an added one takes its place */
+		br_bclr[cur_entry, BF_L(NIC_ARFS_VALID_bf), count_add#]
+		.if (in_cmsg_type == CMSG_TYPE_ARFS_ADD)
+			alu[vnic_diff, entry, xor, cur_entry]
+			alu[--, vnic_diff, and, BF_MASK(NIC_ARFS_VNIC_bf), <<BF_L(NIC_ARFS_VNIC_bf)]
+			beq[unlock#]
+		.endif
+		_cmsg_arfs_count(cur_entry, dec)
+count_add#:
+		.if (in_cmsg_type == CMSG_TYPE_ARFS_ADD)
+			_cmsg_arfs_count(entry, inc)
+		.endif
+
+unlock#:
+		_cmsg_arfs_unlock()
+
+reply#:
+		cmsg_set_reply($reply[0], in_cmsg_type, cmsg_tag)
+		alu[$reply[1], --, b, rc]
+		immed[addr_lo, NFD_IN_DATA_OFFSET]
+		mem[write32, $reply[0], cmsg_addr_hi, <<8, addr_lo, 2], sig_done[sig_reply_arfs]
+		immed[cmsg_reply_pktlen, (2<<2)]
+		ctx_arb[sig_reply_arfs]
+.end
+#endm
+
 #macro _cmsg_free_fd(in_fd)
 .begin
 		.reg del_entries
@@ -792,14 +1350,31 @@ ret#:
 		.reg value_sz
 		.reg ent_state, ent_addr_hi, ent_offset, mu_partition, ent_index
 		.reg tbl_addr_hi, out_ent_lw
+		.reg map_type, max_entries
+		.reg array_offset, array_shft
 
 		immed[del_entries, 0]
 
 		immed[$reply[1], CMSG_RC_ERR_MAP_FD]			;
 		cmsg_free_fd_from_bm(in_fd, ret#)
 
+		hashmap_get_fd_attr(in_fd, map_type, max_entries, ret#)
+		ld_field_w_clr[key_sz, 0011, MAP_RDXR[__HASHMAP_FD_NDX_KEY], >>16]
+		alu[array_offset, --, b, MAP_RDXR[__HASHMAP_FD_NDX_ARRAY_OFF]]
+		alu[array_shft, --, b, MAP_RDXR[__HASHMAP_FD_NDX_ARRAY_SHFT]]
 		__hashmap_table_delete(in_fd)		/* set num entries to 0 */
 
+		/* array maps have no entries in the hash table */
+		.if ((map_type == BPF_MAP_TYPE_ARRAY) || (map_type == BPF_MAP_TYPE_PERCPU_ARRAY))
+			cmsg_array_free(array_offset, max_entries, array_shft)
+			br[end_loop#]
+		.endif
+
+		__hashmap_is_percpu(map_type, free_entries#)
+		cmsg_percpu_free(max_entries)
+
+free_entries#:
+
 		immed[ent_index, 0]
 loop#:
 		__hashmap_lock_init(ent_state, ent_addr_hi, ent_offset, mu_partition, ent_index)
@@ -816,6 +1391,9 @@ cont#:
 del_ent#:
         __hashmap_lock_upgrade(ent_index, ent_state, loop#)
         __hashmap_set_opt_field(out_ent_lw, 0)
+        __hashmap_is_percpu(map_type, del_cont#)
+        __hashmap_percpu_release(ent_addr_hi, ent_offset, key_sz)
+del_cont#:
         br_bset[ent_state, __HASHMAP_DESC_OV_BIT, delete_ov_ent#]
         __hashmap_lock_release_and_invalidate(ent_index, ent_state, in_fd)
 
@@ -848,7 +1426,7 @@ ret#:
 #define_eval _CMSG_FLD_LW 			(CMSG_MAP_KEY_VALUE_LW)
 #define_eval _CMSG_FLD_LW_MINUS_1   (_CMSG_FLD_LW - 1)
 
-#macro _cmsg_hashmap_op(in_op, in_fd, in_lm_key, in_lm_value, in_addr_hi, in_key_offset, in_value_offset, in_flags, out_rc, endian, array_lekey, array_bekey)
+#macro _cmsg_hashmap_op(in_op, in_fd, in_lm_key, in_lm_value, in_addr_hi, in_key_offset, in_value_offset, in_flags, in_batch, out_rc, endian, array_lekey, array_bekey)
 .begin
 	.reg op
 	.sig sig_read_ent
@@ -860,6 +1438,7 @@ ret#:
 	.reg error_value
 	.reg r_addr[2]
 	.reg ent_offset
+	.reg slot_shft
 	.reg tmp
 
 	aggregate_directive(.set, $ent_reply, _CMSG_FLD_LW)
@@ -955,6 +1534,10 @@ error_map_function#:
     .elif (out_rc == CMSG_RC_ERR_ENOMEM)
         immed[out_rc, CMSG_RC_ERR_NOMEM]
     .endif
+	/* batches report the failed element in the reply header only */
+	.if (in_batch != 0)
+		br[ret#]
+	.endif
 	move(error_value, 0xffff0000)
 	alu[$ent_reply[0], error_value, or, out_rc]
 	alu[ent_offset, in_key_offset, +, (15*4)]				; write FFs and rc to last 1 words of key
@@ -988,12 +1571,29 @@ reply_keys#:
 	alu[tmp, --, b, reply_lw, <<2]
     __hashmap_calc_value_addr(r_addr[1], tmp, r_addr[1])
 	alu[reply_lw, 16, -, reply_lw]
-	ctx_arb[sig_reply_map_ops]				; falls thru
+	ctx_arb[sig_reply_map_ops]
+	__hashmap_is_percpu(map_type, reply_value#)
+	__hashmap_percpu_addr(r_addr[0], r_addr[1])		; falls thru
 
 reply_value#:
     alu[--, reply_lw, -, 0]
     beq[error_map_function#], defer[1]
         immed[out_rc, CMSG_RC_ERR_MAP_ERR]
+	/* per-ME maps reply with the sum of the slots of the element */
+	alu[--, map_type, -, BPF_MAP_TYPE_PERCPU_ARRAY]
+	beq[percpu_array#]
+	__hashmap_is_percpu(map_type, read_value#)
+	immed[slot_shft, HASHMAP_PERCPU_SLOT_SZ_SHFT]
+	br[percpu_sum#]
+percpu_array#:
+	alu[tmp, --, b, reply_lw, <<2]
+	hashmap_array_shft(tmp, slot_shft)
+percpu_sum#:
+	aggregate_zero($ent_reply, _CMSG_FLD_LW)
+	__hashmap_percpu_sum($ent_reply, _CMSG_FLD_LW, lm_value_offset, r_addr[0], r_addr[1], slot_shft, reply_lw)
+	br[write_value#]
+
+read_value#:
 	ov_start(OV_LENGTH)
     ov_set_use(OV_LENGTH, reply_lw, OVF_SUBTRACT_ONE)   ; length is in 32-bit LWs
     ov_clean
@@ -1003,7 +1603,15 @@ reply_value#:
 
 	unroll_copy($ent_reply, 0, $ent_reply, 0, reply_lw, _CMSG_FLD_LW, --)
 
-	ov_single(OV_LENGTH, _CMSG_FLD_LW, OVF_SUBTRACT_ONE)
+write_value#:
+	/* batches pack the values, only the value itself is written back */
+	immed[tmp, _CMSG_FLD_LW]
+	.if (in_batch != 0)
+		alu[tmp, --, b, reply_lw]
+	.endif
+	ov_start(OV_LENGTH)
+    ov_set_use(OV_LENGTH, tmp, OVF_SUBTRACT_ONE)   ; length is in 32-bit LWs
+    ov_clean
     mem[write32, $ent_reply[0], in_addr_hi, <<8, in_value_offset, max_/**/_CMSG_FLD_LW], indirect_ref, sig_done[sig_reply_map_ops]
 
 	immed[out_rc, CMSG_RC_SUCCESS]
@@ -1014,59 +1622,207 @@ ret#:
 .end
 #endm
 
+
+#macro _cmsg_dump_room(FULL_LABEL)
+	alu[--, count, -, 0]
+	beq[FULL_LABEL]
+	alu[--, room, -, elem_sz]
+	blo[FULL_LABEL]
+#endm
+
 /*
- * This macro is currently not used.  Driver initializes arraymap
- * init array map entries
- * array maps:  key_size = 4, key = 0..max_entries-1
- *              value_size must be zeroed
- * TABLE_OP = INIT or CLEANUP
+ * Return the entries of a map from a cursor, as many as the request asked
+ * for and the reply has room for, packed as in the batch messages. A hash
+ * map cursor is the bucket index and the slot in the bucket, 0 for the
+ * primary entry and n+1 for overflow entry n, so a dump resumes without
+ * looking up the last key returned. An array map cursor is the index.
  */
-#macro _cmsg_arraymap_table_op(in_fd, in_num_entries, SUCCESS_LABEL, TABLE_OP)
+#macro _cmsg_map_dump(HDR_DATA)
 .begin
-	.reg lm_key_offset
-	.reg lm_value_offset
-	.reg ctx_num
-	.reg array_ndx
-	.reg reply_lw
-	//.reg le_key
-
-	local_csr_rd[ACTIVE_CTX_STS]
-    immed[ctx_num, 0]
-    alu[ctx_num, ctx_num, and, 7]
-
-	cmsg_lm_ctx_addr(lm_key_offset, lm_value_offset, ctx_num)
-	cmsg_lm_handles_define()
-
-    local_csr_wr[ACTIVE_LM_ADDR_/**/CMSG_VALUE_LM_HANDLE, lm_value_offset]
-	immed[array_ndx, 0]
-    nop
-    nop
-	aggregate_zero(CMSG_VALUE_LM_INDEX, CMSG_TXFR_COUNT)
-
-init_loop#:
-	local_csr_wr[ACTIVE_LM_ADDR_/**/CMSG_KEY_LM_HANDLE, lm_key_offset]
-		nop
-		swap(le_key, array_ndx, NO_LOAD_CC)
-	alu[CMSG_KEY_LM_INDEX++, --, b, le_key]
-
-    cmsg_lm_handles_undef()
-
-	#if (streq('TABLE_OP', 'INIT'))
-		hashmap_ops(in_fd, lm_key_offset, lm_value_offset, HASHMAP_OP_ADD_ANY, error_rtn#, error_rtn#, HASHMAP_RTN_ADDR, reply_lw, --, --, be)
-	#else
-		hashmap_ops(in_fd, lm_key_offset, lm_value_offset, HASHMAP_OP_REMOVE, error_rtn#, error_rtn#, HASHMAP_RTN_ADDR, reply_lw, --, --, be)
-	#endif
-
-	alu[--, reply_lw, -, 0]
-	bne[error_rtn#]
-
-	alu[array_ndx, 1, +, array_ndx]
-	alu[--, in_num_entries, -, array_ndx]
-	bne[init_loop#]
+	.reg fd, count, cursor, rc, rtn_count
+	.reg map_type, max_entries
+	.reg key_lw, value_lw, key_bytes, elem_sz
+	.reg room, out_offset, value_out
+	.reg ent_index, slot
+	.reg ent_state, ent_addr_hi, ent_offset, tbl_addr_hi, mu_partition
+	.reg value_offset
+	.reg array_shft, array_off, is_array, slot_shft
+	.reg lm_key_offset, lm_value_offset
+	.reg tmp
+	.reg $dump[CMSG_TXFR_COUNT]
+	.xfer_order $dump
+	.reg write $reply[4]
+	.xfer_order $reply
+	.sig sig_dump_rd
+	.sig sig_dump_wr
+	.sig sig_reply_dump
+	.reg addr_lo
 
-	br[SUCCESS_LABEL]
+	/* hash cursor: MU partition, bucket index, slot in the bucket */
+	#define_eval _CMSG_DUMP_PART_SHFT	(HASHMAP_NUM_ENTRIES_SHFT + 4)
+	passert(HASHMAP_ENTRIES_PER_BUCKET, "LT", 16)
+	passert((_CMSG_DUMP_PART_SHFT + 2), "LE", 31)
+
+	alu[fd, --, b, HDR_DATA[CMSG_MAP_TID_IDX]]
+	alu[count, --, b, HDR_DATA[CMSG_MAP_OP_COUNT_IDX]]
+	immed[rtn_count, 0]
+	immed[out_offset, (NFD_IN_DATA_OFFSET + (CMSG_OP_HDR_LW * 4))]
+	move(cursor, CMSG_MAP_DUMP_END)
+
+	immed[rc, CMSG_RC_ERR_MAP_FD]
+	hashmap_get_fd_attr(fd, map_type, max_entries, reply#)
+	immed[rc, CMSG_RC_SUCCESS]
+	ld_field_w_clr[key_lw, 0011, MAP_RDXR[__HASHMAP_FD_NDX_KEY], >>16]
+	ld_field_w_clr[value_lw, 0011, MAP_RDXR[__HASHMAP_FD_NDX_VALUE]]
+	alu[array_shft, --, b, MAP_RDXR[__HASHMAP_FD_NDX_ARRAY_SHFT]]
+	alu[array_off, --, b, MAP_RDXR[__HASHMAP_FD_NDX_ARRAY_OFF]]
+	alu[key_bytes, --, b, key_lw, <<2]
+	alu[elem_sz, key_bytes, +, value_lw, <<2]
+	move(room, CMSG_MAP_DUMP_DATA_SZ)
 
-error_rtn#:
+	local_csr_rd[ACTIVE_CTX_STS]
+	immed[tmp, 0]
+	alu[tmp, tmp, and, 7]
+	cmsg_lm_ctx_addr(lm_key_offset, lm_value_offset, tmp)
+
+	alu[cursor, --, b, HDR_DATA[CMSG_MAP_DUMP_CURSOR_IDX]]
+	alu[--, cursor, +, 1]						; dump already complete
+	beq[reply#]
+
+	immed[is_array, 1]
+	alu[--, map_type, -, BPF_MAP_TYPE_ARRAY]
+	beq[array_walk#]
+	alu[--, map_type, -, BPF_MAP_TYPE_PERCPU_ARRAY]
+	beq[array_walk#]
+	br[hash_walk#], defer[1]
+		immed[is_array, 0]
+
+array_walk#:
+	alu[ent_index, --, b, cursor]
+	move(ent_addr_hi, HASHMAP_ARRAY_BASE >>8)
+array_next#:
+	alu[--, ent_index, -, max_entries]
+	bhs[walk_end#]
+	_cmsg_dump_room(full_array#)
+	/* the key is the index, little endian as in the request */
+	swap(tmp, ent_index, NO_LOAD_CC)
+	alu[$dump[0], --, b, tmp]
+	mem[write32, $dump[0], cmsg_addr_hi, <<8, out_offset, 1], ctx_swap[sig_dump_wr]
+	alu[--, array_shft, or, 0]
+	alu[value_offset, --, b, ent_index, <<indirect]
+	alu[value_offset, value_offset, +, array_off]
+	br[emit_value#], defer[1]
+		alu[ent_index, ent_index, +, 1]
+
+full_array#:
+	br[reply#], defer[1]
+		alu[cursor, --, b, ent_index]
+
+hash_walk#:
+	alu[ent_index, --, b, cursor, <<(32 - _CMSG_DUMP_PART_SHFT)]
+	alu[ent_index, --, b, ent_index, >>(32 - _CMSG_DUMP_PART_SHFT + 4)]
+	alu[slot, cursor, and, 0xf]
+	alu[mu_partition, --, b, cursor, >>_CMSG_DUMP_PART_SHFT]
+	alu[--, mu_partition, -, HASHMAP_PARTITIONS]
+	bhs[walk_end#]
+
+bucket#:
+	__hashmap_lock_init(ent_state, ent_addr_hi, ent_offset, mu_partition, ent_index)
+	alu[tbl_addr_hi, --, b, ent_addr_hi]
+	__hashmap_lock_shared(ent_index, fd, ov_first#, ov_first#)
+	alu[--, slot, -, 0]
+	bne[ov_first#]
+	_cmsg_dump_room(full_hash#)
+	br[emit_key#]
+
+ov_first#:
+	/* resume with overflow entry slot - 1 */
+	alu[--, slot, -, 1]
+	ble[ov_next#]
+	alu[tmp, slot, -, 2]
+	alu[ent_state, ent_state, or, tmp, <<__HASHMAP_DESC_OV_IDX]
+	alu[ent_state, ent_state, or, 1, <<__HASHMAP_DESC_OV_BIT]
+ov_next#:
+	__hashmap_ov_getnext(tbl_addr_hi, ent_index, fd, ent_addr_hi, ent_offset, ent_state, ov_found#)
+	__hashmap_lock_release(ent_index, ent_state)
+	immed[slot, 0]
+	__hashmap_select_next_/**/HASHMAP_PARTITIONS/**/_partition(mu_partition, ent_index, walk_end#)
+	br[bucket#]
+
+ov_found#:
+	alu[slot, ent_state, >>__HASHMAP_DESC_OV_IDX]
+	alu[slot, slot, and, 7]
+	alu[slot, slot, +, 1]
+	_cmsg_dump_room(full_hash#)
+
+emit_key#:
+	ov_start(OV_LENGTH)
+	ov_set_use(OV_LENGTH, key_lw, OVF_SUBTRACT_ONE)		; length is in 32-bit LWs
+	ov_clean
+	mem[read32, $dump[0], ent_addr_hi, <<8, ent_offset, max_/**/CMSG_TXFR_COUNT], indirect_ref, ctx_swap[sig_dump_rd]
+	unroll_copy($dump, 0, $dump, 0, key_lw, CMSG_TXFR_COUNT, --)
+	ov_start(OV_LENGTH)
+	ov_set_use(OV_LENGTH, key_lw, OVF_SUBTRACT_ONE)
+	ov_clean
+	mem[write32, $dump[0], cmsg_addr_hi, <<8, out_offset, max_/**/CMSG_TXFR_COUNT], indirect_ref, ctx_swap[sig_dump_wr]
+	__hashmap_calc_value_addr(ent_offset, key_bytes, value_offset)
+
+emit_value#:
+	alu[value_out, out_offset, +, key_bytes]
+	/* per-ME maps return the sum of the slots of the element */
+	alu[--, map_type, -, BPF_MAP_TYPE_PERCPU_ARRAY]
+	bne[percpu_hash#]
+	alu[slot_shft, array_shft, -, HASHMAP_PERCPU_SLOTS_LOG2]
+	__hashmap_percpu_sum($dump, CMSG_TXFR_COUNT, lm_value_offset, ent_addr_hi, value_offset, slot_shft, value_lw)
+	br[write_value#]
+percpu_hash#:
+	__hashmap_is_percpu(map_type, read_value#)
+	__hashmap_percpu_elem(ent_addr_hi, value_offset, tmp)
+	alu[tmp, --, b, tmp, <<HASHMAP_PERCPU_ELEM_SZ_SHFT]
+	move(value_offset, HASHMAP_PERCPU_BASE >>8)
+	immed[slot_shft, HASHMAP_PERCPU_SLOT_SZ_SHFT]
+	__hashmap_percpu_sum($dump, CMSG_TXFR_COUNT, lm_value_offset, value_offset, tmp, slot_shft, value_lw)
+	br[write_value#]
+read_value#:
+	ov_start(OV_LENGTH)
+	ov_set_use(OV_LENGTH, value_lw, OVF_SUBTRACT_ONE)
+	ov_clean
+	mem[read32, $dump[0], ent_addr_hi, <<8, value_offset, max_/**/CMSG_TXFR_COUNT], indirect_ref, ctx_swap[sig_dump_rd]
+	unroll_copy($dump, 0, $dump, 0, value_lw, CMSG_TXFR_COUNT, --)
+write_value#:
+	ov_start(OV_LENGTH)
+	ov_set_use(OV_LENGTH, value_lw, OVF_SUBTRACT_ONE)
+	ov_clean
+	mem[write32, $dump[0], cmsg_addr_hi, <<8, value_out, max_/**/CMSG_TXFR_COUNT], indirect_ref, ctx_swap[sig_dump_wr]
+
+	alu[out_offset, out_offset, +, elem_sz]
+	alu[room, room, -, elem_sz]
+	alu[rtn_count, rtn_count, +, 1]
+	alu[count, count, -, 1]
+	alu[--, is_array, -, 0]
+	bne[array_next#]
+	br[ov_next#]
+
+full_hash#:
+	__hashmap_lock_release(ent_index, ent_state)
+	alu[cursor, --, b, ent_index, <<4]
+	alu[cursor, cursor, or, mu_partition, <<_CMSG_DUMP_PART_SHFT]
+	br[reply#], defer[1]
+		alu[cursor, cursor, or, slot]
+
+walk_end#:
+	move(cursor, CMSG_MAP_DUMP_END)
+
+reply#:
+	cmsg_set_reply($reply[0], CMSG_TYPE_MAP_DUMP, cmsg_tag)
+	alu[$reply[1], --, b, rc]
+	alu[$reply[2], --, b, rtn_count]
+	alu[$reply[3], --, b, cursor]
+	immed[addr_lo, NFD_IN_DATA_OFFSET]
+	mem[write32, $reply[0], cmsg_addr_hi, <<8, addr_lo, 4], sig_done[sig_reply_dump]
+	alu[cmsg_reply_pktlen, out_offset, -, addr_lo]
+	ctx_arb[sig_reply_dump]
+	#undef _CMSG_DUMP_PART_SHFT
 .end
 #endm
 
@@ -183,6 +183,73 @@
  *       +---------------------------------------------------------------+
  *    1  |   RC                                                          |
  *       +---------------------------------------------------------------+
+ *
+ *  map_lookup_batch / map_update_batch / map_delete_batch request
+ *       +---------------------------------------------------------------+
+ *    1  |   map fd                                                      |
+ *       +---------------------------------------------------------------+
+ *    2  |   count                                                       |
+ *       +---------------------------------------------------------------+
+ *    3  |   flags, map_update_batch only (CMSG_BPF_xxx)                 |
+ *       +---------------------------------------------------------------+
+ *    4  |   element 0 key, key size rounded up to words                 |
+ *       +---------------------------------------------------------------+
+ *       |   element 0 value, value size rounded up to words,            |
+ *       |   absent in map_delete_batch                                  |
+ *       +---------------------------------------------------------------+
+ *       |   element 1 key ...                                           |
+ *       +---------------------------------------------------------------+
+ *  map_lookup_batch / map_update_batch / map_delete_batch reply
+ *       +---------------------------------------------------------------+
+ *    1  |   RC of the first element that failed, 0=success              |
+ *       +---------------------------------------------------------------+
+ *    2  |   number of elements processed                                |
+ *       +---------------------------------------------------------------+
+ *    4  |   elements as in the request, map_lookup_batch replies with   |
+ *       |   the values written over the request values                  |
+ *       +---------------------------------------------------------------+
+ *  Elements are processed in order, processing stops at the first one
+ *  that fails.
+ *
+ *  map_dump request
+ *       +---------------------------------------------------------------+
+ *    1  |   map fd                                                      |
+ *       +---------------------------------------------------------------+
+ *    2  |   max number of elements to return                            |
+ *       +---------------------------------------------------------------+
+ *    3  |   cursor, 0 starts the dump                                   |
+ *       +---------------------------------------------------------------+
+ *  map_dump reply
+ *       +---------------------------------------------------------------+
+ *    1  |   RC, 0=success                                               |
+ *       +---------------------------------------------------------------+
+ *    2  |   number of elements returned                                 |
+ *       +---------------------------------------------------------------+
+ *    3  |   cursor to resume from, CMSG_MAP_DUMP_END once all returned  |
+ *       +---------------------------------------------------------------+
+ *    4  |   elements, key then value, packed as in the batch messages   |
+ *       +---------------------------------------------------------------+
+ *  The reply holds at most CMSG_MAP_DUMP_DATA_SZ bytes of elements. The
+ *  cursor is opaque to the driver, entries added or removed while a dump
+ *  is in progress may or may not be returned. For hash maps it packs the
+ *  MU partition, the bucket index and the slot in the bucket.
+ *
+ *  arfs_add / arfs_delete request
+ *       +---------------------------------------------------------------+
+ *    1  |   vNIC (RSS table index)                                      |
+ *       +---------------------------------------------------------------+
+ *    2  |   RX queue (ignored by arfs_delete)                           |
+ *       +---------------------------------------------------------------+
+ *    3  |   RSS hash type (NFP_NET_RSS_IPV4_TCP ... NFP_NET_RSS_IPV6_UDP)|
+ *       +---------------------------------------------------------------+
+ *    4  |   RSS hash of the flow as delivered in the RX metadata        |
+ *       +---------------------------------------------------------------+
+ *    5  |   source port                 |   destination port            |
+ *       +---------------------------------------------------------------+
+ *  arfs_add / arfs_delete reply
+ *       +---------------------------------------------------------------+
+ *    1  |   RC, 0=success                                               |
+ *       +---------------------------------------------------------------+
 */
 
 /**
@@ -197,13 +264,19 @@
 #define CMSG_TYPE_MAP_GETNEXT   6
 #define CMSG_TYPE_MAP_GETFIRST  7
 #define CMSG_TYPE_PRINT			8
+#define CMSG_TYPE_ARFS_ADD      9
+#define CMSG_TYPE_ARFS_DELETE   10
+#define CMSG_TYPE_MAP_LOOKUP_BATCH  11
+#define CMSG_TYPE_MAP_UPDATE_BATCH  12
+#define CMSG_TYPE_MAP_DELETE_BATCH  13
+#define CMSG_TYPE_MAP_DUMP      14
 	/* CMSG_TYPE_MAP_ARRAY_GETNEXT is internal type */
 #define CMSG_TYPE_MAP_ARRAY_GETNEXT  0xf6
 
 #define CMSG_TYPE_MAP_START		1
 #define CMSG_TYPE_MAP_MAX		7
 
-//#define CMSG_TYPE_MAX (CMSG_TYPE_LAST_UNUSED)
+#define CMSG_TYPE_MAX (CMSG_TYPE_MAP_DUMP)
 
 #define CMSG_TYPE_MAP_ALLOC_REPLY		0x81
 #define CMSG_TYPE_MAP_FREE_REPLY		0x82
@@ -212,6 +285,12 @@
 #define CMSG_TYPE_MAP_DELETE_REPLY		0x85
 #define CMSG_TYPE_MAP_GETNEXT_REPLY		0x86
 #define CMSG_TYPE_MAP_GETFIRST_REPLY	0x87
+#define CMSG_TYPE_ARFS_ADD_REPLY		0x89
+#define CMSG_TYPE_ARFS_DELETE_REPLY		0x8a
+#define CMSG_TYPE_MAP_LOOKUP_BATCH_REPLY	0x8b
+#define CMSG_TYPE_MAP_UPDATE_BATCH_REPLY	0x8c
+#define CMSG_TYPE_MAP_DELETE_BATCH_REPLY	0x8d
+#define CMSG_TYPE_MAP_DUMP_REPLY		0x8e
 
 #define CMSG_TYPE_MAP_REPLY_BIT			7
 
@@ -244,6 +323,13 @@
 #define CMSG_MAP_TID_IDX			1
 #define CMSG_MAP_OP_COUNT_IDX		2
 #define CMSG_MAP_OP_FLAGS_IDX		3
+#define CMSG_MAP_DUMP_CURSOR_IDX	3
+
+/* packed elements that fit one batch message, advertised to the host */
+#define CMSG_MAP_BATCH_DATA_SZ		((353 - CMSG_OP_HDR_LW) * 4)
+
+#define CMSG_MAP_DUMP_END			0xffffffff
+#define CMSG_MAP_DUMP_DATA_SZ		((353 - CMSG_OP_HDR_LW) * 4)
 
 #define CMSG_MAP_ALLOC_KEYSZ_IDX	1
 #define CMSG_MAP_ALLOC_VALUESZ_IDX	2
@@ -251,6 +337,65 @@
 #define CMSG_MAP_ALLOC_TYPE_IDX		4
 #define CMSG_MAP_ALLOC_FLAGS_IDX	5
 
+#define CMSG_ARFS_VNIC_IDX			1
+#define CMSG_ARFS_QUEUE_IDX			2
+#define CMSG_ARFS_HASH_TYPE_IDX		3
+#define CMSG_ARFS_HASH_IDX			4
+#define CMSG_ARFS_PORTS_IDX			5
+
+/**
+ * aRFS flow steering table, consulted by the RSS action before the RSS
+ * indirection table. Direct mapped by the RSS hash, an entry matches a
+ * packet if the vNIC, hash type, hash and L4 ports all agree. Entries are
+ * written by the cmsg handler on behalf of the driver, which also ages them.
+ *
+ * Bit    3 3 2 2 2 2 2 2 2 2 2 2 1 1 1 1 1 1 1 1 1 1 0 0 0 0 0 0 0 0 0 0
+ * -----\ 1 0 9 8 7 6 5 4 3 2 1 0 9 8 7 6 5 4 3 2 1 0 9 8 7 6 5 4 3 2 1 0
+ * Word  +---------------+-+-----+-------+-------+---------+-------------+
+ *    0  |     queue     |V|  0  |  type |   0   |   vNIC  |      0      |
+ *       +---------------+-+-----+-------+-------+---------+-------------+
+ *    1  |                            RSS hash                           |
+ *       +-------------------------------+-------------------------------+
+ *    2  |          source port          |        destination port       |
+ *       +-------------------------------+-------------------------------+
+ *    3  |                            reserved                           |
+ *       +---------------------------------------------------------------+
+ *
+ * The vNIC field lines up with INSTR_RSS_TABLE_IDX_bf in the RSS action.
+ */
+#define NIC_ARFS_TBL_ENTRIES_LOG2	14
+#define NIC_ARFS_TBL_ENTRIES		(1 << NIC_ARFS_TBL_ENTRIES_LOG2)
+#define NIC_ARFS_ENTRY_LW			4
+#define NIC_ARFS_ENTRY_SZ_LOG2		4
+#define NIC_ARFS_TBL_SIZE			(NIC_ARFS_TBL_ENTRIES << NIC_ARFS_ENTRY_SZ_LOG2)
+
+#define NIC_ARFS_QUEUE_bf			0, 31, 24
+#define NIC_ARFS_VALID_bf			0, 23, 23
+#define NIC_ARFS_HASH_TYPE_bf		0, 19, 16
+#define NIC_ARFS_VNIC_bf			0, 11, 7
+#define NIC_ARFS_HASH_bf			1, 31, 0
+#define NIC_ARFS_PORTS_bf			2, 31, 0
+
+#define NIC_ARFS_VNICS				32 /* values of NIC_ARFS_VNIC_bf */
+
+/**
+ * Bit v of _nic_arfs_vnics is set while vNIC v has entries in the aRFS
+ * table. The cmsg handler keeps the per vNIC entry counts, the app master
+ * picks the bits up and sets INSTR_RSS_ARFS in the RSS action of the vNICs
+ * that have entries, so the others skip the table lookup.
+ */
+#if defined(__NFP_LANG_ASM)
+	.alloc_mem _nic_arfs_tbl emem global NIC_ARFS_TBL_SIZE 256
+	.init _nic_arfs_tbl 0
+	.alloc_mem _nic_arfs_vnics emem global 8 8
+	.init _nic_arfs_vnics 0
+#elif defined(__NFP_LANG_MICROC)
+	__asm
+	{
+		.alloc_mem _nic_arfs_vnics emem global 8 8
+	}
+#endif
+
 /* flags used for add/update */
 #define CMSG_BPF_ANY     0 /* create new element or update existing */
 #define CMSG_BPF_NOEXIST 1 /* create new element if it didn't exist */
@@ -68,6 +68,8 @@
 
 #include "hashmap_priv.uc"
 #include "hashmap_cam.uc"
+#include "hashmap_percpu.uc"
+#include "hashmap_array.uc"
 
 /*
  * public functions:
@@ -168,7 +170,8 @@
  *   union {
  *       struct {
  *           uint32_t valid : 1;
- *           uint32_t reserved1: 10;
+ *           uint32_t reserved1: 1;
+ *           uint32_t lru_ref: 9;       bit 20..28 - LRU maps, see below
  *           uint32_t reserved_ov_idx:4 bit 17..19
  *           uint32_t reserved_ov:1;    bit 16 - use in state only, not in mem
  *           uint32_t spare: 1;
@@ -177,33 +180,49 @@
  *       };
  *       uint32_t meta;
  *   };
- *  // following are futures
- *   union {
- *      struct {
- *          uint32_t lru_ref : 1;
- *          uint32_t reserved: 31;
- *      };
- *      uint32_t flags;
- *   };
- *   uint32_t spare[2];
  *   //uint32_t fd;   fd is the first word of the key
  * } __hashmap_descriptor_t;
  *
  */
 #define __HASHMAP_DESC_LW               1
 #define __HASHMAP_DESC_NDX_META         0
-#define __HASHMAP_DESC_NDX_LRU_FLG      1
 #define __HASHMAP_DESC_NDX_TID          4
 #define __HASHMAP_DESC_VALID_BIT        (30)
 #define __HASHMAP_DESC_VALID            (1<<__HASHMAP_DESC_VALID_BIT)
-                                        // Free 29:20
+                                        // Free 29
 #define __HASHMAP_DESC_OV_BIT           (19)
 #define __HASHMAP_DESC_OV_IDX           (16)
 #define __HASHMAP_DESC_LOCK_EXCL_BIT    (14)
 #define __HASHMAP_DESC_LOCK_EXCL        (1<<__HASHMAP_DESC_LOCK_EXCL_BIT)
 #define __HASHMAP_DESC_LOCK_CNT_MSK     (__HASHMAP_DESC_LOCK_EXCL - 1)
-#define __HASHMAP_DESC_LRU_REF_BIT      (31)
-#define __HASHMAP_DESC_LRU_REF          (1<<__HASHMAP_DESC_LRU_REF_BIT)
+
+/*
+ * BPF_MAP_TYPE_LRU_HASH keeps one reference bit per slot of a bucket in the
+ * meta word of its lock, overflow entry n in bit 20+n and the primary entry
+ * in bit 28. A lookup sets the bit of the entry it found. When an add finds
+ * no room, the bucket, or the next one, evicts one of the map's own entries
+ * whose bit is clear and clears the bits of the map's entries, see
+ * __hashmap_lru_evict(). Deleting an entry clears its bit.
+ */
+#define __HASHMAP_LOCK_LRU_REF_SHFT     20
+#define __HASHMAP_LRU_SLOT_PRIMARY      8
+
+/*
+ * lock table entry, one per primary entry
+ *
+ * typedef struct {
+ *   uint32_t meta;          // valid, overflow and lock state, as above
+ *   uint32_t version : 16;  // bits 31..16, bumped by each writer before it
+ *                           // drops the exclusive lock
+ *   uint32_t tid : 16;      // bits 15..0, tid of the primary entry
+ * } __hashmap_lock_t;
+ *
+ * Lookups do not take the lock. They sample the second word while the
+ * exclusive bit is clear, and retry if the exclusive bit is set or the
+ * word changed once the entry has been read.
+ */
+#define __HASHMAP_LOCK_NDX_VER          1
+#define __HASHMAP_LOCK_VER_SHFT         16
 
 /*
  * typedef struct {
@@ -232,11 +251,9 @@
  *   uint32_t value_mask;
  *   uint32_t num_entries_credits;   // number of free entries
  *   uint32_t map_type;
- *   uint32_t lru_counts_active;
- *   uint32_t lru_counts_inactive;
- *   uint32_t lru_qsize_active;
- *   uint32_t lru_qsize_inactive;
- *   uint32_t spares[6];
+ *   uint32_t array_offset;       //  array maps, region in the array pool
+ *   uint32_t array_shft;         //  array maps, log2 of the value stride
+ *   uint32_t spares[8];
  * } hashmap_fd_t;
 */
 
@@ -250,11 +267,9 @@
 #define __HASHMAP_FD_NDX_VALUE_MASK 3
 #define __HASHMAP_FD_NDX_CUR_CRED   4
 #define __HASHMAP_FD_NDX_TYPE       5
-#define __HASHMAP_FD_NDX_CNT_ACT    6
-#define __HASHMAP_FD_NDX_CNT_INACT  7
-#define __HASHMAP_FD_NDX_QCNT_ACT   8
-#define __HASHMAP_FD_NDX_QCNT_INACT 9
-#define __HASHMAP_FD_NUM_LW_USED    6
+#define __HASHMAP_FD_NDX_ARRAY_OFF  6
+#define __HASHMAP_FD_NDX_ARRAY_SHFT 7
+#define __HASHMAP_FD_NUM_LW_USED    8
 #define __HASHMAP_FD_MAX_NUM_LW     10
 
 
@@ -300,6 +315,8 @@
 #macro hashmap_init()
     hashmap_declare_block(HASHMAP_TOTAL_ENTRIES)
     __hashmap_freelist_init(HASHMAP_OVERFLOW_ENTRIES)
+    __hashmap_percpu_init(HASHMAP_PERCPU_ENTRIES)
+    __hashmap_array_init()
     __hashmap_journal_init()
 #endm
 
@@ -357,6 +374,11 @@
 
 
 #macro hashmap_alloc_fd(in_tid, key_size, value_size, max_entries, ERROR_LABEL, endian, type)
+    hashmap_alloc_fd(in_tid, key_size, value_size, max_entries, ERROR_LABEL, endian, type, 0, 0)
+#endm
+
+/* array maps pass the region allocated in the array pool */
+#macro hashmap_alloc_fd(in_tid, key_size, value_size, max_entries, ERROR_LABEL, endian, type, array_offset, array_shft)
 .begin
     .reg base
     .reg offset
@@ -383,6 +405,8 @@
     alu[$fd_xfer[__HASHMAP_FD_NDX_MAX_ENT], --, b, tmp]
     alu[$fd_xfer[__HASHMAP_FD_NDX_CUR_CRED], --, b, tmp]
     alu[$fd_xfer[__HASHMAP_FD_NDX_TYPE], --, b, type]
+    alu[$fd_xfer[__HASHMAP_FD_NDX_ARRAY_OFF], --, b, array_offset]
+    alu[$fd_xfer[__HASHMAP_FD_NDX_ARRAY_SHFT], --, b, array_shft]
 
     ov_start(OV_LENGTH)
     ov_set_use(OV_LENGTH, __HASHMAP_FD_NUM_LW_USED, OVF_SUBTRACT_ONE)
@@ -529,6 +553,7 @@ cont#:
     .sig lock_shared_sig
     .reg lk_addr_hi
     .reg lk_addr_lo
+    .reg tid
 
     immed[$desc_xfer[0], 1]         ;lo
     immed[$desc_xfer[1], 0]         ;hi
@@ -545,11 +570,61 @@ retry_lock#:
 
 ret#:
     br_bclr[$desc_xfer[0], __HASHMAP_DESC_VALID_BIT, NOT_VALID_LABEL]
-    alu[--, in_tid, -, $desc_xfer[1]]
+    ld_field_w_clr[tid, 0011, $desc_xfer[1]]
+    alu[--, in_tid, -, tid]
     bne[NOT_MATCH_TID]
 .end
 #endm /* __hashmap_lock_shared */
 
+/* lock free lookups, see __hashmap_lock_t */
+#macro __hashmap_read_begin(in_idx, in_tid, out_meta, out_ver, NOT_VALID_LABEL, NOT_MATCH_TID)
+.begin
+    .reg $desc_xfer[2]
+    .xfer_order $desc_xfer
+
+    .sig read_begin_sig
+    .reg lk_addr_hi
+    .reg lk_addr_lo
+    .reg tid
+
+    move(lk_addr_hi, __HASHMAP_LOCK_TBL >>8)
+    alu[lk_addr_lo, --, b, in_idx, <<HASHMAP_LOCK_SZ_SHFT]
+
+retry_read#:
+    mem[read_atomic, $desc_xfer[0], lk_addr_hi, <<8, lk_addr_lo, HASHMAP_LOCK_SZ_LW], ctx_swap[read_begin_sig]
+    br_bclr[$desc_xfer[0], __HASHMAP_DESC_LOCK_EXCL_BIT, ret#]
+    // wait for the writer to finish
+    timestamp_sleep(100)
+    br[retry_read#]
+
+ret#:
+    alu[out_meta, --, b, $desc_xfer[__HASHMAP_DESC_NDX_META]]
+    alu[out_ver, --, b, $desc_xfer[__HASHMAP_LOCK_NDX_VER]]
+    br_bclr[$desc_xfer[0], __HASHMAP_DESC_VALID_BIT, NOT_VALID_LABEL]
+    ld_field_w_clr[tid, 0011, out_ver]
+    alu[--, in_tid, -, tid]
+    bne[NOT_MATCH_TID]
+.end
+#endm /* __hashmap_read_begin */
+
+#macro __hashmap_read_validate(in_idx, in_ver, RETRY_LABEL)
+.begin
+    .reg $desc_xfer[2]
+    .xfer_order $desc_xfer
+
+    .sig read_validate_sig
+    .reg lk_addr_hi
+    .reg lk_addr_lo
+
+    move(lk_addr_hi, __HASHMAP_LOCK_TBL >>8)
+    alu[lk_addr_lo, --, b, in_idx, <<HASHMAP_LOCK_SZ_SHFT]
+    mem[read_atomic, $desc_xfer[0], lk_addr_hi, <<8, lk_addr_lo, HASHMAP_LOCK_SZ_LW], ctx_swap[read_validate_sig]
+    br_bset[$desc_xfer[0], __HASHMAP_DESC_LOCK_EXCL_BIT, RETRY_LABEL]
+    alu[--, in_ver, -, $desc_xfer[__HASHMAP_LOCK_NDX_VER]]
+    bne[RETRY_LABEL]
+.end
+#endm /* __hashmap_read_validate */
+
 #macro __hashmap_lock_upgrade(in_idx, io_state, NO_LOCK_LABEL)
 .begin
     .reg $desc_xfer
@@ -610,9 +685,18 @@ ret#:
     .reg imm_ref
     .reg lk_addr_hi
     .reg lk_addr_lo
+    .reg write $ver_xfer
+    .sig lock_ver_sig
 
     move(lk_addr_hi, (__HASHMAP_LOCK_TBL>>8))
     alu[lk_addr_lo, --, b, in_idx, <<HASHMAP_LOCK_SZ_SHFT]
+    br_bclr[state, __HASHMAP_DESC_LOCK_EXCL_BIT, release#]
+    /* writer, bump the version for lock free readers while still exclusive */
+    immed[$ver_xfer, 1, <<__HASHMAP_LOCK_VER_SHFT]
+    alu[lk_addr_lo, lk_addr_lo, +, (__HASHMAP_LOCK_NDX_VER << 2)]
+    mem[add, $ver_xfer, lk_addr_hi, <<8, lk_addr_lo, 1], ctx_swap[lock_ver_sig]
+    alu[lk_addr_lo, lk_addr_lo, -, (__HASHMAP_LOCK_NDX_VER << 2)]
+release#:
     ld_field_w_clr[imm_ref, 1100, state, <<16]  /* data16, lock->state  */
     alu[imm_ref, imm_ref, or, 2, <<3]           /* ove_data=2 override  */
     alu_shf[--, imm_ref, or, 17, <<7]           /* ov_len (1<<7) | length (16<<8) */
@@ -631,20 +715,256 @@ ret#:
     .reg lk_addr_hi
     .reg lk_addr_lo
 
+    /* the next entry in the slot must not inherit the LRU reference bit */
+    __hashmap_lru_ref_clr(in_idx, state)
     move(lk_addr_hi, __HASHMAP_LOCK_TBL >>8)
     alu[lk_addr_lo, --, b, in_idx, <<HASHMAP_LOCK_SZ_SHFT]
     alu_shf[tmp, --,b, 1, <<__HASHMAP_DESC_VALID_BIT]
     alu_shf[$desc_xfer[0],tmp, or, state]
-    alu[$desc_xfer[1], --, b, in_fd]
+    /* clear the tid and bump the version, see __hashmap_lock_release() */
+    immed[tmp, 1, <<__HASHMAP_LOCK_VER_SHFT]
+    alu[$desc_xfer[1], in_fd, -, tmp]
     mem[sub64, $desc_xfer[0], lk_addr_hi, <<8, lk_addr_lo, 1], ctx_swap[lock_rel_invalid_sig]
     immed[state, 0]
-    /* TODO for LRU
-     *      clear ref flag
-     *      incr free_credits
-     */
 .end
 #endm /* __hashmap_lock_release_and_invalidate */
 
+/*
+ * Clear the LRU reference bit of the slot in_state points at, the primary
+ * entry or overflow entry n. Called when the entry is deleted.
+ */
+#macro __hashmap_lru_ref_clr(in_idx, in_state)
+.begin
+    .reg write $ref_xfer
+    .sig lru_clr_sig
+    .reg lk_addr_hi
+    .reg lk_addr_lo
+    .reg ref_bit
+
+    alu[ref_bit, 7, and, in_state, >>__HASHMAP_DESC_OV_IDX]
+    br_bset[in_state, __HASHMAP_DESC_OV_BIT, clr#], defer[1]
+        alu[ref_bit, ref_bit, +, __HASHMAP_LOCK_LRU_REF_SHFT]
+    immed[ref_bit, (__HASHMAP_LOCK_LRU_REF_SHFT + __HASHMAP_LRU_SLOT_PRIMARY)]
+clr#:
+    alu[--, ref_bit, or, 0]
+    alu[$ref_xfer, --, b, 1, <<indirect]
+    move(lk_addr_hi, __HASHMAP_LOCK_TBL >>8)
+    alu[lk_addr_lo, --, b, in_idx, <<HASHMAP_LOCK_SZ_SHFT]
+    mem[clr, $ref_xfer, lk_addr_hi, <<8, lk_addr_lo, 1], ctx_swap[lru_clr_sig]
+.end
+#endm /* __hashmap_lru_ref_clr */
+
+/*
+ * LRU maps: mark the entry found by a lookup as referenced. in_meta is the
+ * lock meta word sampled by __hashmap_read_begin(), the atomic is skipped
+ * if the bit was already set.
+ */
+#macro __hashmap_lru_ref_set(in_idx, in_state, in_meta)
+.begin
+    .reg write $ref_xfer
+    .sig lru_ref_sig
+    .reg lk_addr_hi
+    .reg lk_addr_lo
+    .reg ref_bit
+
+    /* overflow entry n is slot n, the primary entry is slot 8 */
+    passert(__HASHMAP_DESC_OV_BIT, "EQ", (__HASHMAP_DESC_OV_IDX + 3))
+    passert(__HASHMAP_LRU_SLOT_PRIMARY, "EQ", 8)
+    alu[ref_bit, 0xf, and, in_state, >>__HASHMAP_DESC_OV_IDX]
+    alu[ref_bit, ref_bit, xor, __HASHMAP_LRU_SLOT_PRIMARY]
+    alu[ref_bit, ref_bit, +, __HASHMAP_LOCK_LRU_REF_SHFT]
+    alu[--, ref_bit, or, 0]
+    alu[ref_bit, --, b, 1, <<indirect]
+    alu[--, ref_bit, and, in_meta]
+    bne[ret#]
+
+    move(lk_addr_hi, __HASHMAP_LOCK_TBL >>8)
+    alu[lk_addr_lo, --, b, in_idx, <<HASHMAP_LOCK_SZ_SHFT]
+    alu[$ref_xfer, --, b, ref_bit]
+    mem[set, $ref_xfer, lk_addr_hi, <<8, lk_addr_lo, 1], sig_done[lru_ref_sig]
+    ctx_arb[lru_ref_sig]
+ret#:
+.end
+#endm /* __hashmap_lru_ref_set */
+
+/*
+ * LRU maps: make room in a bucket that has no free slot, or when the map has
+ * no credits left, by handing out the slot of one of the map's own entries
+ * in the bucket. The first entry not referenced since the previous eviction
+ * is the victim, or the first entry if all of them were referenced. The
+ * reference bits of the map's entries are cleared, so the next eviction only
+ * spares the entries looked up in between. The victim keeps its credit and,
+ * in overflow, its pool buffer; its CAM entry is moved to in_hashkey.
+ *
+ * If the bucket holds none of the map's entries but has a free slot, the map
+ * is out of credits and the victim is picked the same way in the next
+ * bucket. That bucket is only try-locked, the caller already holds its own
+ * exclusive lock. The victim there is deleted, its credit is handed to the
+ * caller and FREED_LABEL is taken to add the entry to the free slot.
+ * NO_VICTIM_LABEL is taken if neither bucket holds one of the map's entries,
+ * or the next bucket is busy. Otherwise the caller holds the exclusive lock
+ * and writes the new key and value at out_addr_hi/out_addr_lo.
+ */
+#macro __hashmap_lru_evict(in_hashkey, in_tid, in_addr_hi, in_idx, out_addr_hi, out_addr_lo, NO_VICTIM_LABEL, FREED_LABEL)
+.begin
+    .reg $lock_xfer[2]
+    .xfer_order $lock_xfer
+    .reg $ov_addr[8]
+    .xfer_order $ov_addr
+    .reg write $ref_xfer
+    .reg write $cam_wd
+    .reg $excl_xfer
+    .sig lock_read_sig
+    .sig ov_read_sig
+    .sig lru_ref_sig
+    .sig cam_write_sig
+    .sig excl_sig
+    .reg lk_addr_hi
+    .reg lk_addr_lo
+    .reg ov_offset
+    .reg ctx_tindex
+    .reg cands
+    .reg victims
+    .reg slot
+    .reg room
+    .reg idx
+    .reg next_state
+    .reg cnt_mask
+    .reg tid
+    .reg tmp
+
+    move(lk_addr_hi, __HASHMAP_LOCK_TBL >>8)
+    alu[idx, --, b, in_idx]
+    immed[next_state, 0]
+
+scan#:
+    alu[lk_addr_lo, --, b, idx, <<HASHMAP_LOCK_SZ_SHFT]
+    mem[read_atomic, $lock_xfer[0], lk_addr_hi, <<8, lk_addr_lo, HASHMAP_LOCK_SZ_LW], sig_done[lock_read_sig]
+
+    #define __OV_OFFSET__    (HASHMAP_OV_CAM_OFFSET+HASHMAP_OV_ENTRY_OFFSET)
+    alu[ov_offset, --, b, idx, <<HASHMAP_ENTRY_SZ_SHFT]
+    alu[ov_offset, ov_offset, +, __OV_OFFSET__]
+    #undef __OV_OFFSET__
+    mem[read32, $ov_addr[0], in_addr_hi, <<8, ov_offset, 8], sig_done[ov_read_sig]
+
+    alu[ctx_tindex, (&$ov_addr[0] << 2), or, my_act_ctx, <<7]
+    ctx_arb[lock_read_sig, ov_read_sig]
+    local_csr_wr[T_INDEX, ctx_tindex]
+        immed[cands, 0]
+        immed[slot, 0]
+        immed[room, 0]
+
+    /* candidates: the map's overflow entries, slot 0..7 */
+next_ov#:
+    alu[tmp, --, b, *$index++]
+    beq[free_ov#]
+    ld_field_w_clr[tid, 0001, tmp, >>24]
+    alu[--, tid, -, in_tid]
+    bne[skip_ov#], defer[1]
+        alu[--, slot, or, 0]
+    alu[cands, cands, or, 1, <<indirect]
+    br[skip_ov#]
+free_ov#:
+    immed[room, 1]
+skip_ov#:
+    alu[slot, slot, +, 1]
+    alu[--, slot, -, __HASHMAP_LRU_SLOT_PRIMARY]
+    blo[next_ov#]
+
+    /* and the primary entry, slot 8 */
+    br_bclr[$lock_xfer[__HASHMAP_DESC_NDX_META], __HASHMAP_DESC_VALID_BIT, free_primary#]
+    ld_field_w_clr[tid, 0011, $lock_xfer[__HASHMAP_LOCK_NDX_VER]]
+    alu[--, tid, -, in_tid]
+    bne[pick#]
+    br[pick#], defer[1]
+        alu[cands, cands, or, 1, <<__HASHMAP_LRU_SLOT_PRIMARY]
+free_primary#:
+    immed[room, 1]
+
+pick#:
+    alu[--, --, b, cands]
+    bne[age#]
+    alu[--, next_state, or, 0]
+    bne[next_busy#]
+    /* out of credits with none of the map's entries here, try next bucket */
+    alu[--, room, or, 0]
+    beq[NO_VICTIM_LABEL]
+    alu[idx, idx, +, 1]
+    alu[idx, --, b, idx, <<(32 - HASHMAP_NUM_ENTRIES_SHFT)]
+    alu[idx, --, b, idx, >>(32 - HASHMAP_NUM_ENTRIES_SHFT)]
+    alu[lk_addr_lo, --, b, idx, <<HASHMAP_LOCK_SZ_SHFT]
+    immed[next_state, __HASHMAP_DESC_LOCK_EXCL]
+    move(cnt_mask, __HASHMAP_DESC_LOCK_CNT_MSK)
+    alu[$excl_xfer, --, b, next_state]
+    mem[test_set, $excl_xfer, lk_addr_hi, <<8, lk_addr_lo, 1], sig_done[excl_sig]
+    ctx_arb[excl_sig]
+    br_bset[$excl_xfer, __HASHMAP_DESC_LOCK_EXCL_BIT, NO_VICTIM_LABEL]
+    alu[tmp, cnt_mask, and, $excl_xfer]
+    beq[scan#]
+    /* give lock free readers and lookups in flight one chance to drain */
+    timestamp_sleep(50)
+    mem[read_atomic, $excl_xfer, lk_addr_hi, <<8, lk_addr_lo, 1], sig_done[excl_sig]
+    ctx_arb[excl_sig]
+    alu[tmp, cnt_mask, and, $excl_xfer]
+    beq[scan#]
+next_busy#:
+    __hashmap_lock_release(idx, next_state)
+    br[NO_VICTIM_LABEL]
+
+age#:
+    alu[victims, cands, and~, $lock_xfer[__HASHMAP_DESC_NDX_META], >>__HASHMAP_LOCK_LRU_REF_SHFT]
+    bne[aged#]
+    alu[victims, --, b, cands]
+aged#:
+    ffs[slot, victims]
+    alu[$ref_xfer, --, b, cands, <<__HASHMAP_LOCK_LRU_REF_SHFT]
+    mem[clr, $ref_xfer, lk_addr_hi, <<8, lk_addr_lo, 1], sig_done[lru_ref_sig]
+
+    alu[--, slot, -, __HASHMAP_LRU_SLOT_PRIMARY]
+    beq[primary#]
+
+    /* overflow victim, reuse its pool buffer under the new hash */
+    alu[tmp, --, b, slot, <<2]
+    alu[ctx_tindex, ctx_tindex, +, tmp]
+    local_csr_wr[T_INDEX, ctx_tindex]
+        alu[ov_offset, ov_offset, +, tmp]
+        alu[ov_offset, ov_offset, -, HASHMAP_OV_ENTRY_OFFSET]
+        nop
+    alu[tmp, --, b, *$index]
+    ld_field_w_clr[out_addr_lo, 0111, tmp]
+    alu[out_addr_lo, --, b, out_addr_lo, <<HASHMAP_OV_ENTRY_SZ_SHFT]
+    alu[--, next_state, or, 0]
+    bne[delete_ov#]
+    ld_field_w_clr[tmp, 0111, in_hashkey]
+    alu[$cam_wd, tmp, or, 1]
+    mem[write32, $cam_wd, in_addr_hi, <<8, ov_offset, 1], sig_done[cam_write_sig]
+    move(out_addr_hi, HASHMAP_FREEPOOL_BASE >>8)
+    ctx_arb[lru_ref_sig, cam_write_sig], br[ret#]
+
+delete_ov#:
+    /* victim in the next bucket, free it and hand its credit over */
+    ctx_arb[lru_ref_sig]
+    alu[tmp, slot, or, 1, <<(__HASHMAP_DESC_OV_BIT - __HASHMAP_DESC_OV_IDX)]
+    alu[tmp, --, b, tmp, <<__HASHMAP_DESC_OV_IDX]
+    __hashmap_ov_delete(in_addr_hi, idx, out_addr_lo, tmp)
+    __hashmap_lock_release(idx, next_state)
+    br[FREED_LABEL]
+
+primary#:
+    alu[--, next_state, or, 0]
+    bne[delete_primary#]
+    alu[out_addr_hi, --, b, in_addr_hi]
+    alu[out_addr_lo, --, b, in_idx, <<HASHMAP_ENTRY_SZ_SHFT]
+    ctx_arb[lru_ref_sig], br[ret#]
+
+delete_primary#:
+    ctx_arb[lru_ref_sig]
+    __hashmap_lock_release_and_invalidate(idx, next_state, in_tid)
+    br[FREED_LABEL]
+ret#:
+.end
+#endm /* __hashmap_lru_evict */
+
 
 #macro __hashmap_select_1_partition(hash, selection_mu)
     alu[selection_mu, --, b, 0]
@@ -730,6 +1050,16 @@ ret#:
 #endm
 
 #macro hashmap_ops(fd, lm_key_addr, lm_value_addr, OP, INVALID_MAP_LABEL, NOTFOUND_LABEL, RTN_OPT, out_ent_lw, out_ent_tindex, out_ent_addr, endian, out_rc)
+    hashmap_ops(fd, lm_key_addr, lm_value_addr, OP, INVALID_MAP_LABEL, NOTFOUND_LABEL, RTN_OPT, out_ent_lw, out_ent_tindex, out_ent_addr, endian, out_rc, --)
+#endm
+
+/*
+ * in_flags optionally holds the CMSG_BPF_* flags of a HASHMAP_OP_ADD_ANY at
+ * run time: CMSG_BPF_NOEXIST behaves as HASHMAP_OP_ADD_ONLY and
+ * CMSG_BPF_EXIST as HASHMAP_OP_UPDATE, without another expansion of the
+ * macro in the code store.
+ */
+#macro hashmap_ops(fd, lm_key_addr, lm_value_addr, OP, INVALID_MAP_LABEL, NOTFOUND_LABEL, RTN_OPT, out_ent_lw, out_ent_tindex, out_ent_addr, endian, out_rc, in_flags)
 .begin
     .reg ent_addr_hi
     .reg tbl_addr_hi
@@ -747,6 +1077,21 @@ ret#:
     .reg my_act_ctx
     .reg map_tindex
     .reg map_type
+    #if (OP == HASHMAP_OP_LOOKUP)
+        .reg ent_meta
+        .reg ent_ver
+    #elif ((OP == HASHMAP_OP_ADD_ANY) || (OP == HASHMAP_OP_UPDATE) || (OP == HASHMAP_OP_ADD_ONLY))
+        .reg pc_elem
+    #endif
+    #if ((OP != HASHMAP_OP_GETNEXT) && (OP != HASHMAP_OP_GETFIRST))
+        .reg array_shft
+    #endif
+
+    #if ((OP == HASHMAP_OP_ADD_ANY) && (!streq('in_flags', '--')))
+        #define_eval __HASHMAP_ADD_FLAGS 1
+    #else
+        #define_eval __HASHMAP_ADD_FLAGS 0
+    #endif
 
     __hashmap_lm_handles_define()
 
@@ -767,6 +1112,12 @@ ret#:
     #if (OP == HASHMAP_OP_GETFIRST)
         br[getfirst_ent#]
     #else
+        #if (OP != HASHMAP_OP_GETNEXT)
+            alu[--, map_type, -, BPF_MAP_TYPE_ARRAY]
+            beq[array_ent#]
+            alu[--, map_type, -, BPF_MAP_TYPE_PERCPU_ARRAY]
+            beq[array_ent#]
+        #endif
         slicc_hash_words(hash, fd, lm_key_addr, key_lwsz, key_mask)
         __hashmap_index_from_hash(hash[0], ent_index)
         __hashmap_lock_init(ent_state, ent_addr_hi, offset, mu_partition, ent_index)
@@ -775,7 +1126,11 @@ ret#:
 
 retry#:
     __hashmap_set_opt_field(out_rc, CMSG_RC_ERR_ENOENT)
-    __hashmap_lock_shared(ent_index, fd, check_ov#, check_ov_valid#)
+    #if (OP == HASHMAP_OP_LOOKUP)
+        __hashmap_read_begin(ent_index, fd, ent_meta, ent_ver, check_ov#, check_ov_valid#)
+    #else
+        __hashmap_lock_shared(ent_index, fd, check_ov#, check_ov_valid#)
+    #endif
 
     __hashmap_compare(map_tindex, lm_key_addr, ent_addr_hi, offset, key_lwsz, check_ov_valid#, endian, map_type)
 found#:     /* found entry which matches the key */
@@ -783,15 +1138,24 @@ found#:     /* found entry which matches the key */
     #if (OP == HASHMAP_OP_LOOKUP)
         alu[bytes, --, b, key_lwsz, <<2]
         __hashmap_calc_value_addr(offset, bytes, offset)
-        /* TODO LRU:  set ref flag */
+        __hashmap_is_percpu(map_type, lookup_lru#)
+        __hashmap_percpu_addr(ent_addr_hi, offset)
+lookup_lru#:
+        alu[--, map_type, -, BPF_MAP_TYPE_LRU_HASH]
+        bne[lookup_read#]
+        __hashmap_lru_ref_set(ent_index, ent_state, ent_meta)
+lookup_read#:
         __hashmap_set_opt_field(out_ent_lw, value_lwsz)
         __hashmap_read_field(map_tindex, lm_value_addr, ent_addr_hi, offset, value_lwsz, RTN_OPT, out_ent_addr, out_ent_tindex, endian)
-        __hashmap_lock_release(ent_index, ent_state)
+        __hashmap_read_validate(ent_index, ent_ver, lookup_retry#)
         br[ret#]
     #elif (OP == HASHMAP_OP_REMOVE)
         __hashmap_lock_upgrade(ent_index, ent_state, retry#)
         __hashmap_table_return_credits(fd)
         __hashmap_set_opt_field(out_ent_lw, 0)
+        __hashmap_is_percpu(map_type, remove_ent#)
+        __hashmap_percpu_release(ent_addr_hi, offset, key_lwsz)
+remove_ent#:
         br_bset[ent_state, __HASHMAP_DESC_OV_BIT, delete_ov_ent#]
         __hashmap_lock_release_and_invalidate(ent_index, ent_state, fd)
         br[ret#]
@@ -811,13 +1175,32 @@ read_next_key#:
         __hashmap_lock_release(ent_index, ent_state)
         br[ret#]
     #elif ( (OP == HASHMAP_OP_ADD_ANY) || (OP == HASHMAP_OP_UPDATE) ) /* entry exists */
+        #if (__HASHMAP_ADD_FLAGS)
+            alu[--, in_flags, -, CMSG_BPF_NOEXIST]
+            beq[add_exists#]
+        #endif
         __hashmap_lock_upgrade(ent_index, ent_state, retry#)
         __hashmap_set_opt_field(out_ent_lw, 0)
         alu[bytes, --, b, key_lwsz, <<2]
         __hashmap_calc_value_addr(offset, bytes, offset)
+        __hashmap_is_percpu(map_type, update_value#)
+        __hashmap_percpu_elem(ent_addr_hi, offset, pc_elem)
+        #ifdef CMSG_MAP_PROC
+            __hashmap_percpu_set(lm_value_addr, value_mask, pc_elem, value_lwsz, endian)
+        #else
+            __hashmap_percpu_set_local(lm_value_addr, value_mask, pc_elem, value_lwsz, endian)
+        #endif
+        br[update_done#]
+update_value#:
         __hashmap_write_field(lm_value_addr, value_mask, ent_addr_hi, offset, value_lwsz, endian)
+update_done#:
         __hashmap_lock_release(ent_index, ent_state)
         br[ret#]
+        #if (__HASHMAP_ADD_FLAGS)
+add_exists#:
+            __hashmap_set_opt_field(out_rc, CMSG_RC_ERR_EEXIST)
+            br[miss#]
+        #endif
     #else
         __hashmap_set_opt_field(out_rc, CMSG_RC_ERR_EEXIST)
         br[miss#]
@@ -828,13 +1211,20 @@ check_ov_valid#:
 check_ov#:
     __hashmap_ov_lookup(hash[1], fd, tbl_addr_hi, ent_index, lm_key_addr, key_lwsz, map_tindex, ent_addr_hi, offset, ent_state, found#, endian, map_type)
 #if ( (OP == HASHMAP_OP_ADD_ANY) || (OP == HASHMAP_OP_ADD_ONLY) )   /* entry does not exist */
+        #if (__HASHMAP_ADD_FLAGS)
+            alu[--, in_flags, -, CMSG_BPF_EXIST]
+            beq[miss#]
+        #endif
         __hashmap_lock_upgrade(ent_index, ent_state, retry#)
         __hashmap_set_opt_field(out_rc, CMSG_RC_ERR_E2BIG)
-        __hashmap_table_take_credits(fd, miss#)
+        __hashmap_table_take_credits(fd, lru_evict#)
+        __hashmap_is_percpu(map_type, add_slot#)
+        __hashmap_percpu_alloc(pc_elem, add_error#)
+add_slot#:
         br_bclr[ent_state, __HASHMAP_DESC_VALID_BIT, write_tid_key#], defer[1]
         alu[ent_state, ent_state, and~, 1, <<__HASHMAP_DESC_VALID_BIT]
 
-        __hashmap_ov_add(hash[1], tbl_addr_hi, ent_index, fd, ent_addr_hi, offset, add_error#)
+        __hashmap_ov_add(hash[1], tbl_addr_hi, ent_index, fd, ent_addr_hi, offset, ov_add_error#)
         br[write_key#]
 write_tid_key#:
         __hashmap_write_tid(fd, ent_index)
@@ -843,16 +1233,39 @@ write_key#:
         __hashmap_set_opt_field(out_ent_lw, 0)
         alu[bytes, --, b, key_lwsz, <<2]
         __hashmap_calc_value_addr(offset, bytes, offset)
+        __hashmap_is_percpu(map_type, add_value#)
+        #ifdef CMSG_MAP_PROC
+            __hashmap_percpu_set(lm_value_addr, value_mask, pc_elem, value_lwsz, endian)
+        #else
+            __hashmap_percpu_set_local(lm_value_addr, value_mask, pc_elem, value_lwsz, endian)
+        #endif
+        __hashmap_percpu_store(ent_addr_hi, offset, pc_elem)
+        br[add_done#]
+add_value#:
         __hashmap_write_field(lm_value_addr, value_mask, ent_addr_hi, offset, value_lwsz, endian)
+add_done#:
         __hashmap_lock_release(ent_index, ent_state)
         __hashmap_set_opt_field(out_rc, CMSG_RC_SUCCESS)
         br[ret#]
+ov_add_error#:
+    __hashmap_is_percpu(map_type, add_error#)
+    __hashmap_percpu_free(pc_elem)
 add_error#:
     __hashmap_table_return_credits(fd)
+lru_evict#:
+    /* no room, LRU maps replace one of their entries in the bucket */
+    alu[--, map_type, -, BPF_MAP_TYPE_LRU_HASH]
+    bne[miss#]
+    __hashmap_lru_evict(hash[1], fd, tbl_addr_hi, ent_index, ent_addr_hi, offset, miss#, add_slot#)
+    br[write_key#]
 #endif /* ADD_ANY/UPDATE entry */
     /* falls thru to miss if entry is not valid, not found, and not add/update function */
 miss#:
-    __hashmap_lock_release(ent_index, ent_state)
+    #if (OP == HASHMAP_OP_LOOKUP)
+        __hashmap_read_validate(ent_index, ent_ver, lookup_retry#)
+    #else
+        __hashmap_lock_release(ent_index, ent_state)
+    #endif
     #if (OP != HASHMAP_OP_GETNEXT)
         br[NOTFOUND_LABEL]
     #else
@@ -866,13 +1279,83 @@ getfirst_ent#:
         __hashmap_lock_shared(ent_index, fd, found#, found#)
         br[found#]
 #endif
+#if (OP == HASHMAP_OP_LOOKUP)
+lookup_retry#:
+    /* a writer changed the entry, start over from the primary entry */
+    __hashmap_lock_init(ent_state, ent_addr_hi, offset, mu_partition, ent_index)
+    br[retry#]
+#endif
 #if (OP == HASHMAP_OP_REMOVE)
 delete_ov_ent#:
     __hashmap_ov_delete(tbl_addr_hi, ent_index, offset, ent_state)
     __hashmap_lock_release(ent_index, ent_state)
     br[ret#]
 #endif  /* REMOVE entry */
+#if ((OP != HASHMAP_OP_GETNEXT) && (OP != HASHMAP_OP_GETFIRST))
+array_ent#:
+    /* array maps index a flat region, no hash and no lock */
+    __hashmap_array_addr(lm_key_addr, ent_addr_hi, offset, array_shft, array_range#)
+    alu[--, map_type, -, BPF_MAP_TYPE_PERCPU_ARRAY]
+    bne[array_value#]
+    /* per-ME arrays: the slot of this ME, or slot 0 for control messages */
+    alu[array_shft, array_shft, -, HASHMAP_PERCPU_SLOTS_LOG2]
+    #ifndef CMSG_MAP_PROC
+        .begin
+            .reg slot_lo
+
+            __hashmap_percpu_array_slot(slot_lo, array_shft)
+            alu[offset, offset, +, slot_lo]
+        .end
+    #endif
+array_value#:
+    #if (OP == HASHMAP_OP_LOOKUP)
+        __hashmap_set_opt_field(out_rc, CMSG_RC_SUCCESS)
+        __hashmap_set_opt_field(out_ent_lw, value_lwsz)
+        immed[map_tindex, 0]        ; force read
+        __hashmap_read_field(map_tindex, lm_value_addr, ent_addr_hi, offset, value_lwsz, RTN_OPT, out_ent_addr, out_ent_tindex, endian)
+        br[ret#]
+    #elif ((OP == HASHMAP_OP_ADD_ANY) || (OP == HASHMAP_OP_UPDATE))
+        #if (__HASHMAP_ADD_FLAGS)
+            alu[--, in_flags, -, CMSG_BPF_NOEXIST]
+            beq[array_exists#]
+        #endif
+        #ifdef CMSG_MAP_PROC
+            alu[--, map_type, -, BPF_MAP_TYPE_PERCPU_ARRAY]
+            bne[array_write#]
+            __hashmap_percpu_set_slots(lm_value_addr, value_mask, ent_addr_hi, offset, array_shft, value_lwsz, endian)
+            br[array_written#]
+array_write#:
+        #endif
+        __hashmap_write_field(lm_value_addr, value_mask, ent_addr_hi, offset, value_lwsz, endian)
+array_written#:
+        __hashmap_set_opt_field(out_ent_lw, 0)
+        __hashmap_set_opt_field(out_rc, CMSG_RC_SUCCESS)
+        br[ret#]
+        #if (__HASHMAP_ADD_FLAGS)
+array_exists#:
+            /* every element of an array exists */
+            __hashmap_set_opt_field(out_rc, CMSG_RC_ERR_EEXIST)
+            br[NOTFOUND_LABEL]
+        #endif
+    #elif (OP == HASHMAP_OP_ADD_ONLY)
+        /* every element of an array exists */
+        __hashmap_set_opt_field(out_rc, CMSG_RC_ERR_EEXIST)
+        br[NOTFOUND_LABEL]
+    #else
+        /* elements of an array cannot be deleted */
+        __hashmap_set_opt_field(out_rc, CMSG_RC_ERR_EINVAL)
+        br[NOTFOUND_LABEL]
+    #endif
+array_range#:
+    #if (OP == HASHMAP_OP_LOOKUP)
+        __hashmap_set_opt_field(out_rc, CMSG_RC_ERR_ENOENT)
+    #else
+        __hashmap_set_opt_field(out_rc, CMSG_RC_ERR_E2BIG)
+    #endif
+    br[NOTFOUND_LABEL]
+#endif
 ret#:
+    #undef __HASHMAP_ADD_FLAGS
 .end
 #endm
 
@@ -885,6 +1368,7 @@ ret#:
 
 #define HTAB_EBPF_LM_KEY_HANDLE 0
 #define HTAB_EBPF_LM_KEY_INDEX  *l$index0
+#define HTAB_EBPF_LM_VALUE_HANDLE 2
 
 #macro htab_reserve_regs(START, END)
     #define_eval __REGS START
@@ -986,6 +1470,35 @@ ret#:
 .end
 #endm
 
+/*
+ * Return in_rc, a CMSG_RC_xxx errno, to the eBPF program in A0/A1 as the
+ * negated 64 bit value of bpf_map_update_elem() and bpf_map_delete_elem().
+ */
+#macro __htab_subr_set_rc(out_ebpf_rc, out_ebpf_rc_hi, in_rc)
+.begin
+    .reg rc
+    .reg rc_hi
+
+    alu[rc, 0, -, in_rc]
+    asr[rc_hi, rc, >>31]
+
+    #pragma warning(push)
+    #pragma warning(disable: 5186) //disable warning "gpr_wrboth is experimental"
+    .reg_addr out_ebpf_rc 0 A
+    .set out_ebpf_rc
+    alu[out_ebpf_rc, --, b, rc], gpr_wrboth
+    .reg_addr out_ebpf_rc_hi 1 A
+    .set out_ebpf_rc_hi
+    alu[out_ebpf_rc_hi, --, b, rc_hi], gpr_wrboth
+    #pragma warning (pop)
+.end
+#endm
+
+/*
+ * bpf_map_update_elem(), key at LM0 and value at LM2. BPF_NOEXIST fails with
+ * -EEXIST on an existing entry and BPF_EXIST with -ENOENT on a missing one,
+ * other flags are refused with -EINVAL.
+ */
 #macro htab_map_update_subr_func()
 .reentry
 .begin
@@ -993,8 +1506,23 @@ ret#:
     .reg htab_return_addr
     .reg_addr htab_return_addr 0 B
     .set htab_return_addr
+    .reg rtnB1
+    .reg_addr rtnB1 1 B
+    .set rtnB1
+    .reg htab_in_tid
+    .reg_addr htab_in_tid 0 A
+    .set htab_in_tid
+    .reg htab_in_flags
+    .reg_addr htab_in_flags 8 A
+    .set htab_in_flags
 
+    .reg rtn_addr
     .reg ebpf_rc
+    .reg ebpf_rc_hi
+    .reg rc
+    .reg tid
+    .reg lm_key_offset
+    .reg lm_value_offset
 
     #define HASHMAP_RXFR_COUNT 16
     #define MAP_RDXR $__pv_pkt_data
@@ -1007,99 +1535,96 @@ ret#:
 
     #define MAP_RXCAM $__pv_pkt_data[16]    /* start at 16 for 8 regs */
 
-    .reg tid
-    .reg lm_key_offset
-    .reg lm_value_offset
-
     local_csr_rd[ACTIVE_LM_ADDR_/**/HTAB_EBPF_LM_KEY_HANDLE]
     immed[lm_key_offset, 0]
-    alu[tid, --, b,HTAB_EBPF_LM_KEY_INDEX]
-    alu[lm_value_offset, 40, +, lm_key_offset]  ; assume value is 40 bytes after keys
+    local_csr_rd[ACTIVE_LM_ADDR_/**/HTAB_EBPF_LM_VALUE_HANDLE]
+    immed[lm_value_offset, 0]
+    alu[tid, htab_in_tid, or, 0]
+    alu[rtn_addr, --, b, htab_return_addr]
 
-    hashmap_ops(tid, lm_key_offset, lm_value_offset, HASHMAP_OP_ADD, htab_update_error_map#, htab_update_not_found#, HASHMAP_RTN_ADDR, --, --, --, swap)
+    immed[rc, CMSG_RC_ERR_EINVAL]
+    passert(CMSG_BPF_ANY, "EQ", 0)
+    passert(CMSG_BPF_NOEXIST, "LT", CMSG_BPF_EXIST)
+    alu[--, htab_in_flags, -, (CMSG_BPF_EXIST + 1)]
+    bhs[htab_update_done#]
 
-    .reg_addr ebpf_rc 0 A
-    immed[ebpf_rc, 0]
-    br[ret#]
-
-    #undef HASHMAP_TXFR_COUNT
-    #undef MAP_TXFR
-    #undef HASHMAP_RXFR_COUNT
-    #undef MAP_RDXR
-    #undef MAP_RXCAM
+    hashmap_ops(tid, lm_key_offset, lm_value_offset, HASHMAP_OP_ADD_ANY, htab_update_done#, htab_update_done#, HASHMAP_RTN_ADDR, --, --, --, swap, rc, htab_in_flags)
 
-htab_update_error_map#:
-    #define  _RC_EINVAL_    (-22)
-    .reg_addr ebpf_rc 0 A
-    .set ebpf_rc
-    move(ebpf_rc, _RC_EINVAL_)
-    #undef _RC_EINVAL_
-    br[ret#]
-htab_update_not_found#:
-    #define  _RC_ENOMEM_    (-12)
-    .reg_addr ebpf_rc 0 A
-    .set ebpf_rc
-    move(ebpf_rc, _RC_ENOMEM_)
-    #undef _RC_ENOMEM_
+htab_update_done#:
+    // restore stack LM before returning from map function
+    local_csr_wr[ACTIVE_LM_ADDR_/**/HTAB_EBPF_LM_KEY_HANDLE, lm_key_offset]
+    __htab_subr_set_rc(ebpf_rc, ebpf_rc_hi, rc)
 
     htab_subr_regs_free()
-ret#:
     #pragma warning(push)
     #pragma warning(disable: 5116)  // disable warning "Return register may not contain valid addr"
-        .use ebpf_rc
         .use htab_return_addr
-        rtn[htab_return_addr]
+        .use ebpf_rc
+        .use ebpf_rc_hi
+        .use rtnB1
+        rtn[rtn_addr]
     #pragma warning(pop)
+
+    #undef HASHMAP_TXFR_COUNT
+    #undef MAP_TXFR
+    #undef HASHMAP_RXFR_COUNT
+    #undef MAP_RDXR
+    #undef MAP_RXCAM
 .end
 #endm
 
+/* bpf_map_delete_elem(), key at LM0 */
 #macro htab_map_delete_subr_func()
 .reentry
 .begin
     htab_subr_regs_alloc()
-
     .reg htab_return_addr
     .reg_addr htab_return_addr 0 B
     .set htab_return_addr
+    .reg rtnB1
+    .reg_addr rtnB1 1 B
+    .set rtnB1
+    .reg htab_in_tid
+    .reg_addr htab_in_tid 0 A
+    .set htab_in_tid
 
+    .reg rtn_addr
     .reg ebpf_rc
+    .reg ebpf_rc_hi
+    .reg rc
+    .reg tid
+    .reg lm_key_offset
 
     #define HASHMAP_RXFR_COUNT 16
     #define MAP_RDXR $__pv_pkt_data
-    .reg tid
-    .reg lm_key_offset
+    #define MAP_RXCAM $__pv_pkt_data[16]    /* start at 16 for 8 regs */
 
     local_csr_rd[ACTIVE_LM_ADDR_/**/HTAB_EBPF_LM_KEY_HANDLE]
     immed[lm_key_offset, 0]
-    alu[tid, --, b,HTAB_EBPF_LM_KEY_INDEX]
-    hashmap_ops(tid, lm_key_offset, --, HASHMAP_OP_REMOVE, htap_del_error_map#, htap_del_not_found#, HASHMAP_RTN_ADDR, --, --, --, swap)
-    .reg_addr ebpf_rc 0 A
-    immed[ebpf_rc, 0]
-    br[ret#]
-    #undef HASHMAP_RXFR_COUNT
-    #undef MAP_RDXR
-htap_del_error_map#:
-    #define  _RC_EINVAL_    (-22)
-    .reg_addr ebpf_rc 0 A
-    .set ebpf_rc
-    move(ebpf_rc, _RC_EINVAL_)
-    #undef _RC_EINVAL_
-    br[ret#]
-htap_del_not_found#:
-    #define  _RC_ENOENT_    (-2)
-    .reg_addr ebpf_rc 0 A
-    .set ebpf_rc
-    move(ebpf_rc, _RC_ENOENT_)
-    #undef _RC_ENOENT_
+    alu[tid, htab_in_tid, or, 0]
+    alu[rtn_addr, --, b, htab_return_addr]
+
+    immed[rc, CMSG_RC_ERR_EINVAL]
+    hashmap_ops(tid, lm_key_offset, --, HASHMAP_OP_REMOVE, htab_delete_done#, htab_delete_done#, HASHMAP_RTN_ADDR, --, --, --, swap, rc)
+
+htab_delete_done#:
+    // restore stack LM before returning from map function
+    local_csr_wr[ACTIVE_LM_ADDR_/**/HTAB_EBPF_LM_KEY_HANDLE, lm_key_offset]
+    __htab_subr_set_rc(ebpf_rc, ebpf_rc_hi, rc)
 
     htab_subr_regs_free()
-ret#:
     #pragma warning(push)
     #pragma warning(disable: 5116)  // disable warning "Return register may not contain valid addr"
-        .use ebpf_rc
         .use htab_return_addr
-        rtn[htab_return_addr]
+        .use ebpf_rc
+        .use ebpf_rc_hi
+        .use rtnB1
+        rtn[rtn_addr]
     #pragma warning(pop)
+
+    #undef HASHMAP_RXFR_COUNT
+    #undef MAP_RDXR
+    #undef MAP_RXCAM
 .end
 #endm
 
@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2017-2020 Netronome Systems, Inc.  All rights reserved.
+ *
+ * @file        hashmap_array.uc
+ * @brief       direct indexed values of BPF_MAP_TYPE_ARRAY and
+ *              BPF_MAP_TYPE_PERCPU_ARRAY maps.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef __HASHMAP_ARRAY_UC__
+#define __HASHMAP_ARRAY_UC__
+
+/*
+ * An array map does not use the hash table. Its values live in a flat region
+ * of the array pool, value n at region + (n << stride shift). The stride is
+ * the value size rounded up to a power of two of at least 8 bytes, so values
+ * stay 64-bit aligned and never straddle a 64 byte line. The fd table holds
+ * the offset of the region in the pool and the stride shift.
+ *
+ * A per-ME array has HASHMAP_PERCPU_SLOTS values of that stride per index,
+ * one per datapath ME as in hashmap_percpu.uc, its stride shift in the fd
+ * table covers all of them.
+ *
+ * Lookups and updates take no lock, as with host array maps a reader can see
+ * a value that is being written. Regions are handed out by the control
+ * message ME, see cmsg_array_alloc(), and cleared when allocated.
+ */
+#define HASHMAP_ARRAY_POOL_SZ           (64 << 20)
+#define HASHMAP_ARRAY_ALIGN             256
+#define HASHMAP_ARRAY_MIN_SHFT          3
+#define_eval HASHMAP_ARRAY_MAX_ENTRIES  (HASHMAP_ARRAY_POOL_SZ >> HASHMAP_ARRAY_MIN_SHFT)
+
+
+#macro __hashmap_array_init()
+    .alloc_mem HASHMAP_ARRAY_BASE emem global HASHMAP_ARRAY_POOL_SZ HASHMAP_ARRAY_ALIGN
+    .init HASHMAP_ARRAY_BASE 0
+#endm
+
+/* stride shift of an array with values of in_value_size bytes */
+#macro hashmap_array_shft(in_value_size, out_shft)
+.begin
+    .reg stride
+
+    immed[out_shft, HASHMAP_ARRAY_MIN_SHFT]
+loop#:
+    alu[--, out_shft, or, 0]
+    alu[stride, --, b, 1, <<indirect]
+    alu[--, stride, -, in_value_size]
+    bhs[ret#]
+    br[loop#], defer[1]
+        alu[out_shft, out_shft, +, 1]
+ret#:
+.end
+#endm
+
+/*
+ * Zero in_size bytes of the pool at in_offset, both HASHMAP_ARRAY_ALIGN
+ * aligned. The write transfer registers are not changed while the writes
+ * are in flight, so four writes share them.
+ */
+#macro hashmap_array_clear(in_offset, in_size)
+.begin
+    .reg pool_hi
+    .reg offset
+    .reg end
+    .sig clr_sig0, clr_sig1, clr_sig2, clr_sig3
+
+    passert(HASHMAP_TXFR_COUNT, "EQ", 16)
+    passert(HASHMAP_ARRAY_ALIGN, "EQ", (4 * HASHMAP_TXFR_COUNT * 4))
+
+    move(pool_hi, HASHMAP_ARRAY_BASE >>8)
+    alu[offset, --, b, in_offset]
+    alu[end, in_offset, +, in_size]
+    aggregate_zero(MAP_TXFR, HASHMAP_TXFR_COUNT)
+
+clear_loop#:
+    #define_eval __IDX 0
+    #while (__IDX < 4)
+        ov_single(OV_LENGTH, HASHMAP_TXFR_COUNT, OVF_SUBTRACT_ONE)
+        mem[write32, MAP_TXFR[0], pool_hi, <<8, offset, max_/**/HASHMAP_TXFR_COUNT], indirect_ref, sig_done[clr_sig/**/__IDX]
+        alu[offset, offset, +, (HASHMAP_TXFR_COUNT * 4)]
+        #define_eval __IDX (__IDX + 1)
+    #endloop
+    #undef __IDX
+    ctx_arb[clr_sig0, clr_sig1, clr_sig2, clr_sig3]
+    alu[--, offset, -, end]
+    blo[clear_loop#]
+.end
+#endm
+
+/*
+ * Address of the value indexed by the key at in_lm_key_addr, and the stride
+ * shift of the map. Expects the fd table entry of the map in MAP_RDXR, see
+ * hashmap_get_fd().
+ */
+#macro __hashmap_array_addr(in_lm_key_addr, out_addr_hi, out_addr_lo, out_shft, OUT_OF_RANGE_LABEL)
+.begin
+    .reg idx
+
+    __hashmap_lm_handles_define()
+    local_csr_wr[ACTIVE_LM_ADDR_/**/HASHMAP_LM_HANDLE, in_lm_key_addr]
+    alu[out_shft, --, b, MAP_RDXR[__HASHMAP_FD_NDX_ARRAY_SHFT]]
+    move(out_addr_hi, HASHMAP_ARRAY_BASE >>8)
+    nop
+    alu[idx, --, b, HASHMAP_LM_INDEX]
+    __hashmap_lm_handles_undef()
+
+    alu[--, idx, -, MAP_RDXR[__HASHMAP_FD_NDX_MAX_ENT]]
+    bhs[OUT_OF_RANGE_LABEL]
+    alu[--, out_shft, or, 0]
+    alu[idx, --, b, idx, <<indirect]
+    alu[out_addr_lo, idx, +, MAP_RDXR[__HASHMAP_FD_NDX_ARRAY_OFF]]
+.end
+#endm
+
+#endif /* __HASHMAP_ARRAY_UC__ */
@@ -276,7 +276,7 @@ ret#:
     ctx_arb[ov_add_sig], br[ret#]
 
 no_free_buf#:
-    /* TODO: LRU  */
+    /* LRU maps evict in the caller, see __hashmap_lru_evict() */
     br[ERROR_LABEL]
 
 not_add#:
@@ -300,6 +300,8 @@ ret#:
     .reg addr_lo
 
     __hashmap_freelist_free(in_offset)
+    /* see __hashmap_lock_release_and_invalidate() */
+    __hashmap_lru_ref_clr(in_idx, in_state)
 
     alu[addr_lo, --, b, in_idx, <<HASHMAP_ENTRY_SZ_SHFT]
 
@@ -0,0 +1,426 @@
+/*
+ * Copyright (C) 2017-2020 Netronome Systems, Inc.  All rights reserved.
+ *
+ * @file        hashmap_percpu.uc
+ * @brief       per-ME values of BPF_MAP_TYPE_PERCPU_HASH and
+ *              BPF_MAP_TYPE_PERCPU_ARRAY maps.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#ifndef __HASHMAP_PERCPU_UC__
+#define __HASHMAP_PERCPU_UC__
+
+#include <ring_utils.uc>
+#include <endian.uc>
+
+/*
+ * The value of an entry in a per-ME hash map holds the index of an element
+ * of the per-ME pool instead of the value itself. An element has one value
+ * slot per datapath ME, so datapath MEs update their own copy of a counter
+ * instead of contending on one MU address. Datapath islands are numbered from
+ * island 32 up, worker n of island 32 + i takes slot
+ * i * HASHMAP_PERCPU_ISLAND_SLOTS + n, the slot count is rounded up to a
+ * power of two.
+ *
+ * Datapath updates write the slot of the calling ME only, see
+ * __hashmap_percpu_set_local(). Elements are cleared when they are returned
+ * to the pool, so a new element starts at zero. Control messages write the
+ * value to slot 0 and clear the other slots, and read back the sum of all
+ * slots, see __hashmap_percpu_set() and __hashmap_percpu_sum().
+ *
+ * An element takes HASHMAP_PERCPU_SLOTS * 64 bytes of EMEM, 4K with five
+ * islands of ten workers, so the pool is much smaller than
+ * HASHMAP_MAX_ENTRIES. The BPF capability advertises a single entry limit for
+ * all map types, the map alloc control message therefore reserves max_entries
+ * elements for each per-ME hash map and fails once the pool is exhausted, see
+ * cmsg_percpu_alloc(). HASHMAP_PERCPU_ENTRIES may be overridden at build time.
+ *
+ * Per-ME array maps do not use the pool. Their elements are laid out the same
+ * way in the array pool with a slot per ME of the array stride, and indexed
+ * directly, see __hashmap_array_addr().
+ */
+#ifndef HASHMAP_PERCPU_ENTRIES
+    #define HASHMAP_PERCPU_ENTRIES      4096
+#endif
+#ifndef NIC_DP_ISLANDS
+    #define NIC_DP_ISLANDS              8
+#endif
+#ifdef WORKERS_PER_ISLAND
+    #define HASHMAP_PERCPU_ISLAND_SLOTS WORKERS_PER_ISLAND
+#else
+    #define HASHMAP_PERCPU_ISLAND_SLOTS 12
+#endif
+#define_eval HASHMAP_PERCPU_SLOTS_LOG2  0
+#while ((1 << HASHMAP_PERCPU_SLOTS_LOG2) < (NIC_DP_ISLANDS * HASHMAP_PERCPU_ISLAND_SLOTS))
+    #define_eval HASHMAP_PERCPU_SLOTS_LOG2 (HASHMAP_PERCPU_SLOTS_LOG2 + 1)
+#endloop
+#define_eval HASHMAP_PERCPU_SLOTS       (1 << HASHMAP_PERCPU_SLOTS_LOG2)
+#define HASHMAP_PERCPU_SLOT_SZ          64
+#define_eval HASHMAP_PERCPU_SLOT_SZ_SHFT (LOG2(HASHMAP_PERCPU_SLOT_SZ))
+#define_eval HASHMAP_PERCPU_ELEM_SZ_SHFT (HASHMAP_PERCPU_SLOT_SZ_SHFT + HASHMAP_PERCPU_SLOTS_LOG2)
+
+/* slot of this ME, resolved when the datapath is loaded */
+#define __HASHMAP_PERCPU_SLOT_IDX       ((((__ISLAND - 32) & 7) * HASHMAP_PERCPU_ISLAND_SLOTS) + ((__MEID & 0xf) - 4))
+
+#define __HASHMAP_PERCPU_SIG_BIT__      31
+
+#if (HASHMAP_PERCPU_SLOT_SZ < HASHMAP_MAX_VALU_SZ)
+    #error "HASHMAP_PERCPU_SLOT_SZ must hold HASHMAP_MAX_VALU_SZ"
+#endif
+
+
+#macro __hashmap_percpu_init(NUM_ENTRIES)
+
+    passert(NUM_ENTRIES, "MULTIPLE_OF", 16)
+
+    EMEM0_QUEUE_ALLOC(HASHMAP_PERCPU_FREE_QID, global)
+    .alloc_mem HASHMAP_PERCPU_FREE_RBASE emem0 global (NUM_ENTRIES * 4) (NUM_ENTRIES * 4)
+    .init_mu_ring HASHMAP_PERCPU_FREE_QID HASHMAP_PERCPU_FREE_RBASE 0
+
+    .alloc_mem HASHMAP_PERCPU_BASE emem global (NUM_ENTRIES << HASHMAP_PERCPU_ELEM_SZ_SHFT) 256
+    .init HASHMAP_PERCPU_BASE 0
+
+#ifdef GLOBAL_INIT
+    .if (ctx() == 0)
+    .begin
+        .sig sig_init_write
+        .reg index
+        .reg val
+        .reg $data[16]
+        .xfer_order $data
+
+        move(index, (NUM_ENTRIES-1))
+        alu[val, --, b, 1, <<__HASHMAP_PERCPU_SIG_BIT__]
+        .while (index > 0)
+            #define_eval __IDX 0
+            #while (__IDX < 16)
+                alu[$data[__IDX], val, or, index]
+                alu[index, index, -, 1]
+                #define_eval __IDX (__IDX + 1)
+            #endloop
+            ru_emem_ring_op($data, HASHMAP_PERCPU_FREE_QID, sig_init_write, journal, HASHMAP_PERCPU_FREE_RBASE, 16, --)
+        .endw
+        #undef __IDX
+    .end
+    .endif
+#endif    //GLOBAL_INIT
+#endm
+
+/* per-ME hash maps, per-ME arrays are handled with the other arrays */
+#macro __hashmap_is_percpu(in_map_type, NOT_PERCPU_LABEL)
+    alu[--, in_map_type, -, BPF_MAP_TYPE_PERCPU_HASH]
+    bne[NOT_PERCPU_LABEL]
+#endm
+
+#macro __hashmap_percpu_alloc(out_elem, NO_ELEM_LABEL)
+.begin
+    .sig sig_percpu_pop
+    .reg $free_index
+    .reg sig_bit
+
+do_pop#:
+    ru_emem_ring_op($free_index, HASHMAP_PERCPU_FREE_QID, sig_percpu_pop, pop, HASHMAP_PERCPU_FREE_RBASE, 1, NO_ELEM_LABEL)
+
+    br_bclr[$free_index, __HASHMAP_PERCPU_SIG_BIT__, do_pop#], defer[2]
+    alu_shf[sig_bit, --, b, 1, <<__HASHMAP_PERCPU_SIG_BIT__]
+    alu[out_elem, $free_index, and~, sig_bit]
+.end
+#endm
+
+#macro __hashmap_percpu_free(in_elem)
+.begin
+    .sig sig_percpu_put
+    .reg $free_index
+
+    alu[$free_index, in_elem, or, 1, <<__HASHMAP_PERCPU_SIG_BIT__]
+    ru_emem_ring_op($free_index, HASHMAP_PERCPU_FREE_QID, sig_percpu_put, put, HASHMAP_PERCPU_FREE_RBASE, 1, --)
+.end
+#endm
+
+/* element index held in the value of the entry, in_value_lo is the value */
+#macro __hashmap_percpu_elem(in_addr_hi, in_value_lo, out_elem)
+.begin
+    .reg $elem
+    .sig percpu_elem_sig
+
+    mem[read32, $elem, in_addr_hi, <<8, in_value_lo, 1], ctx_swap[percpu_elem_sig]
+    alu[out_elem, --, b, $elem]
+.end
+#endm
+
+#macro __hashmap_percpu_store(in_addr_hi, in_value_lo, in_elem)
+.begin
+    .reg $elem
+    .sig percpu_store_sig
+
+    alu[$elem, --, b, in_elem]
+    mem[write32, $elem, in_addr_hi, <<8, in_value_lo, 1], ctx_swap[percpu_store_sig]
+.end
+#endm
+
+
+/* offset of this ME's slot in an element */
+#macro __hashmap_percpu_slot(out_slot_lo)
+    immed[out_slot_lo, (__HASHMAP_PERCPU_SLOT_IDX << HASHMAP_PERCPU_SLOT_SZ_SHFT)] ; __ISLAND, __MEID
+#endm
+
+/* offset of this ME's slot in an element with 1 << in_slot_shft byte slots */
+#macro __hashmap_percpu_array_slot(out_slot_lo, in_slot_shft)
+    immed[out_slot_lo, __HASHMAP_PERCPU_SLOT_IDX] ; __ISLAND, __MEID
+    alu[--, in_slot_shft, or, 0]
+    alu[out_slot_lo, --, b, out_slot_lo, <<indirect]
+#endm
+
+/*
+ * Turn the value address of an entry into the address of this ME's slot.
+ * The control message MEs have no slot and get the element itself.
+ */
+#macro __hashmap_percpu_addr(io_addr_hi, io_addr_lo)
+.begin
+    .reg elem
+    .reg slot_lo
+
+    __hashmap_percpu_elem(io_addr_hi, io_addr_lo, elem)
+    move(io_addr_hi, HASHMAP_PERCPU_BASE >>8)
+    alu[io_addr_lo, --, b, elem, <<HASHMAP_PERCPU_ELEM_SZ_SHFT]
+    #ifndef CMSG_MAP_PROC
+        __hashmap_percpu_slot(slot_lo)
+        alu[io_addr_lo, io_addr_lo, +, slot_lo]
+    #endif
+.end
+#endm
+
+/*
+ * Zero the first in_wlen words of the slots from in_slot_lo to in_end_lo,
+ * 1 << in_slot_shft bytes apart.
+ */
+#macro __hashmap_percpu_clear(in_pool_hi, in_slot_lo, in_end_lo, in_slot_shft, in_wlen)
+.begin
+    .reg slot_lo
+    .reg slot_sz
+    .reg zero_lw
+    .reg rest_lw
+    .reg tmp
+    .sig zero_sig
+
+    #if ((HASHMAP_TXFR_COUNT * 2) < (HASHMAP_MAX_VALU_SZ / 4))
+        #error "HASHMAP_TXFR_COUNT too small to clear a slot in two writes"
+    #endif
+
+    aggregate_zero(MAP_TXFR, HASHMAP_TXFR_COUNT)
+    alu[--, in_slot_shft, or, 0]
+    alu[slot_sz, --, b, 1, <<indirect]
+    alu[zero_lw, --, b, in_wlen]
+    alu[rest_lw, in_wlen, -, HASHMAP_TXFR_COUNT]
+    ble[clear#]
+    immed[zero_lw, HASHMAP_TXFR_COUNT]
+
+clear#:
+    alu[slot_lo, --, b, in_slot_lo]
+
+clear_slot#:
+    ov_start(OV_LENGTH)
+    ov_set_use(OV_LENGTH, zero_lw, OVF_SUBTRACT_ONE)   ; length is in 32-bit LWs
+    ov_clean
+    mem[write32, MAP_TXFR[0], in_pool_hi, <<8, slot_lo, max_/**/HASHMAP_TXFR_COUNT], indirect_ref, ctx_swap[zero_sig]
+    alu[--, rest_lw, -, 0]
+    ble[next_slot#]
+    alu[tmp, slot_lo, +, (HASHMAP_TXFR_COUNT * 4)]
+    ov_start(OV_LENGTH)
+    ov_set_use(OV_LENGTH, rest_lw, OVF_SUBTRACT_ONE)
+    ov_clean
+    mem[write32, MAP_TXFR[0], in_pool_hi, <<8, tmp, max_/**/HASHMAP_TXFR_COUNT], indirect_ref, ctx_swap[zero_sig]
+
+next_slot#:
+    alu[slot_lo, slot_lo, +, slot_sz]
+    alu[--, slot_lo, -, in_end_lo]
+    blo[clear_slot#]
+.end
+#endm
+
+/*
+ * Return the element of an entry to the pool, in_key_lo is the entry key.
+ * All slots are cleared first, so elements in the pool are always zero and a
+ * datapath add only has to write its own slot.
+ */
+#macro __hashmap_percpu_release(in_addr_hi, in_key_lo, in_key_lwsz)
+.begin
+    .reg bytes
+    .reg value_lo
+    .reg elem
+    .reg pool_hi
+    .reg elem_lo
+    .reg end_lo
+    .reg shft
+    .reg wlen
+    .reg tmp
+
+    alu[bytes, --, b, in_key_lwsz, <<2]
+    __hashmap_calc_value_addr(in_key_lo, bytes, value_lo)
+    __hashmap_percpu_elem(in_addr_hi, value_lo, elem)
+
+    move(pool_hi, HASHMAP_PERCPU_BASE >>8)
+    alu[elem_lo, --, b, elem, <<HASHMAP_PERCPU_ELEM_SZ_SHFT]
+    move(tmp, (1 << HASHMAP_PERCPU_ELEM_SZ_SHFT))
+    alu[end_lo, elem_lo, +, tmp]
+    immed[shft, HASHMAP_PERCPU_SLOT_SZ_SHFT]
+    immed[wlen, (HASHMAP_MAX_VALU_SZ / 4)]
+    __hashmap_percpu_clear(pool_hi, elem_lo, end_lo, shft, wlen)
+
+    __hashmap_percpu_free(elem)
+.end
+#endm
+
+/*
+ * Write the value at lm_field_addr to slot 0 of the element at in_elem_lo,
+ * with 1 << in_slot_shft byte slots, and clear the value in the other slots,
+ * so the sum of the slots is the value written.
+ */
+#macro __hashmap_percpu_set_slots(lm_field_addr, field_mask, in_pool_hi, in_elem_lo, in_slot_shft, in_wlen, endian)
+.begin
+    .reg slot_lo
+    .reg end_lo
+    .reg tmp
+
+    __hashmap_write_field(lm_field_addr, field_mask, in_pool_hi, in_elem_lo, in_wlen, endian)
+
+    alu[tmp, in_slot_shft, +, HASHMAP_PERCPU_SLOTS_LOG2]
+    alu[--, tmp, or, 0]
+    alu[end_lo, --, b, 1, <<indirect]
+    alu[end_lo, end_lo, +, in_elem_lo]
+    alu[--, in_slot_shft, or, 0]
+    alu[slot_lo, --, b, 1, <<indirect]
+    alu[slot_lo, slot_lo, +, in_elem_lo]
+    __hashmap_percpu_clear(in_pool_hi, slot_lo, end_lo, in_slot_shft, in_wlen)
+.end
+#endm
+
+/* __hashmap_percpu_set_slots() for element in_elem of the per-ME pool */
+#macro __hashmap_percpu_set(lm_field_addr, field_mask, in_elem, in_wlen, endian)
+.begin
+    .reg pool_hi
+    .reg elem_lo
+    .reg shft
+
+    move(pool_hi, HASHMAP_PERCPU_BASE >>8)
+    alu[elem_lo, --, b, in_elem, <<HASHMAP_PERCPU_ELEM_SZ_SHFT]
+    immed[shft, HASHMAP_PERCPU_SLOT_SZ_SHFT]
+    __hashmap_percpu_set_slots(lm_field_addr, field_mask, pool_hi, elem_lo, shft, in_wlen, endian)
+.end
+#endm
+
+/*
+ * Write the value at lm_field_addr to this ME's slot of an element, the
+ * slots of the other MEs are left alone. Elements come out of the pool
+ * cleared, see __hashmap_percpu_release().
+ */
+#macro __hashmap_percpu_set_local(lm_field_addr, field_mask, in_elem, in_wlen, endian)
+.begin
+    .reg pool_hi
+    .reg elem_lo
+    .reg slot_lo
+
+    move(pool_hi, HASHMAP_PERCPU_BASE >>8)
+    alu[elem_lo, --, b, in_elem, <<HASHMAP_PERCPU_ELEM_SZ_SHFT]
+    __hashmap_percpu_slot(slot_lo)
+    alu[slot_lo, elem_lo, +, slot_lo]
+    __hashmap_write_field(lm_field_addr, field_mask, pool_hi, slot_lo, in_wlen, endian)
+.end
+#endm
+
+/*
+ * Sum the slots of the element at in_elem_lo, 1 << in_slot_shft bytes apart,
+ * into the write side of io_xfer. The value is summed as 64-bit little
+ * endian counters, an odd last word as a 32-bit counter. lm_addr holds the
+ * running sum, in_wlen words.
+ */
+#macro __hashmap_percpu_sum(io_xfer, XFER_LW, lm_addr, in_pool_hi, in_elem_lo, in_slot_shft, in_wlen)
+.begin
+    .reg slot_sz
+    .reg slot_lo
+    .reg end_lo
+    .reg ctx
+    .reg tindex
+    .reg pairs
+    .reg cnt
+    .reg lo
+    .reg hi
+    .reg tmp
+    .sig sum_read_sig
+
+    __hashmap_lm_handles_define()
+
+    local_csr_rd[ACTIVE_CTX_STS]
+    immed[ctx, 0]
+    alu[ctx, ctx, and, 7]
+    alu[tindex, (&io_xfer[0] << 2), or, ctx, <<7]
+
+    alu[slot_lo, --, b, in_elem_lo]
+    alu[tmp, in_slot_shft, +, HASHMAP_PERCPU_SLOTS_LOG2]
+    alu[--, tmp, or, 0]
+    alu[end_lo, --, b, 1, <<indirect]
+    alu[end_lo, end_lo, +, slot_lo]
+    alu[--, in_slot_shft, or, 0]
+    alu[slot_sz, --, b, 1, <<indirect]
+    alu[pairs, --, b, in_wlen, >>1]
+
+    local_csr_wr[ACTIVE_LM_ADDR_/**/HASHMAP_LM_HANDLE, lm_addr]
+    alu[cnt, --, b, in_wlen]
+    nop
+    nop
+clear_sum#:
+    alu[HASHMAP_LM_INDEX++, --, b, 0]
+    alu[cnt, cnt, -, 1]
+    bne[clear_sum#]
+
+sum_slot#:
+    ov_start(OV_LENGTH)
+    ov_set_use(OV_LENGTH, in_wlen, OVF_SUBTRACT_ONE)   ; length is in 32-bit LWs
+    ov_clean
+    mem[read32, io_xfer[0], in_pool_hi, <<8, slot_lo, max_/**/XFER_LW], indirect_ref, ctx_swap[sum_read_sig]
+    local_csr_wr[T_INDEX, tindex]
+    local_csr_wr[ACTIVE_LM_ADDR_/**/HASHMAP_LM_HANDLE, lm_addr]
+    alu[cnt, --, b, pairs]
+    beq[sum_word#]
+
+sum_pair#:
+    alu[tmp, --, b, *$index++]
+    swap(lo, tmp, NO_LOAD_CC)
+    alu[tmp, --, b, *$index++]
+    swap(hi, tmp, NO_LOAD_CC)
+    alu[lo, lo, +, HASHMAP_LM_INDEX[0]]
+    alu[hi, hi, +carry, HASHMAP_LM_INDEX[1]]
+    alu[HASHMAP_LM_INDEX++, --, b, lo]
+    alu[HASHMAP_LM_INDEX++, --, b, hi]
+    alu[cnt, cnt, -, 1]
+    bne[sum_pair#]
+
+sum_word#:
+    br_bclr[in_wlen, 0, next_slot#]
+    alu[tmp, --, b, *$index++]
+    swap(lo, tmp, NO_LOAD_CC)
+    alu[HASHMAP_LM_INDEX, lo, +, HASHMAP_LM_INDEX]
+
+next_slot#:
+    alu[slot_lo, slot_lo, +, slot_sz]
+    alu[--, slot_lo, -, end_lo]
+    blo[sum_slot#]
+
+    local_csr_wr[ACTIVE_LM_ADDR_/**/HASHMAP_LM_HANDLE, lm_addr]
+    local_csr_wr[T_INDEX, tindex]
+    alu[cnt, --, b, in_wlen]
+    nop
+    nop
+copy_sum#:
+    alu[tmp, --, b, HASHMAP_LM_INDEX++]
+    swap(lo, tmp, NO_LOAD_CC)
+    alu[*$index++, --, b, lo]
+    alu[cnt, cnt, -, 1]
+    bne[copy_sum#]
+
+    __hashmap_lm_handles_undef()
+.end
+#endm
+
+#endif /* __HASHMAP_PERCPU_UC__ */
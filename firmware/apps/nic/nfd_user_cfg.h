@@ -204,7 +204,44 @@
      NFD_VF_CFG_MB_CAP_SPOOF | NFD_VF_CFG_MB_CAP_LINK_STATE |\
      NFD_VF_CFG_MB_CAP_TRUST)
 
-#define NFD_RSS_HASH_FUNC NFP_NET_CFG_RSS_CRC32
+#define NFD_RSS_HASH_FUNC (NFP_NET_CFG_RSS_TOEPLITZ | NFP_NET_CFG_RSS_CRC32)
+
+/* Firmware specific NFP_NET_CFG_RSS_CTRL flag requesting a symmetric CRC32
+ * hash, so both directions of a flow land on the same queue. Takes
+ * precedence over NFP_NET_CFG_RSS_TOEPLITZ. */
+#define NFP_NET_CFG_RSS_SYMMETRIC (1 << 23)
+
+/* Firmware specific features are enabled through the top bits of
+ * NFP_NET_CFG_CTRL_WORD1, upstream allocates both control words from bit 0
+ * upwards. They are left out of NFP_NET_CFG_CAP_WORD1 until a driver
+ * consumes them, a driver that knows about them sets the bit directly and
+ * any other bit in NIC_CFG_CTRL1_CAP fails the reconfig. */
+#ifndef NFP_NET_CFG_CTRL_WORD1
+#define NFP_NET_CFG_CTRL_WORD1    0x0098
+#endif
+
+/* Receive side coalescing of TCP flows to the host. An aggregate carries
+ * NIC_META_LRO, the MSS in the upper and the number of coalesced segments in
+ * the lower 16 bits, so the driver can hand it up as a GRO packet. The
+ * metadata type is unknown to upstream drivers, it is only prepended once the
+ * driver has set NIC_CFG_CTRL1_LRO. */
+#define NIC_CFG_CTRL1_LRO         (0x1 << 31)
+#define NIC_META_LRO              12
+
+/* UDP segmentation offload. USO requests use the LSO descriptor fields,
+ * the firmware tells them apart from TSO by the innermost L4 header. */
+#define NIC_CFG_CTRL1_USO         (0x1 << 30)
+
+/* Header length metadata. Packets to the host carry NIC_META_HDS, the
+ * length of the headers up to the end of the innermost TCP or UDP header.
+ * This is not a header-data split: NFD still DMAs the whole packet into one
+ * freelist buffer, which is why no NFP_NET_CFG_CTRL capability is claimed
+ * for it. */
+#define NIC_CFG_CTRL1_HDS         (0x1 << 29)
+#define NIC_META_HDS              13
+
+#define NIC_CFG_CTRL1_CAP         (NIC_CFG_CTRL1_LRO | NIC_CFG_CTRL1_USO | \
+                           NIC_CFG_CTRL1_HDS)
 
 #define NFD_CFG_RING_EMEM       emem0
 
@@ -242,10 +279,12 @@
 #define NFD_IN_ADD_SEQN
 #define NFD_IN_NUM_WQS          1
 
+/* Host TX is only ordered between queues sharing a sequencer, so use as
+ * many sequencers as there are GRO contexts for them, see config.h */
 #if (NS_PLATFORM_TYPE == NS_PLATFORM_CADMIUM_DDR_1x50)
 #define NFD_IN_NUM_SEQRS        2
 #else
-#define NFD_IN_NUM_SEQRS        8
+#define NFD_IN_NUM_SEQRS        16
 #endif
 #define NFD_IN_SEQR_QSHIFT      0
 
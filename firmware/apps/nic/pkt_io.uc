@@ -68,6 +68,26 @@ nfd_out_send_init()
 .reg_addr __pkt_io_quiescent 27 A
 .set __pkt_io_quiescent
 
+/* Receive priority between NBI and NFD when both have a packet ready, see
+ * PKT_IO_SCHED_NN_IDX. Bit 8 is set while NBI has priority, bits 7:0 count
+ * the packets the source with priority may still take before handing it to
+ * the other source.
+ */
+#define PKT_IO_SCHED_NBI_PRIO_shf   8
+.reg volatile __pkt_io_sched
+.reg_addr __pkt_io_sched 27 B
+.set __pkt_io_sched
+
+/* Delay before the NFD dispatch is retried after CTM buffer exhaustion, in
+ * TIMESTAMP_LOW ticks of 16 cycles. Doubled on every consecutive failure up
+ * to the cap and reset once a buffer is allocated.
+ */
+#define PKT_IO_CTM_BACKOFF_MIN      16
+#define PKT_IO_CTM_BACKOFF_MAX_SHF  10
+.reg volatile __pkt_io_ctm_backoff
+.reg_addr __pkt_io_ctm_backoff 31 B
+.set __pkt_io_ctm_backoff
+
 
 #macro pkt_io_drop(in_pkt_vec)
     pv_free($__pkt_io_gro_meta, pkt_vec)
@@ -282,31 +302,53 @@ end#:
 #endm
 
 
+/* Destinations of a TX_VLAN fan-out handled together, their queues are
+ * packed a byte each into one GPR. The credits of a batch are acquired in
+ * parallel, the buffer reference count is raised once for all members that
+ * have credits and their descriptors are enqueued back to back.
+ */
+#define PKT_IO_TX_VLAN_BATCH 4
+
 #macro pkt_io_tx_vlan(io_pkt_vec, IN_LABEL)
 .begin
     .reg addr_hi
     .reg addr_lo
+    .reg batch_cnt
+    .reg batch_qs
+    .reg drop_cnt
+    .reg drop_qs
     .reg map_base
     .reg meta_len
     .reg min_rxb
+    .reg nfd_desc[4]
     .reg pci_q
     .reg buf_sz
+    .reg ring_hi
+    .reg ring_lo
+    .reg send_cnt
+    .reg send_qs
+    .reg sig_mask
     .reg src_q
     .reg vlan_id
     .reg vlan_ports[2] // top six bits of vlan_ports[0] used to store base queue when processing flips to 2nd word
     .reg null_vlan_id
     .reg read $vf_rxb
-    .reg read $nfd_credits
-    .reg write $nfd_desc[4]
-    .xfer_order $nfd_desc
+    .reg read $nfd_credits[PKT_IO_TX_VLAN_BATCH]
     .reg read $vlan_ports[2]
     .xfer_order $vlan_ports
     .reg $mac[3]
     .xfer_order $mac
-    .sig sig_nfd
     .sig sig_rd
     .sig sig_wr
 
+    #define_eval SLOT 0
+    #while (SLOT < PKT_IO_TX_VLAN_BATCH)
+        .reg write $nfd_desc/**/SLOT[4]
+        .xfer_order $nfd_desc/**/SLOT
+        .sig sig_nfd/**/SLOT
+        #define_eval SLOT (SLOT + 1)
+    #endloop
+
     immed[map_base, (_vf_vlan_cache >> 16), <<(16 - 8)]
 
     bitfield_extract(vlan_id, BF_AML(io_pkt_vec, PV_VLAN_ID_bf))
@@ -343,9 +385,17 @@ strip_vlan#:
 
 null_vlan#:
     pv_meta_write(meta_len, io_pkt_vec, addr_hi, addr_lo)
-    pv_get_nfd_host_desc($nfd_desc, io_pkt_vec, meta_len)
+    pv_get_nfd_host_desc(nfd_desc, io_pkt_vec, meta_len)
     pv_get_required_host_buf_sz(buf_sz, io_pkt_vec, meta_len)
 
+    alu[ring_hi, *l$index0, AND, 0xff, <<24]
+    ld_field_w_clr[ring_lo, 0011, *l$index0]
+
+batch#:
+    // latest queue in the low byte
+    immed[batch_cnt, 0]
+    immed[batch_qs, 0]
+
 tx_vlan_loop#:
     alu[--, --, B, vlan_ports[1]]
     beq[check_done#]
@@ -361,23 +411,99 @@ tx_vlan_loop#:
     bmi[vf_buf_sz_check#]
 
 packet_fits#:
-    alu[addr_hi, --, B, (__NFD_DIRECT_ACCESS | NFD_PCIE_ISL_BASE), <<24]
-    alu[addr_lo, --, B, pci_q, <<(log2(NFD_OUT_ATOMICS_SZ))]
-    ov_single(OV_IMMED8, 1)
-    mem[test_subsat_imm, $nfd_credits, addr_hi, <<8, addr_lo, 1], indirect_ref, ctx_swap[sig_nfd]
+    alu[batch_qs, pci_q, OR, batch_qs, <<8]
+    alu[batch_cnt, batch_cnt, +, 1]
+    alu[--, batch_cnt, -, PKT_IO_TX_VLAN_BATCH]
+    blt[tx_vlan_loop#]
 
-    alu[--, --, B, $nfd_credits]
+send#:
+    alu[addr_hi, --, B, (__NFD_DIRECT_ACCESS | NFD_PCIE_ISL_BASE), <<24]
+    immed[sig_mask, 0]
+    #define_eval SLOT 0
+    #while (SLOT < PKT_IO_TX_VLAN_BATCH)
+        #if (SLOT > 0)
+            alu[--, batch_cnt, -, SLOT]
+            ble[credits_wait#]
+        #endif
+        alu[addr_lo, 0x3f, AND, batch_qs, >>(8 * SLOT)]
+        alu[addr_lo, --, B, addr_lo, <<(log2(NFD_OUT_ATOMICS_SZ))]
+        ov_single(OV_IMMED8, 1)
+        mem[test_subsat_imm, $nfd_credits[SLOT], addr_hi, <<8, addr_lo, 1], indirect_ref, sig_done[sig_nfd/**/SLOT]
+        alu[sig_mask, sig_mask, OR, mask(sig_nfd/**/SLOT), <<(&sig_nfd/**/SLOT)]
+        #define_eval SLOT (SLOT + 1)
+    #endloop
+
+credits_wait#:
+    ctx_arb[--], defer[2]
+        .io_completed sig_nfd0, sig_nfd1, sig_nfd2, sig_nfd3
+        immed[send_cnt, 0]
+        local_csr_wr[ACTIVE_CTX_WAKEUP_EVENTS, sig_mask]
+
+    immed[send_qs, 0]
+    immed[drop_cnt, 0]
+    immed[drop_qs, 0]
+    #define_eval SLOT 0
+    #while (SLOT < PKT_IO_TX_VLAN_BATCH)
+        #if (SLOT > 0)
+            alu[--, batch_cnt, -, SLOT]
+            ble[credits_done#]
+        #endif
+        alu[pci_q, 0x3f, AND, batch_qs, >>(8 * SLOT)]
+        alu[--, --, B, $nfd_credits[SLOT]]
+        beq[no_credits/**/SLOT#]
+        br[credits/**/SLOT#], defer[2]
+            alu[send_qs, pci_q, OR, send_qs, <<8]
+            alu[send_cnt, send_cnt, +, 1]
+no_credits/**/SLOT#:
+        alu[drop_qs, pci_q, OR, drop_qs, <<8]
+        alu[drop_cnt, drop_cnt, +, 1]
+credits/**/SLOT#:
+        #define_eval SLOT (SLOT + 1)
+    #endloop
+
+credits_done#:
+    alu[--, --, B, send_cnt]
     beq[no_tx_continue#]
 
-    pv_multicast_resend(io_pkt_vec)
-
-    pv_update_nfd_desc_queue($nfd_desc, io_pkt_vec, buf_sz, meta_len, pci_q)
+    // one reference for every descriptor, held before any is enqueued
+    pv_multicast_resend(io_pkt_vec, send_cnt)
+
+    immed[sig_mask, 0]
+    #define_eval SLOT 0
+    #while (SLOT < PKT_IO_TX_VLAN_BATCH)
+        #if (SLOT > 0)
+            alu[--, send_cnt, -, SLOT]
+            ble[desc_wait#]
+        #endif
+        alu[pci_q, 0x3f, AND, send_qs, >>(8 * SLOT)]
+        alu[$nfd_desc/**/SLOT[NFD_OUT_OFFSET_wrd], --, B, nfd_desc[NFD_OUT_OFFSET_wrd]]
+        alu[$nfd_desc/**/SLOT[NFD_OUT_BLS_wrd], --, B, nfd_desc[NFD_OUT_BLS_wrd]]
+        alu[$nfd_desc/**/SLOT[NFD_OUT_FLAGS_wrd], --, B, nfd_desc[NFD_OUT_FLAGS_wrd]]
+        pv_update_nfd_desc_queue($nfd_desc/**/SLOT, io_pkt_vec, buf_sz, meta_len, pci_q)
+        mem[qadd_work, $nfd_desc/**/SLOT[0], ring_hi, <<8, ring_lo, 4], sig_done[sig_nfd/**/SLOT]
+        alu[sig_mask, sig_mask, OR, mask(sig_nfd/**/SLOT), <<(&sig_nfd/**/SLOT)]
+        #define_eval SLOT (SLOT + 1)
+    #endloop
+    #undef SLOT
+
+desc_wait#:
+    ctx_arb[--], defer[1]
+        .io_completed sig_nfd0, sig_nfd1, sig_nfd2, sig_nfd3
+        local_csr_wr[ACTIVE_CTX_WAKEUP_EVENTS, sig_mask]
+
+tx_stats#:
+    alu[send_cnt, send_cnt, -, 1]
+    bmi[no_tx_continue#]
+    alu[pci_q, 0x3f, AND, send_qs]
+    alu[send_qs, --, B, send_qs, >>8]
+    pv_stats_tx_host(io_pkt_vec, 0, pci_q, --, tx_stats#, --)
 
-    alu[addr_hi, *l$index0, AND, 0xff, <<24]
-    ld_field_w_clr[addr_lo, 0011, *l$index0]
-    mem[qadd_work, $nfd_desc[0], addr_hi, <<8, addr_lo, 4], ctx_swap[sig_nfd]
-
-    pv_stats_tx_host(io_pkt_vec, 0, pci_q, --, tx_vlan_loop#, --)
+no_tx_continue#:
+    alu[drop_cnt, drop_cnt, -, 1]
+    bmi[batch#]
+    alu[pci_q, 0x3f, AND, drop_qs]
+    alu[drop_qs, --, B, drop_qs, >>8]
+    pv_stats_update(io_pkt_vec, RX_DISCARD_PCI, pci_q, no_tx_continue#)
 
 vf_buf_sz_check#:
     move(addr_hi, (_fl_buf_sz_cache >> 8))
@@ -388,13 +514,14 @@ vf_buf_sz_check#:
 
     pv_stats_update(io_pkt_vec, RX_DISCARD_MRU, pci_q, tx_vlan_loop#)
 
-no_tx_continue#:
-    pv_stats_update(io_pkt_vec, RX_DISCARD_PCI, pci_q, tx_vlan_loop#)
-
 pop_error#:
     pv_stats_update(io_pkt_vec, ERROR_PKT_STACK, IN_LABEL)
 
 check_done#:
+    // send what is left of the batch before moving on
+    alu[--, --, B, batch_cnt]
+    bne[send#]
+
     alu[vlan_ports[1], vlan_ports[0], AND~, 0x3f, <<26]
     bne[tx_vlan_loop#], defer[1]
         alu[vlan_ports[0], --, B, 32, <<26]
@@ -431,12 +558,31 @@ check_done#:
 
 #macro __pkt_io_no_ctm_buffer()
 .begin
+    .reg addr_hi
+    .reg addr_lo
     .reg future
+
     local_csr_wr[ACTIVE_FUTURE_COUNT_SIGNAL, &__pkt_io_sig_nfd_retry]
     local_csr_rd[TIMESTAMP_LOW]
     immed[future, 0]
-    alu[future, future, +, 250] // 4000 cycles
+    alu[future, future, +, __pkt_io_ctm_backoff]
     local_csr_wr[ACTIVE_CTX_FUTURE_COUNT, future]
+
+    // count the failure and the ticks until the retry for this island
+    move(addr_hi, (_nic_stats_ctm >> 8))
+    immed[addr_lo, (__ISLAND * NIC_STATS_CTM_SIZE)]
+    mem[incr64, --, addr_hi, <<8, addr_lo]
+    alu[addr_lo, addr_lo, +, NIC_STATS_CTM_WAIT_TICKS]
+    passert((1 << PKT_IO_CTM_BACKOFF_MAX_SHF), "LT", (1 << 16))
+    ov_start(OV_IMMED16)
+    ov_set_use(OV_IMMED16, __pkt_io_ctm_backoff)
+    ov_clean()
+    mem[add64_imm, --, addr_hi, <<8, addr_lo, 0], indirect_ref
+
+    br_bset[__pkt_io_ctm_backoff, PKT_IO_CTM_BACKOFF_MAX_SHF, end#]
+    alu[__pkt_io_ctm_backoff, --, B, __pkt_io_ctm_backoff, <<1]
+
+end#:
 .end
 #endm
 
@@ -444,12 +590,15 @@ check_done#:
 #macro __pkt_io_dispatch_nfd()
     pkt_buf_alloc_ctm(__pkt_io_nfd_pkt_no, PKT_BUF_ALLOC_CTM_SZ_256B, skip_dispatch#, __pkt_io_no_ctm_buffer)
     nfd_in_recv($__pkt_io_nfd_desc, 0, 0, 0, __pkt_io_sig_nfd, SIG_DONE)
+    immed[__pkt_io_ctm_backoff, PKT_IO_CTM_BACKOFF_MIN]
 skip_dispatch#:
 #endm
 
 
 #macro pkt_io_init(out_pkt_vec)
     immed[__pkt_io_quiescent, 0]
+    immed[__pkt_io_sched, (1 << PKT_IO_SCHED_NBI_PRIO_shf)]
+    immed[__pkt_io_ctm_backoff, PKT_IO_CTM_BACKOFF_MIN]
     alu[BF_A(out_pkt_vec, PV_QUEUE_IN_TYPE_bf), --, B, 0, <<BF_L(PV_QUEUE_IN_TYPE_bf)]
     __pkt_io_dispatch_nbi()
 #endm
@@ -467,6 +616,43 @@ consume_quiesce_sig#:
 #endm
 
 
+/** __pkt_io_sched_account
+ *
+ * Charge a received packet to the weighted round robin between NBI and NFD.
+ * Packets taken while the other source had priority are free. Once the
+ * source with priority has used up its weight the other source gets
+ * priority, with its weight reloaded from PKT_IO_SCHED_NN_IDX.
+ *
+ * @param in_source  NBI or NFD
+ */
+#macro __pkt_io_sched_account(in_source)
+.begin
+    .reg credit
+
+    #if (streq('in_source', 'NBI'))
+        br_bclr[__pkt_io_sched, PKT_IO_SCHED_NBI_PRIO_shf, end#]
+    #else
+        br_bset[__pkt_io_sched, PKT_IO_SCHED_NBI_PRIO_shf, end#]
+    #endif
+    local_csr_wr[NN_GET, PKT_IO_SCHED_NN_IDX]
+    alu[credit, 0xff, AND, __pkt_io_sched]
+    alu[credit, credit, -, 1]
+    bgt[end#], defer[1]
+        alu[__pkt_io_sched, __pkt_io_sched, -, 1]
+
+    #if (streq('in_source', 'NBI'))
+        passert(PKT_IO_SCHED_NFD_WEIGHT_shf, "EQ", 0)
+        alu[__pkt_io_sched, 0xff, AND, *n$index]
+    #else
+        alu[__pkt_io_sched, 0xff, AND, *n$index, >>PKT_IO_SCHED_NBI_WEIGHT_shf]
+        alu[__pkt_io_sched, __pkt_io_sched, OR, 1, <<PKT_IO_SCHED_NBI_PRIO_shf]
+    #endif
+
+end#:
+.end
+#endm
+
+
 #macro pkt_io_rx(out_act_addr, io_vec)
     br_bclr[BF_AL(io_vec, PV_QUEUE_IN_TYPE_bf), nfd_dispatch#] // previous packet was NFD, dispatch another
 
@@ -474,15 +660,17 @@ nbi_dispatch#:
     br_signal[__pkt_io_sig_quiesce_nbi, quiesce_nbi#]
     __pkt_io_dispatch_nbi()
 
-wait_nfd_priority#:
+wait#:
     ctx_arb[__pkt_io_sig_epoch, __pkt_io_sig_nbi, __pkt_io_sig_nfd, __pkt_io_sig_nfd_retry], any
     br_signal[__pkt_io_sig_nfd_retry, nfd_dispatch#]
-    br_signal[__pkt_io_sig_epoch, wait_nfd_priority#]
+    br_signal[__pkt_io_sig_epoch, wait#]
+    br_bset[__pkt_io_sched, PKT_IO_SCHED_NBI_PRIO_shf, clear_sig_rx_nbi#]
 
 clear_sig_rx_nfd#:
     br_!signal[__pkt_io_sig_nfd, clear_sig_rx_nbi#] // __pkt_io_sig_nbi is asserted
 
 rx_nfd#:
+    __pkt_io_sched_account(NFD)
     br[end#], defer[2]
         passert(NIC_CFG_INSTR_TBL_ADDR, "EQ", 0)
         alu[out_act_addr, 0xff, AND, BF_A($__pkt_io_nfd_desc, NFD_IN_QID_fld)]
@@ -501,16 +689,13 @@ quiescence#:
 nfd_dispatch#:
     br_signal[__pkt_io_sig_quiesce_nfd, quiesce_nfd#]
     __pkt_io_dispatch_nfd()
-
-wait_nbi_priority#:
-    ctx_arb[__pkt_io_sig_epoch, __pkt_io_sig_nbi, __pkt_io_sig_nfd, __pkt_io_sig_nfd_retry], any
-    br_signal[__pkt_io_sig_nfd_retry, nfd_dispatch#]
-    br_signal[__pkt_io_sig_epoch, wait_nbi_priority#]
+    br[wait#]
 
 clear_sig_rx_nbi#:
     br_!signal[__pkt_io_sig_nbi, clear_sig_rx_nfd#] // __pkt_io_sig_nfd is asserted
 
 rx_nbi#:
+    __pkt_io_sched_account(NBI)
     passert(NIC_CFG_INSTR_TBL_ADDR, "EQ", 0)
     dbl_shf[out_act_addr, 1, BF_A($__pkt_io_nbi_desc, CAT_PORT_bf), >>BF_L(CAT_PORT_bf)] ; CAT_PORT_bf
     alu[out_act_addr, --, B, out_act_addr, <<(log2(NIC_MAX_INSTR * 4))]
@@ -168,6 +168,7 @@
 
 #define VXLAN_SIZE                   8
 #define NVGRE_SIZE                   4
+#define NET_ETH_TYPE_TEB             0x6558 // GRE Transparent Ethernet Bridging
 #define GENEVE_SIZE                  8
 #define NET_GENEVE_PORT              0x17C1
 
@@ -27,6 +27,7 @@
 #include "pkt_buf.uc"
 
 #include "protocols.h"
+#include "pv_parse_gen.uc"
 #include "app_config_instr.h"
 
 #define BF_MASK(w, m, l) ((1 << (m + 1 - l)) - 1)
@@ -292,6 +293,14 @@ passert(PV_MAX_CLONES, "EQ", 2)
 
 #if (defined(NFD_PCIE1_EMEM) || defined(NFD_PCIE2_EMEM) || defined(NFD_PCIE3_EMEM))
     #define PV_MULTI_PCI
+    #define PV_GRO_NFD_CTXS             (NFD_IN_NUM_SEQRS * 4)
+#else
+    #define PV_GRO_NFD_CTXS             NFD_IN_NUM_SEQRS
+#endif
+
+// PV_SEQ_CTX_bf holds GRO contexts 0..31
+#if ((PV_GRO_NFD_START + PV_GRO_NFD_CTXS) > 32)
+    #error "NFD sequencers do not fit in PV_SEQ_CTX_bf"
 #endif
 
 
@@ -536,19 +545,24 @@ end#:
 #endm
 
 
-#macro pv_multicast_resend(io_vec)
+#macro pv_multicast_resend(io_vec, in_count)
 .begin
     .reg mu_addr
     .reg read $dummy
     .sig sig_sync
 
     alu[mu_addr, --, B, BF_A(io_vec, PV_MU_ADDR_bf), <<(31 - BF_M(PV_MU_ADDR_bf))] ; PV_MU_ADDR_bf
-    ov_single(OV_IMMED8, 1)
+    ov_single(OV_IMMED8, in_count)
     mem[test_add_imm, $dummy, mu_addr, <<8, 0, 1], indirect_ref, ctx_swap[sig_sync]
 .end
 #endm
 
 
+#macro pv_multicast_resend(io_vec)
+    pv_multicast_resend(io_vec, 1)
+#endm
+
+
 #macro pv_stats_tx_host(io_vec, in_pci_isl, in_pci_q, in_continue, IN_TERM_LABEL, IN_CONT_LABEL)
 .begin
     .reg addr
@@ -1296,6 +1310,7 @@ end#:
     .reg l4_offset
     .reg mac_dst_type
     .reg parse_args
+    .reg proto_mask
     .reg seq_ctx
     .reg shift
     .reg tunnel
@@ -1383,6 +1398,18 @@ ipv4_frag#:
     br[finalize_l3#], defer[1]
         ld_field[BF_A(out_vec, PV_PROTO_bf), 0001, PROTO_IPV4_FRAGMENT]
 
+check_ipv6#:
+    // perform parse unless IPv6 without extension headers (or fragment header)
+    br!=byte[l3_type, 0, 5, hdr_parse#]
+    alu[--, BF_MASK(MAC_PARSE_V6_OPT_bf), AND, BF_A(in_nbi_desc, MAC_PARSE_V6_OPT_bf), >>BF_L(MAC_PARSE_V6_OPT_bf)] ; MAC_PARSE_V6_OPT_bf
+    bne[hdr_parse#]
+    br_bset[BF_AL(in_nbi_desc, CAT_SPECIAL_bf), hdr_parse#] ; CAT_SPECIAL_bf
+
+    br[classify_l4#], defer[3]
+        bitfield_extract__sz1(l3_offset, BF_AML(in_nbi_desc, CAT_L3_OFFSET_bf)) ; CAT_L3_OFFSET_bf
+        alu[l3_offset, l3_offset, -, MAC_PREPEND_BYTES]
+        alu[BF_A(out_vec, PV_HEADER_STACK_bf), --, B, l3_offset, <<BF_L(PV_HEADER_OFFSET_INNER_IP_bf)]
+
 read_pkt#:
     __pv_get_mac_dst_type(mac_dst_type, out_vec) // advances *$index by 2 words
     alu[vlan_len, (3 << 2), AND, BF_A(in_nbi_desc, MAC_PARSE_VLAN_bf), >>(BF_L(MAC_PARSE_VLAN_bf) - 2)]
@@ -1396,7 +1423,7 @@ read_pkt#:
 
 skip_vlan#:
     bitfield_extract__sz1(l3_type, BF_AML(in_nbi_desc, CAT_L3_CLASS_bf)) ; CAT_L3_CLASS_bf
-    br!=byte[l3_type, 0, 4, hdr_parse#], defer[2] // if packet is not IPv4 perform parse
+    br!=byte[l3_type, 0, 4, check_ipv6#], defer[2] // if packet is not IPv4 try IPv6
         bits_set__sz1(BF_AL(out_vec, PV_VLAN_ID_bf), vlan_id) ; PV_VLAN_ID_bf
         passert(BF_L(PV_SEQ_CTX_bf), "EQ", 8)
         ld_field[BF_A(out_vec, PV_SEQ_CTX_bf), 0010, seq_ctx, <<BF_L(PV_SEQ_CTX_bf)]
@@ -1407,10 +1434,11 @@ skip_vlan#:
         alu[l3_offset, l3_offset, -, MAC_PREPEND_BYTES]
         alu[BF_A(out_vec, PV_HEADER_STACK_bf), --, B, l3_offset, <<BF_L(PV_HEADER_OFFSET_INNER_IP_bf)]
 
-    // packet is IPv4, deep parse if NVGRE is configured
+classify_l4#:
+    // packet is IP, deep parse if NVGRE is configured
     br_bset[in_rx_args, BF_L(INSTR_RX_PARSE_NVGRE_bf), hdr_parse#]
 
-    // packet is IPv4, deep parse if not TCP or UDP
+    // packet is IP, deep parse if not TCP or UDP
     alu[l4_type, 0xe, AND, BF_A(in_nbi_desc, CAT_L4_CLASS_bf), >>BF_L(CAT_L4_CLASS_bf)] ; CAT_L4_CLASS_bf
     br!=byte[l4_type, 0, 2, hdr_parse#]
 
@@ -1420,8 +1448,9 @@ skip_vlan#:
     alu[tunnel, tunnel, AND~, BF_A(in_nbi_desc, CAT_L4_CLASS_bf)]
     br_bset[tunnel, BF_L(CAT_L4_CLASS_bf), hdr_parse#] ; CAT_L4_CLASS_bf
 
-    // set PV_PROTO_bf to IPv4 according to L4 protocol
-    alu[BF_A(out_vec, PV_PROTO_bf), BF_A(out_vec, PV_PROTO_bf), AND~, 0xfc] ; PV_PROTO_bf
+    // set PV_PROTO_bf according to L3 (l3_type is 4 or 5) and L4 protocol
+    alu[proto_mask, 0xfc, OR, l3_type, <<1] // 0xfe for IPv6
+    alu[BF_A(out_vec, PV_PROTO_bf), BF_A(out_vec, PV_PROTO_bf), AND~, proto_mask] ; PV_PROTO_bf
     alu[l4_tcp, 1, AND, BF_A(in_nbi_desc, CAT_L4_CLASS_bf), >>BF_L(CAT_L4_CLASS_bf)] ; CAT_L4_CLASS_bf
     alu[BF_A(out_vec, PV_PROTO_bf), BF_A(out_vec, PV_PROTO_bf), AND~, l4_tcp] ; PV_PROTO_bf
 
@@ -1457,6 +1486,9 @@ end#:
     .reg write $udp_len
     .sig sig_write_udp_len
 
+    .reg read $uso_en
+    .sig sig_read_uso_en
+
     .reg addr_hi
     .reg addr_lo
     .reg encap
@@ -1468,6 +1500,7 @@ end#:
     .reg l4_offset
     .reg lso_seq
     .reg mss
+    .reg qid
     .reg shift
     .reg sig_mask
     .reg tcp_seq_add
@@ -1478,11 +1511,6 @@ end#:
     bitfield_extract__sz1(l3_offset, BF_AML(io_vec, PV_HEADER_OFFSET_OUTER_IP_bf))
     beq[lso_error#]
 
-    bitfield_extract__sz1(l4_offset, BF_AML(io_vec, PV_HEADER_OFFSET_OUTER_L4_bf))
-    beq[lso_error#]
-
-    br_bset[BF_AL(io_vec, PV_PROTO_UDP_bf), lso_error#]
-
     alu[addr_hi, --, B, BF_A(io_vec, PV_MU_ADDR_bf), <<(31 - BF_M(PV_MU_ADDR_bf))]
 
     bitfield_extract(mss, BF_AML(in_nfd_desc, NFD_IN_LSO_MSS_fld))
@@ -1490,12 +1518,19 @@ end#:
     bitfield_extract__sz1(lso_seq, BF_AML(in_nfd_desc, NFD_IN_LSO_SEQ_CNT_fld))
     alu[lso_seq, lso_seq, -, 1]
 
+    // GRE tunnels have no outer L4 offset
+    bitfield_extract__sz1(l4_offset, BF_AML(io_vec, PV_HEADER_OFFSET_OUTER_L4_bf))
+    beq[gre_encap#]
+
     br_bset[BF_AL(in_nfd_desc, NFD_IN_FLAGS_TX_ENCAP_fld), udp_encap#], defer[3]
 lso_begin#:
         immed[sig_mask, 0]
         alu[l3_addr, l3_offset, +16, BF_A(io_vec, PV_OFFSET_bf)]
         alu[l4_addr, l4_offset, +16, BF_A(io_vec, PV_OFFSET_bf)]
 
+    // innermost L4 is UDP: segmentation offload of UDP datagrams (USO)
+    br_bset[BF_AL(io_vec, PV_PROTO_UDP_bf), uso#]
+
     mem[read32, $tcp_hdr[0], addr_hi, <<8, l4_addr, 4], ctx_swap[sig_read_tcp], defer[2]
         alu[sig_mask, sig_mask, OR, mask(sig_write_tcp_seq), <<(&sig_write_tcp_seq)]
         alu[sig_mask, sig_mask, OR, mask(sig_write_tcp_flags), <<(&sig_write_tcp_flags)]
@@ -1523,6 +1558,7 @@ lso_begin#:
     alu[addr_lo, l4_addr, +, TCP_FLAGS_OFFS]
     mem[write8, $tcp_flags, addr_hi, <<8, addr_lo, 2], sig_done[sig_write_tcp_flags]
 
+ip_fixup#:
     br_bclr[BF_AL(io_vec, PV_PROTO_IPV4_bf), ipv6#], defer[3]
         /* IP length = pkt_len - l3_off */
         alu[ip_len, BF_A(io_vec, PV_LENGTH_bf), -, l3_offset]
@@ -1569,6 +1605,102 @@ repeat#:
         alu[sig_mask, sig_mask, OR, mask(sig_write_ip), <<(&sig_write_ip)]
         local_csr_wr[ACTIVE_CTX_WAKEUP_EVENTS, sig_mask]
 
+gre_encap#:
+    br_bclr[BF_AL(in_nfd_desc, NFD_IN_FLAGS_TX_ENCAP_fld), lso_error#], defer[2]
+        alu[tmp, (PROTO_GRE | PROTO_UDP << PROTO_ENCAP_SHF), AND, BF_A(io_vec, PV_PROTO_bf)]
+        alu[l3_addr, l3_offset, +16, BF_A(io_vec, PV_OFFSET_bf)]
+    alu[--, tmp, -, PROTO_GRE]
+    bne[lso_error#]
+
+    /* the GRE header follows the outer IP header */
+    br_bclr[BF_A(io_vec, PV_PROTO_IPV4_bf), (BF_L(PV_PROTO_IPV4_bf) + PROTO_ENCAP_SHF), gre_ipv6#]
+    mem[read8, $tcp_hdr[0], addr_hi, <<8, l3_addr, 1], ctx_swap[sig_read_tcp]
+    alu[l4_offset, (0xf << 2), AND, $tcp_hdr[0], >>(24 - 2)] // IHL * 4
+    br[gre#], defer[1]
+        alu[l4_offset, l4_offset, +, l3_offset]
+
+gre_ipv6#:
+    // extension headers between IPv6 and GRE are not supported
+    alu[addr_lo, l3_addr, +, 4]
+    mem[read8, $tcp_hdr[0], addr_hi, <<8, addr_lo, 4], ctx_swap[sig_read_tcp]
+    br!=byte[$tcp_hdr[0], 1, NET_IP_PROTO_GRE, lso_error#], defer[1]
+        alu[l4_offset, l3_offset, +, IPV6_HDR_SIZE]
+
+gre#:
+    /* The GRE checksum covers the payload and cannot be patched per
+     * segment, neither can source routes be. An optional sequence number
+     * follows the key and advances by one per segment.
+     */
+    alu[l4_addr, l4_offset, +16, BF_A(io_vec, PV_OFFSET_bf)]
+    mem[read8, $tcp_hdr[0], addr_hi, <<8, l4_addr, 12], ctx_swap[sig_read_tcp], defer[1]
+        immed[sig_mask, 0]
+    br_bset[$tcp_hdr[0], 31, lso_error#] // C
+    br_bset[$tcp_hdr[0], 30, lso_error#] // R
+    br_bclr[$tcp_hdr[0], 28, gre_outer_ip#] // S
+
+    br_bclr[$tcp_hdr[0], 29, gre_seq#], defer[2] // K
+        alu[addr_lo, l4_addr, +, 4]
+        alu[tmp, $tcp_hdr[1], +, lso_seq]
+    alu[addr_lo, addr_lo, +, 4]
+    alu[tmp, $tcp_hdr[2], +, lso_seq]
+
+gre_seq#:
+    // reuse the TCP sequence write, the inner pass starts after it completed
+    alu[$tcp_seq, --, B, tmp]
+    mem[write8, $tcp_seq, addr_hi, <<8, addr_lo, 4], sig_done[sig_write_tcp_seq]
+    alu[sig_mask, sig_mask, OR, mask(sig_write_tcp_seq), <<(&sig_write_tcp_seq)]
+
+gre_outer_ip#:
+    br_bset[BF_A(io_vec, PV_PROTO_IPV4_bf), (BF_L(PV_PROTO_IPV4_bf) + PROTO_ENCAP_SHF), ipv4#], defer[3]
+        alu[ip_len, BF_A(io_vec, PV_LENGTH_bf), -, l3_offset]
+        alu[ip_len, ip_len, AND~, BF_MASK(PV_BLS_bf), <<BF_L(PV_BLS_bf)]
+        alu[ip_len, --, B, ip_len, <<16]
+    br[ipv6#]
+
+uso#:
+    /* Only queues of vNICs with NIC_CFG_CTRL1_USO enabled accept USO, the
+     * bit of queue q is bit q % 32 of NIC_USO_QUEUE_TBL word q / 32, see
+     * cfg_act_write_uso().
+     */
+    passert(BF_L(NFD_IN_QID_fld), "EQ", 0)
+    alu[qid, 0xff, AND, BF_A(in_nfd_desc, NFD_IN_QID_fld)]
+    alu[addr_lo, --, B, qid, >>5]
+    alu[addr_lo, --, B, addr_lo, <<2]
+    immed[tmp, NIC_USO_QUEUE_TBL_ADDR]
+    cls[read, $uso_en, tmp, addr_lo, 1], ctx_swap[sig_read_uso_en]
+    alu[--, qid, OR, 0]
+    alu[--, $uso_en, AND, 1, <<indirect]
+    beq[lso_error#]
+
+    /* UDP length = pkt_len - l4_off
+     *
+     * The host checksum is stale for every segment. It is left to the L4
+     * checksum offload requested in the descriptor. Without one it is
+     * cleared for IPv4, a receiver then skips verification. IPv6 does not
+     * allow a zero checksum, the MAC is told to compute it instead, which
+     * only covers the outermost L4 header so tunnelled IPv6 is rejected.
+     */
+    alu[udp_len, BF_A(io_vec, PV_LENGTH_bf), -, l4_offset]
+    alu[udp_len, udp_len, AND~, BF_MASK(PV_BLS_bf), <<BF_L(PV_BLS_bf)]
+    alu[$udp_len, --, B, udp_len, <<16]
+    alu[addr_lo, l4_addr, +, UDP_LEN_OFFS]
+    alu[tmp, BF_A(io_vec, PV_CSUM_OFFLOAD_bf), AND, ((1 << BF_L(PV_CSUM_OFFLOAD_IL4_bf)) | (1 << BF_L(PV_CSUM_OFFLOAD_OL4_bf)))]
+    bne[uso_csum_offload#]
+    br_bset[BF_AL(io_vec, PV_PROTO_IPV4_bf), uso_csum_clear#]
+    bitfield_extract__sz1(tmp, BF_AML(io_vec, PV_HEADER_OFFSET_OUTER_L4_bf))
+    alu[--, tmp, -, l4_offset]
+    bne[lso_error#]
+    br[uso_csum_offload#], defer[1]
+        alu[BF_A(io_vec, PV_CSUM_OFFLOAD_bf), BF_A(io_vec, PV_CSUM_OFFLOAD_bf), OR, 1, <<BF_L(PV_CSUM_OFFLOAD_OL4_bf)]
+uso_csum_clear#:
+    mem[write8, $udp_len, addr_hi, <<8, addr_lo, 4], sig_done[sig_write_udp_len]
+    br[ip_fixup#], defer[1]
+        alu[sig_mask, sig_mask, OR, mask(sig_write_udp_len), <<(&sig_write_udp_len)]
+uso_csum_offload#:
+    mem[write8, $udp_len, addr_hi, <<8, addr_lo, 2], sig_done[sig_write_udp_len]
+    br[ip_fixup#], defer[1]
+        alu[sig_mask, sig_mask, OR, mask(sig_write_udp_len), <<(&sig_write_udp_len)]
+
 udp_encap#:
     alu[udp_len, BF_A(io_vec, PV_LENGTH_bf), -, l4_offset]
     alu[udp_len, udp_len, AND~, BF_MASK(PV_BLS_bf), <<BF_L(PV_BLS_bf)]
@@ -1737,7 +1869,10 @@ hdr_parse#:
         alu[BF_A(out_vec, PV_META_TYPES_bf), *$index++, B, 0]
         alu[BF_A(out_vec, PV_HEADER_STACK_bf), --, B, 0]
 
+    // ENCAP covers UDP tunnels and GRE, parse both when the host sets it
+    passert(BF_L(INSTR_RX_HOST_ENCAP_bf), "EQ", 0)
     bitfield_extract__sz1(encap, BF_AML(in_nfd_desc, NFD_IN_FLAGS_TX_ENCAP_fld))
+    alu[encap, encap, OR, encap, <<BF_L(INSTR_RX_PARSE_NVGRE_bf)]
     pv_hdr_parse(out_vec, encap)
 
     br_bset[BF_AL(in_nfd_desc, NFD_IN_FLAGS_TX_LSO_fld), lso_fixup#]
@@ -2079,11 +2214,11 @@ check_eth_type#:
     byte_align_be[tmp, *$index++]
     alu[eth_type, --, B, tmp, >>16]
 
-check_ipv6#:
-    immed[proto_test, NET_ETH_TYPE_IPV6]
-    alu[--, eth_type, -, proto_test]
-    bne[check_ipv4#]
+dispatch_eth_type#:
+    // EtherType dispatch generated from pv_parse.def
+    pv_parse_gen_eth_type(eth_type, proto_test, unknown_proto#)
 
+#if PV_PARSE_IPV6
 parse_ipv6#:
     ld_field[BF_A(pkt_vec, PV_HEADER_STACK_bf), 0010, pkt_offset, <<8] // IP Offset
     byte_align_be[--, *$index++]
@@ -2103,11 +2238,15 @@ check_ipv6_tcp#:
 check_ipv6_other#:
     br=byte[next_hdr, 3, NET_IP_PROTO_FRAG, ipv6_frag#]
 
+#if PV_PARSE_GRE
     br=byte[next_hdr, 3, NET_IP_PROTO_GRE, gre#]
+#endif
 
+#if PV_PARSE_IPV6_EXT
     br=byte[next_hdr, 3, NET_IP_PROTO_HOPOPT, skip_ipv6_ext#]
     br=byte[next_hdr, 3, NET_IP_PROTO_DSTOPTS, skip_ipv6_ext#]
     br=byte[next_hdr, 3, NET_IP_PROTO_ROUTING, skip_ipv6_ext#]
+#endif
 
     br[done_hdr_stack#], defer[2]
         alu[BF_A(pkt_vec, PV_PROTO_bf), BF_A(pkt_vec, PV_PROTO_bf), OR, PROTO_IPV6_UNKNOWN] // L4 Unknown
@@ -2118,6 +2257,7 @@ ipv6_frag#:
         alu[BF_A(pkt_vec, PV_PROTO_bf), BF_A(pkt_vec, PV_PROTO_bf), OR, PROTO_IPV6_FRAGMENT] // IPv6 Frag
         alu[hdr_stack, --, B, BF_A(pkt_vec, PV_HEADER_STACK_bf)]
 
+#if PV_PARSE_IPV6_EXT
 skip_ipv6_ext#:
     pv_seek(pkt_vec, pkt_offset)
 
@@ -2128,11 +2268,8 @@ skip_ipv6_ext#:
         /* hdr length = "Hdr Ext Len" * 8 + 8 */
         alu[hdr_len, --, B, hdr_len, <<3]
         alu[hdr_len, hdr_len, +, 8]
-
-check_ipv4#:
-    immed[proto_test, NET_ETH_TYPE_IPV4]
-    alu[--, eth_type, -, proto_test]
-    bne[check_vlan#]
+#endif // PV_PARSE_IPV6_EXT
+#endif // PV_PARSE_IPV6
 
 parse_ipv4#:
     ld_field[BF_A(pkt_vec, PV_HEADER_STACK_bf), 0010, pkt_offset, <<8] // IP Offset
@@ -2165,10 +2302,11 @@ parse_ipv4_udp#:
 check_tunnel#:
     pv_seek(pkt_vec, pkt_offset, PV_SEEK_T_INDEX_ONLY)
 
-    br_bset[__pv_hdr_parse_args, BF_L(INSTR_RX_HOST_ENCAP_bf), skip_vxlan#], defer[1]
+    br_bset[__pv_hdr_parse_args, BF_L(INSTR_RX_HOST_ENCAP_bf), host_encap#], defer[1]
         // don't need byte_align_be[] after seek because check_tunnel# is only done for outer header
         alu[udp_dst_port, 0, +16, *$index++]
 
+#if PV_PARSE_VXLAN
     bitfield_extract__sz1[vxlan_idx, __pv_hdr_parse_args, BF_ML(INSTR_RX_VXLAN_NN_IDX_bf)) ; INSTR_RX_VXLAN_NN_IDX_bf
     local_csr_wr[NN_GET, vxlan_idx]
     bitfield_extract__sz1(n_vxlan, __pv_hdr_parse_args, BF_ML(INSTR_RX_PARSE_VXLANS_bf)) ; INSTR_RX_PARSE_VXLANS_bf
@@ -2179,6 +2317,9 @@ check_nn_vxlan#:
 
     alu[--, udp_dst_port, -, *n$index++]
     bne[check_nn_vxlan#]
+#else
+    br[check_geneve_tun#]
+#endif
 
 skip_vxlan#:
     alu[pkt_offset, pkt_offset, +, (UDP_HDR_SIZE + VXLAN_SIZE + ETHERNET_SIZE)]
@@ -2191,12 +2332,23 @@ seek_inner#:
 seek_eth_type#:
     pv_seek(pkt_vec, pkt_offset, PV_SEEK_PAD_INCLUDED, check_eth_type#)
 
+host_encap#:
+    // UDP tunnel flagged by the host: GENEVE on its IANA port, else VXLAN
+#if PV_PARSE_GENEVE
+    immed[proto_test, NET_GENEVE_PORT]
+    alu[--, udp_dst_port, -, proto_test]
+    beq[geneve#]
+#endif
+    br[skip_vxlan#]
+
 check_geneve_tun#:
+#if PV_PARSE_GENEVE
     br_bclr[__pv_hdr_parse_args, BF_L(INSTR_RX_PARSE_GENEVE_bf), done#]
     immed[proto_test, NET_GENEVE_PORT]
     alu[--, udp_dst_port, -, proto_test]
     bne[done#]
 
+geneve#:
     alu[BF_A(pkt_vec, PV_PROTO_bf), BF_A(pkt_vec, PV_PROTO_bf), OR, (PROTO_GENEVE >> PROTO_ENCAP_SHF)]
 
     alu[--, --, B, *$index++] // skip over UDP Length:Checksum
@@ -2205,8 +2357,12 @@ check_geneve_tun#:
     br[seek_inner#], defer[2]
         alu[pkt_offset, pkt_offset, +, hdr_len]
         alu[pkt_offset, pkt_offset, +, (UDP_HDR_SIZE + GENEVE_SIZE + ETHERNET_SIZE)]
+#else
+    br[done#]
+#endif
 
 check_ipv4_gre#:
+#if PV_PARSE_GRE
     br!=byte[next_hdr, 0, NET_IP_PROTO_GRE, unknown_l4#]
 
 gre#:
@@ -2221,9 +2377,26 @@ gre#:
     pop_count2[tmp]
     pop_count3[tmp, tmp]
     alu[tmp, --, B, tmp, <<2]
-    br[seek_inner#], defer[2]
-        alu[pkt_offset, pkt_offset, +, tmp]
-        alu[pkt_offset, pkt_offset, +, (NVGRE_SIZE + ETHERNET_SIZE)]
+    alu[pkt_offset, pkt_offset, +, tmp]
+    alu[eth_type, 0, +16, *$index] // GRE Protocol Type
+    immed[proto_test, NET_ETH_TYPE_TEB]
+    alu[--, eth_type, -, proto_test]
+    beq[seek_inner#], defer[2]
+        alu[pkt_offset, pkt_offset, +, NVGRE_SIZE]
+        alu[pkt_offset, pkt_offset, +, ETHERNET_SIZE]
+
+    // GRE carrying IP, the Protocol Type takes the place of the EtherType
+    alu[pkt_offset, pkt_offset, -, ETHERNET_SIZE]
+    alu[tmp, 0xff, AND, BF_A(pkt_vec, PV_PROTO_bf)]
+    ld_field[BF_A(pkt_vec, PV_PROTO_bf), 0001, tmp, <<PROTO_ENCAP_SHF]
+    alu[BF_A(pkt_vec, PV_HEADER_STACK_bf), --, B, BF_A(pkt_vec, PV_HEADER_STACK_bf), <<16]
+    pv_seek(pkt_vec, pkt_offset, PV_SEEK_PAD_INCLUDED, gre_ip#)
+
+gre_ip#:
+    byte_align_be[--, *$index++]
+    byte_align_be[tmp, *$index++]
+    br[dispatch_eth_type#]
+#endif
 
 unknown_l4#:
     br[done_hdr_stack#], defer[2]
@@ -2240,22 +2413,14 @@ ipv4_frag#:
         alu[BF_A(pkt_vec, PV_PROTO_bf), BF_A(pkt_vec, PV_PROTO_bf), OR, PROTO_FRAG] // IPv4 Frag
         alu[hdr_stack, --, B, BF_A(pkt_vec, PV_HEADER_STACK_bf)]
 
-check_vlan#:
-    immed[proto_test, NET_ETH_TYPE_TPID]
-    alu[--, eth_type, -, proto_test]
-    beq[vlan_tag#]
-    immed[proto_test, NET_ETH_TYPE_SVLAN]
-    alu[--, eth_type, -, proto_test]
-    bne[check_mpls#]
-
-vlan_tag#:
+#if PV_PARSE_VLAN
+parse_vlan#:
     br[seek_eth_type#], defer[1]
         alu[pkt_offset, pkt_offset, +, (ETH_TYPE_SIZE + ETH_VLAN_SIZE)]
+#endif
 
-check_mpls#:
-    immed[proto_test, NET_ETH_TYPE_MPLS]
-    alu[--, eth_type, -, proto_test]
-    bne[unknown_proto#]
+#if PV_PARSE_MPLS
+parse_mpls#:
     alu[BF_A(pkt_vec, PV_PROTO_bf), BF_A(pkt_vec, PV_PROTO_bf), OR, PROTO_MPLS] // MPLS
 
 mpls_loop#:
@@ -2271,14 +2436,19 @@ mpls_loop#:
     alu[label, label, OR, tmp, >>16]
     alu[label, --, B, label, >>12]
     beq[parse_ipv4#]
+#if PV_PARSE_IPV6
     alu[--, label, -, 2]
     beq[parse_ipv6#]
+#endif
     br[done#]
+#endif // PV_PARSE_MPLS
 
+#if PV_PARSE_IPV6
 parse_ipv6_udp#:
     br=byte[BF_A(pkt_vec, PV_HEADER_STACK_bf), 3, 0, check_tunnel#], defer[2]
         ld_field[BF_A(pkt_vec, PV_HEADER_STACK_bf), 0001, pkt_offset] // L4 Offset
         alu[BF_A(pkt_vec, PV_PROTO_bf), BF_A(pkt_vec, PV_PROTO_bf), OR, PROTO_UDP] // UDP
+#endif
 
 done#:
     alu[hdr_stack, --, B, BF_A(pkt_vec, PV_HEADER_STACK_bf)]
@@ -40,6 +40,11 @@ typedef struct {
 	uint64_t tx_bytes;
 } nfd_qstats_t;
 
+typedef struct {
+    uint64_t alloc_fail;
+    uint64_t wait_ticks;
+} ctm_stats_t;
+
 // working stats
 __shared __align8 __imem struct macstats_port_accum _mac_stats[NS_PLATFORM_NUM_PORTS];
 __shared __align8 __imem struct macstats_head_drop_accum _mac_stats_head_drop;
@@ -48,6 +53,7 @@ __lmem __shared nic_stats_vnic_t _vnic_stats;
 
 // result stats
 __export __shared __emem struct macstats_port_accum mac_stats[24];
+__export __shared __emem ctm_stats_t nic_ctm_stats;
 
 #define MIN(x, y) ((x) > (y)) ? (y) : (x)
 
@@ -124,6 +130,36 @@ static void mac_stats_accumulate(void)
 }
 
 
+/* Sum the per island CTM buffer exhaustion counters of the NFD receive
+ * path into nic_ctm_stats, see NIC_STATS_CTM_SIZE. */
+static void ctm_stats_accumulate(void)
+{
+    __xread uint64_t read_block[8];
+    __xwrite uint64_t write_block[2];
+    __gpr uint32_t i;
+    __gpr uint32_t offset;
+    ctm_stats_t ctm_stats = { 0 };
+
+    __emem char *stats_ctm = (__emem char *) __link_sym("_nic_stats_ctm");
+
+    for (offset = 0;
+	 offset < NIC_STATS_CTM_ISLANDS * NIC_STATS_CTM_SIZE;
+	 offset += sizeof(read_block)) {
+	mem_read64(&read_block, stats_ctm + offset, sizeof(read_block));
+	for (i = 0; i < sizeof(read_block) / 8; i += NIC_STATS_CTM_SIZE / 8) {
+	    ctm_stats.alloc_fail +=
+		swapw64(read_block[i + NIC_STATS_CTM_ALLOC_FAIL / 8]);
+	    ctm_stats.wait_ticks +=
+		swapw64(read_block[i + NIC_STATS_CTM_WAIT_TICKS / 8]);
+	}
+    }
+
+    write_block[0] = swapw64(ctm_stats.alloc_fail);
+    write_block[1] = swapw64(ctm_stats.wait_ticks);
+    mem_write64(&write_block, &nic_ctm_stats, sizeof(write_block));
+}
+
+
 static void
 update_vnic_queue_stat(nfd_qstats_t *nfd,
 	               uint32_t *vnic_stat, uint32_t queue_stat,
@@ -382,6 +418,7 @@ nic_stats_loop(void)
     for (;;) {
         if (signal_test(&sig)) {
             mac_stats_accumulate();
+            ctm_stats_accumulate();
             vnic_stats_accumulate();
 
             set_alarm(STATS_INTERVAL, &sig);
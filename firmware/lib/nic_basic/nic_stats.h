@@ -15,18 +15,29 @@
 
 #include "nic_stats_gen.h"
 
+/* CTM buffer exhaustion on the NFD receive path, per island of the worker
+ * MEs: failed allocations and TIMESTAMP_LOW ticks (16 cycles each) spent
+ * backing off, 64 bits each. The sums over all islands are exported in the
+ * same layout as nic_ctm_stats. */
+#define NIC_STATS_CTM_ALLOC_FAIL    0x0
+#define NIC_STATS_CTM_WAIT_TICKS    0x8
+#define NIC_STATS_CTM_SIZE          16
+#define NIC_STATS_CTM_ISLANDS       64
+
 #if defined(__NFP_LANG_MICROC)
 typedef char ext_stats_key_t[32];
 
 __asm {
     .alloc_mem _nic_stats_queue imem+0 global (512 * NIC_STATS_QUEUE_SIZE) 256
     .alloc_mem _nic_stats_vnic emem global (NVNICS * NIC_STATS_VNIC_SIZE) 256
+    .alloc_mem _nic_stats_ctm emem global (NIC_STATS_CTM_ISLANDS * NIC_STATS_CTM_SIZE) 256
 }
 
 #elif defined(__NFP_LANG_ASM)
 
 .alloc_mem _nic_stats_queue imem+0 global (512 * NIC_STATS_QUEUE_SIZE) 256
 .alloc_mem _nic_stats_vnic emem global (NVNICS * NIC_STATS_VNIC_SIZE) 256
+.alloc_mem _nic_stats_ctm emem global (NIC_STATS_CTM_ISLANDS * NIC_STATS_CTM_SIZE) 256
 #endif
 
 #endif
@@ -0,0 +1,45 @@
+# Copyright (c) 2020 Netronome Systems, Inc. All rights reserved.
+# SPDX-License-Identifier: BSD-2-Clause
+#
+# Summarize the per opcode cycle counters of a datapath built with
+# ACTIONS_PROFILE, e.g.:
+#
+#   nfp-rtsym _actions_prof | awk -f scripts/actions_prof.awk
+#
+# Each opcode has a 64-bit cycle sum followed by a 64-bit count (big endian
+# 32-bit words). Restrict sampling to one ingress queue by writing its action
+# table index ((pcie << 6) | queue or (1 << 8) | port) to _actions_prof_queue,
+# 0xffff samples all queues.
+
+BEGIN{
+    split("drop rx_wire dst_mac_match checksum rss tx_host rx_host " \
+          "tx_wire cmsg ebpf pop_vlan push_vlan src_mac_match veb_lookup " \
+          "pop_pkt push_pkt tx_vlan l2_switch_wire l2_switch_host " \
+          "rx_wire_dmac_match checksum_rss_tx_host lro hds", NAME, " ")
+    WORDS = 0
+}
+function hex(str,    i, v) {
+    v = 0
+    str = tolower(substr(str, 3))
+    for (i = 1; i <= length(str); ++i)
+        v = v * 16 + index("0123456789abcdef", substr(str, i, 1)) - 1
+    return v
+}
+{
+    for (i = 1; i <= NF; ++i) {
+        if ($i ~ /:$/ || $i !~ /^0x[0-9a-fA-F]+$/)
+            continue
+        WORD[WORDS++] = hex($i)
+    }
+}
+END{
+    printf("%-22s %16s %20s %10s\n", "opcode", "count", "cycles", "avg")
+    for (op = 0; op * 4 + 3 < WORDS; ++op) {
+        cycles = WORD[op * 4] * 4294967296 + WORD[op * 4 + 1]
+        count = WORD[op * 4 + 2] * 4294967296 + WORD[op * 4 + 3]
+        if (count == 0)
+            continue
+        name = (op + 1 in NAME) ? NAME[op + 1] : sprintf("op_%d", op)
+        printf("%-22s %16.0f %20.0f %10.1f\n", name, count, cycles, cycles / count)
+    }
+}
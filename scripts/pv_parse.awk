@@ -0,0 +1,69 @@
+# Copyright (c) 2020 Netronome Systems, Inc. All rights reserved.
+# SPDX-License-Identifier: BSD-2-Clause
+#
+# Compile the protocol graph (firmware/apps/nic/pv_parse.def) into
+# pv_parse_gen.uc: one PV_PARSE_<PROTO> switch per optional protocol and
+# the EtherType dispatch of pv_hdr_parse_subroutine, most frequent first.
+
+BEGIN{
+    ETH_COUNT = 0
+    OPTIONAL = "ipv6 ipv6_ext vlan mpls gre vxlan geneve"
+    split(OPTIONAL, PROTOS, " ")
+}
+/^[ \t]*#/ || /^[ \t]*$/ { next }
+{
+    if (NF < 3 || NF > 4) {
+        print FILENAME ":" NR ": expecting <from> <key> <to> [weight]" > "/dev/stderr"
+        exit 1
+    }
+
+    ENABLED[$3] = 1
+
+    if ($1 == "eth") {
+        if ($2 == "-") {
+            print FILENAME ":" NR ": EtherType transitions need a key" > "/dev/stderr"
+            exit 1
+        }
+        weight = (NF == 4) ? $4 + 0 : 0
+
+        # insertion sort, stable for equal weights
+        for (i = ETH_COUNT; i > 0 && ETH_WEIGHT[i - 1] < weight; i--) {
+            ETH_KEY[i] = ETH_KEY[i - 1]
+            ETH_TO[i] = ETH_TO[i - 1]
+            ETH_WEIGHT[i] = ETH_WEIGHT[i - 1]
+        }
+        ETH_KEY[i] = $2
+        ETH_TO[i] = $3
+        ETH_WEIGHT[i] = weight
+        ETH_COUNT++
+    }
+}
+END{
+    if (!ENABLED["ipv4"]) {
+        print FILENAME ": ipv4 can not be removed from the parser" > "/dev/stderr"
+        exit 1
+    }
+
+    print "/* This file is generated during build. Do not edit! */"
+    print "#ifndef _PV_PARSE_GEN_UC"
+    print "#define _PV_PARSE_GEN_UC"
+    print ""
+
+    for (i = 1; i in PROTOS; i++)
+        printf("#define PV_PARSE_%s %d\n", toupper(PROTOS[i]),
+               (PROTOS[i] in ENABLED) ? 1 : 0)
+    print ""
+
+    print "/* Branch to parse_<proto>#, or to UNKNOWN_LABEL */"
+    print "#macro pv_parse_gen_eth_type(in_eth_type, io_proto_test, UNKNOWN_LABEL)"
+    for (i = 0; i < ETH_COUNT; i++) {
+        print "    immed[io_proto_test, " ETH_KEY[i] "]"
+        print "    alu[--, in_eth_type, -, io_proto_test]"
+        print "    beq[parse_" ETH_TO[i] "#]"
+    }
+    print "    br[UNKNOWN_LABEL]"
+    print "#endm"
+    print ""
+
+    print "#endif"
+}
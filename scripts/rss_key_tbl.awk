@@ -0,0 +1,47 @@
+# Copyright (C) 2020 Netronome Systems, Inc.  All rights reserved.
+#
+# SPDX-License-Identifier: BSD-2-Clause
+#
+# Generate nfp-rtsym commands loading the Toeplitz RSS key tables of one
+# NIC_RSS_KEY_TBL slot, matching upd_rss_key_table() in app_config_tables.c.
+#
+# Usage: awk -v key=<80 hex digits> [-v slot=N] [-v rows=N] \
+#            -f rss_key_tbl.awk | sh
+
+function window(offset,    wrd, shf)
+{
+    wrd = int(offset / 32)
+    shf = offset % 32
+    if (shf == 0)
+        return k[wrd]
+    return and(or(lshift(k[wrd], shf), rshift(k[wrd + 1], 32 - shf)),
+               0xffffffff)
+}
+
+BEGIN {
+    if (length(key) != 80) {
+        print "key must be 40 bytes in hex" > "/dev/stderr"
+        exit 1
+    }
+    if (rows == "")
+        rows = 72
+    if (slot == "")
+        slot = 0
+
+    for (i = 0; i < 10; i++)
+        k[i] = strtonum("0x" substr(key, i * 8 + 1, 8))
+
+    for (row = 0; row < rows; row++) {
+        for (b = 0; b < 4; b++)
+            w[b] = window(row * 4 + b)
+        for (j = 0; j < 16; j++) {
+            entry = 0
+            for (b = 0; b < 4; b++) {
+                if (and(j, rshift(8, b)))
+                    entry = xor(entry, w[b])
+            }
+            printf("nfp-rtsym i32.NIC_RSS_KEY_TBL:%d 0x%08x\n",
+                   slot * 72 * 64 + row * 64 + j * 4, entry)
+        }
+    }
+}
@@ -0,0 +1,91 @@
+/* Copyright (c) 2017-2020  Netronome Systems, Inc.  All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+;TEST_INIT_EXEC nfp-reg mereg:i32.me0.XferIn_32=0x0
+;TEST_INIT_EXEC nfp-reg mereg:i32.me0.XferIn_33=0x0
+;TEST_INIT_EXEC nfp-reg mereg:i32.me0.XferIn_34=0xdeadbeef
+;TEST_INIT_EXEC nfp-reg mereg:i32.me0.XferIn_35=0xdeadbeef
+
+#include "pkt_ipv4_udp_x88.uc"
+#include <global.uc>
+#include "actions_harness.uc"
+#include <actions.uc>
+#include "actions_classify_veb_insertion.uc"
+
+.reg key[2]
+.reg action[2]
+.reg cache_base
+.reg cache_off
+.reg read $cache[2]
+.xfer_order $cache
+.reg write $poison
+.sig sig_cache
+
+move(key[0], 0xfff00011)
+move(key[1], 0x22334455)
+move(action[0], 0xeeffc000)
+move(action[1], 0xefbeadde)
+
+
+veb_entry_insert(key, action, continue#)
+continue#:
+
+alu[__actions_t_idx, t_idx_ctx, OR, &$__actions[0], <<2]
+nop
+local_csr_wr[T_INDEX, __actions_t_idx]
+nop
+nop
+nop
+
+__actions_veb_lookup(pkt_vec, discards_filter_mac#)
+
+test_assert_equal($__actions[0], 0xc0ffee)
+test_assert_equal($__actions[1], 0xdeadbeef)
+
+// the resolved action list and the key are now in the island cache
+alu[cache_off, key[0], XOR, key[1]]
+alu[cache_off, cache_off, XOR, cache_off, >>16]
+alu[cache_off, (NIC_VEB_CACHE_ENTRIES - 1), AND, cache_off]
+alu[cache_off, --, B, cache_off, <<(log2(NIC_MAX_INSTR * 4))]
+move(cache_base, (_veb_cache >> 8))
+
+mem[read32, $cache[0], cache_base, <<8, cache_off, 2], ctx_swap[sig_cache]
+test_assert_equal($cache[0], 0xc0ffee)
+test_assert_equal($cache[1], 0xdeadbeef)
+
+alu[cache_off, cache_off, +, ((NIC_MAX_INSTR - 2) * 4)]
+mem[read32, $cache[0], cache_base, <<8, cache_off, 2], ctx_swap[sig_cache]
+test_assert_equal($cache[0], (0xfff00011 | (1 << NIC_VEB_CACHE_VALID_SHF)))
+test_assert_equal($cache[1], 0x22334455)
+
+// a second lookup must be served from the cache, not the hash table
+alu[cache_off, cache_off, -, ((NIC_MAX_INSTR - 2) * 4)]
+immed[$poison, 0xf00d]
+mem[write32, $poison, cache_base, <<8, cache_off, 1], ctx_swap[sig_cache]
+
+alu[__actions_t_idx, t_idx_ctx, OR, &$__actions[0], <<2]
+nop
+local_csr_wr[T_INDEX, __actions_t_idx]
+nop
+nop
+nop
+
+__actions_veb_lookup(pkt_vec, discards_filter_mac#)
+
+test_assert_equal($__actions[0], 0xf00d)
+test_assert_equal($__actions[1], 0xdeadbeef)
+
+test_assert_equal(*$index++, 0xf00d)
+test_assert_equal(*$index++, 0xdeadbeef)
+
+test_pass()
+
+discards_filter_mac#:
+error_map_fd#:
+lookup_not_found#:
+test_fail()
+
+PV_SEEK_SUBROUTINE#:
+   pv_seek_subroutine(pkt_vec)
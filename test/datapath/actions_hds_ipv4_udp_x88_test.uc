@@ -0,0 +1,34 @@
+/* Copyright (c) 2017-2020  Netronome Systems, Inc.  All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+#include "pkt_ipv4_udp_x88.uc"
+
+#include "actions_harness.uc"
+
+#include <config.h>
+#include <global.uc>
+#include <pv.uc>
+#include <stdmac.uc>
+
+.reg meta_type
+.reg hdr_len
+
+local_csr_wr[ACTIVE_LM_ADDR_2, 0x100]
+test_action_reset()
+
+__actions_hds(pkt_vec)
+
+/* the payload starts after the 8 byte UDP header */
+alu[meta_type, 0xf, AND, BF_A(pkt_vec, PV_META_TYPES_bf)]
+test_assert_equal(meta_type, NIC_META_HDS)
+
+alu[--, --, B, *l$index2--]
+alu[hdr_len, --, B, *l$index2--]
+test_assert_equal(hdr_len, (14 + 20 + 8))
+
+test_pass()
+
+PV_SEEK_SUBROUTINE#:
+   pv_seek_subroutine(pkt_vec)
@@ -0,0 +1,123 @@
+/* Copyright (c) 2017-2020  Netronome Systems, Inc.  All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+;TEST_INIT_EXEC nfp-reg mereg:i32.me0.XferIn_32=0x1000
+;TEST_INIT_EXEC nfp-reg mereg:i32.me0.XferIn_33=0x0003
+
+/* aggregate of the first segment, as held by the LRO ME */
+;TEST_INIT_EXEC nfp-mem emem0:0x1080  0x0000000c 0x000c0001 0x00888888 0x99999999
+;TEST_INIT_EXEC nfp-mem emem0:0x1090  0xaaaaaaaa 0x08004500 0x00340000 0x40004006
+;TEST_INIT_EXEC nfp-mem emem0:0x10a0  0xb970c0a8 0x0001c0a8 0x00020400 0x00500000
+;TEST_INIT_EXEC nfp-mem emem0:0x10b0  0x00000000 0x00015010 0x01000000 0x00006865
+;TEST_INIT_EXEC nfp-mem emem0:0x10c0  0x6c6c6f20 0x776f726c 0x640a0000
+
+#include "pkt_ipv4_tcp_lro_x88.uc"
+
+#include "actions_harness.uc"
+#include <single_ctx_test.uc>
+
+#include <config.h>
+#include <gro_cfg.uc>
+#include <global.uc>
+#include <pv.uc>
+#include <stdmac.uc>
+
+.reg ctl
+.reg entry_off
+.reg expected
+.reg hdr[NIC_LRO_KEY_LW]
+.reg l3_offset
+.reg lro_base
+.reg lro_desc[NIC_LRO_DESC_LW]
+.reg payload
+.reg pkt_desc[NIC_LRO_DESC_LW]
+.reg seg_hi
+.reg seg_lo
+.reg seq
+.reg tmp
+.reg wq[NIC_LRO_WQ_DESC_LW]
+.reg read $rd[4]
+.xfer_order $rd
+.sig sig_rd
+.sig sig_wr
+
+local_csr_wr[NN_GET, 96]
+local_csr_wr[ACTIVE_LM_ADDR_2, 0]
+test_action_reset()
+
+/* the segment can be coalesced, it is queued with its MSS and count */
+__actions_lro(pkt_vec, queued#)
+test_fail()
+
+queued#:
+test_assert_equal(BF_A(pkt_vec, PV_META_TYPES_bf), NIC_META_LRO)
+immed[tmp, 0x1880]
+mem[read32, $rd[0], 0, <<8, tmp, 2], ctx_swap[sig_rd]
+test_assert_equal($rd[0], NIC_META_LRO)
+test_assert_equal($rd[1], 0x000c0001)
+
+immed[tmp, 0x3000]
+mem[write32, $__pkt_io_gro_meta[0], 0, <<8, tmp, 4], ctx_swap[sig_wr]
+mem[read32, $rd[0], 0, <<8, tmp, 4], ctx_swap[sig_rd]
+alu[wq[NIC_LRO_WQ_BLS_wrd], --, B, $rd[1]]
+alu[wq[NIC_LRO_WQ_LEN_wrd], --, B, $rd[2]]
+alu[wq[NIC_LRO_WQ_INFO_wrd], --, B, $rd[3]]
+test_assert_equal(wq[NIC_LRO_WQ_BLS_wrd], 0x3)
+test_assert_equal(wq[NIC_LRO_WQ_LEN_wrd], 0x0803004a)
+test_assert_equal(wq[NIC_LRO_WQ_INFO_wrd], 0xc00e0078)
+
+lro_get_nfd_desc(pkt_desc, wq)
+test_assert_equal(pkt_desc[NFD_OUT_OFFSET_wrd], 0x80)
+test_assert_equal(pkt_desc[NFD_OUT_BLS_wrd], 0x3)
+test_assert_equal(pkt_desc[NFD_OUT_QID_wrd], 0x8803004a)
+test_assert_equal(pkt_desc[NFD_OUT_FLAGS_wrd], 0x78)
+
+/* hold the first segment, it has aged once */
+move(hdr[0], 0xc0a80001)
+move(hdr[1], 0xc0a80002)
+move(hdr[2], 0x04000050)
+immed[hdr[3], 0]
+immed[hdr[4], 1]
+move(hdr[5], 0x50100100)
+immed[hdr[6], 0]
+immed[hdr[7], 0]
+immed[lro_desc[NFD_OUT_OFFSET_wrd], 0x80]
+immed[lro_desc[NFD_OUT_BLS_wrd], 0x2]
+move(lro_desc[NFD_OUT_QID_wrd], 0x8803004a)
+immed[lro_desc[NFD_OUT_FLAGS_wrd], 0x78]
+move(lro_base, (_nic_lro_tbl >> 8))
+immed[entry_off, (0x57 << NIC_LRO_ENTRY_SZ_LOG2)]
+immed[tmp, 0x1000]
+immed[payload, 12]
+immed[l3_offset, 14]
+lro_hold(ctl, lro_base, entry_off, hdr, payload, lro_desc, tmp, 0, l3_offset)
+alu[ctl, ctl, OR, 1, <<BF_L(NIC_LRO_AGED_bf)]
+
+/* append the second one */
+alu[seg_hi, --, B, pkt_desc[NFD_OUT_BLS_wrd], <<3]
+immed[seg_lo, (0x80 + 8 + 14 + 20)]
+immed[seq, 12]
+lro_append(ctl, lro_base, entry_off, lro_desc, seq, seg_hi, seg_lo, payload)
+
+move(expected, ((1 << BF_L(NIC_LRO_VALID_bf)) | (2 << BF_L(NIC_LRO_SEGS_bf)) | 14))
+test_assert_equal(ctl, expected)
+
+alu[tmp, entry_off, +, ((NIC_LRO_KEY_wrd + 3) * 4)]
+mem[read32, $rd[0], lro_base, <<8, tmp, 1], ctx_swap[sig_rd]
+test_assert_equal($rd[0], 24)
+alu[tmp, entry_off, +, (NIC_LRO_DESC_wrd * 4)]
+mem[read32, $rd[0], lro_base, <<8, tmp, 4], ctx_swap[sig_rd]
+test_assert_equal($rd[NFD_OUT_QID_wrd], 0x88030056)
+
+immed[tmp, 0x10ca]
+mem[read8, $rd[0], 0, <<8, tmp, 12], ctx_swap[sig_rd]
+test_assert_equal($rd[0], 0x48454c4c)
+test_assert_equal($rd[1], 0x4f20574f)
+test_assert_equal($rd[2], 0x524c440a)
+
+test_pass()
+
+PV_SEEK_SUBROUTINE#:
+   pv_seek_subroutine(pkt_vec)
@@ -0,0 +1,80 @@
+/* Copyright (c) 2017-2020  Netronome Systems, Inc.  All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+;TEST_INIT_EXEC nfp-reg mereg:i32.me0.XferIn_32=0x1000
+;TEST_INIT_EXEC nfp-reg mereg:i32.me0.XferIn_33=0x0003
+
+/* aggregate of two segments, as held by the LRO ME */
+;TEST_INIT_EXEC nfp-mem emem0:0x1080  0x0000000c 0x000c0001 0x00888888 0x99999999
+;TEST_INIT_EXEC nfp-mem emem0:0x1090  0xaaaaaaaa 0x08004500 0x00340000 0x40004006
+;TEST_INIT_EXEC nfp-mem emem0:0x10a0  0xb970c0a8 0x0001c0a8 0x00020400 0x00500000
+;TEST_INIT_EXEC nfp-mem emem0:0x10b0  0x00000000 0x00015010 0x01000000 0x00006865
+;TEST_INIT_EXEC nfp-mem emem0:0x10c0  0x6c6c6f20 0x776f726c 0x640a4845 0x4c4c4f20
+;TEST_INIT_EXEC nfp-mem emem0:0x10d0  0x574f524c 0x440a0000
+
+#include "pkt_ipv4_tcp_lro_x88.uc"
+
+/* PSH ends the aggregate */
+;TEST_INIT_EXEC nfp-mem emem0:0x18b0  0x000c0000 0x00015018 0x01000000 0x00004845
+
+#include "actions_harness.uc"
+#include <single_ctx_test.uc>
+
+#include <config.h>
+#include <gro_cfg.uc>
+#include <global.uc>
+#include <pv.uc>
+#include <stdmac.uc>
+
+.reg ctl
+.reg lro_desc[NIC_LRO_DESC_LW]
+.reg tmp
+.reg read $rd[4]
+.xfer_order $rd
+.sig sig_fixup
+.sig sig_rd
+.sig sig_wr
+
+local_csr_wr[NN_GET, 96]
+local_csr_wr[ACTIVE_LM_ADDR_2, 0]
+test_action_reset()
+
+/* queued without LRO metadata, the LRO ME flushes the aggregate first */
+__actions_lro(pkt_vec, queued#)
+test_fail()
+
+queued#:
+test_assert_equal(BF_A(pkt_vec, PV_META_TYPES_bf), 0)
+
+immed[tmp, 0x3000]
+mem[write32, $__pkt_io_gro_meta[0], 0, <<8, tmp, 4], ctx_swap[sig_wr]
+mem[read32, $rd[0], 0, <<8, tmp, 4], ctx_swap[sig_rd]
+test_assert_equal($rd[1], 0x3)
+test_assert_equal($rd[2], 0x00030042)
+test_assert_equal($rd[3], 0x440e0078)
+
+/* IPv4 length and checksum cover both payloads, the count is updated */
+move(ctl, ((1 << BF_L(NIC_LRO_VALID_bf)) | (2 << BF_L(NIC_LRO_SEGS_bf)) | 14))
+immed[lro_desc[NFD_OUT_OFFSET_wrd], 0x80]
+immed[lro_desc[NFD_OUT_BLS_wrd], 0x2]
+move(lro_desc[NFD_OUT_QID_wrd], 0x88030056)
+immed[lro_desc[NFD_OUT_FLAGS_wrd], 0x78]
+lro_fixup(ctl, lro_desc, sig_fixup)
+ctx_arb[sig_fixup]
+
+immed[tmp, 0x1098]
+mem[read32, $rd[0], 0, <<8, tmp, 3], ctx_swap[sig_rd]
+test_assert_equal($rd[0], 0x00400000)
+test_assert_equal($rd[1], 0x40004006)
+test_assert_equal($rd[2], 0xb964c0a8)
+
+immed[tmp, 0x1084]
+mem[read32, $rd[0], 0, <<8, tmp, 1], ctx_swap[sig_rd]
+test_assert_equal($rd[0], 0x000c0002)
+
+test_pass()
+
+PV_SEEK_SUBROUTINE#:
+   pv_seek_subroutine(pkt_vec)
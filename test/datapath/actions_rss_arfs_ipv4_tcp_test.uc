@@ -0,0 +1,81 @@
+/* Copyright (c) 2017-2020  Netronome Systems, Inc.  All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+;TEST_INIT_EXEC nfp-reg mereg:i32.me0.XferIn_32=0xf0bf
+;TEST_INIT_EXEC nfp-reg mereg:i32.me0.XferIn_33=0x10c0ffee
+;TEST_INIT_EXEC nfp-reg mereg:i32.me0.XferIn_34=0xdeadbeef
+
+;TEST_INIT_EXEC nfp-rtsym i32.NIC_RSS_TBL:128 0x01020304
+
+#include "pkt_ipv4_tcp_x88.uc"
+
+#include "actions_harness.uc"
+#include <single_ctx_test.uc>
+
+#include <config.h>
+#include <gro_cfg.uc>
+#include <global.uc>
+#include <pv.uc>
+#include <stdmac.uc>
+
+local_csr_wr[NN_GET, 96]
+
+#macro rss_reset_test(in_pkt_vec)
+    local_csr_wr[T_INDEX, (32 * 4)]
+    immed[__actions_t_idx, (32 * 4)]
+    pv_invalidate_cache(in_pkt_vec)
+    immed[BF_A(in_pkt_vec, PV_QUEUE_OFFSET_bf), 0]
+    immed[BF_A(in_pkt_vec, PV_META_TYPES_bf), 0]
+#endm
+
+.reg arfs_base
+.reg arfs_offset
+.reg queue
+.reg $arfs_wr[3]
+.xfer_order $arfs_wr
+.sig sig_arfs
+
+#macro arfs_entry_write(in_queue, in_ports)
+    move($arfs_wr[0], ((in_queue << 24) | (1 << 23) | (NFP_NET_RSS_IPV4_TCP << 16) | (1 << 7)))
+    move($arfs_wr[1], 0x3bf00e81)
+    move($arfs_wr[2], in_ports)
+    mem[write32, $arfs_wr[0], arfs_base, <<8, arfs_offset, 3], ctx_swap[sig_arfs]
+#endm
+
+#macro arfs_validate(expected_queue)
+    rss_reset_test(pkt_vec)
+    __actions_rss(pkt_vec)
+
+    alu[queue, 0xf, AND, BF_A(pkt_vec, PV_META_TYPES_bf)]
+    test_assert_equal(queue, NFP_NET_META_HASH)
+    alu[queue, 0xf, AND, BF_A(pkt_vec, PV_META_TYPES_bf), >>4]
+    test_assert_equal(queue, NFP_NET_RSS_IPV4_TCP)
+
+    alu[queue, 0xff, AND, BF_A(pkt_vec, PV_QUEUE_OFFSET_bf)]
+    test_assert_equal(queue, expected_queue)
+
+    test_assert_equal(*$index, 0xdeadbeef)
+#endm
+
+/* entry for hash 0x3bf00e81 of 192.168.0.1:1024 -> 192.168.0.2:80 on vNIC 1 */
+move(arfs_base, (_nic_arfs_tbl >> 8))
+move(arfs_offset, ((0x3bf00e81 & (NIC_ARFS_TBL_ENTRIES - 1)) << NIC_ARFS_ENTRY_SZ_LOG2))
+
+/* steered flow */
+arfs_entry_write(0x2a, 0x04000050)
+arfs_validate(0x2a)
+
+/* ports differ, RSS table queue */
+arfs_entry_write(0x2a, 0x04000051)
+arfs_validate(0x02)
+
+/* queue beyond max_queue, RSS table queue */
+arfs_entry_write(0x40, 0x04000050)
+arfs_validate(0x02)
+
+test_pass()
+
+PV_SEEK_SUBROUTINE#:
+   pv_seek_subroutine(pkt_vec)
@@ -0,0 +1,36 @@
+/* Copyright (c) 2017-2020  Netronome Systems, Inc.  All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+;TEST_INIT_EXEC nfp-reg mereg:i32.me0.XferIn_32=0xf0bf
+
+#include "pkt_ipv4_tcp_x88.uc"
+
+#include "actions_rss.uc"
+
+.reg arfs_base
+.reg arfs_offset
+.reg queue
+.reg $arfs_wr[3]
+.xfer_order $arfs_wr
+.sig sig_arfs
+
+/* entry for hash 0x3bf00e81 of 192.168.0.1:1024 -> 192.168.0.2:80 on vNIC 1 */
+move(arfs_base, (_nic_arfs_tbl >> 8))
+move(arfs_offset, ((0x3bf00e81 & (NIC_ARFS_TBL_ENTRIES - 1)) << NIC_ARFS_ENTRY_SZ_LOG2))
+move($arfs_wr[0], ((0x2a << 24) | (1 << 23) | (NFP_NET_RSS_IPV4_TCP << 16) | (1 << 7)))
+move($arfs_wr[1], 0x3bf00e81)
+move($arfs_wr[2], 0x04000050)
+mem[write32, $arfs_wr[0], arfs_base, <<8, arfs_offset, 3], ctx_swap[sig_arfs]
+
+/* INSTR_RSS_ARFS is clear, the matching entry is not looked at */
+rss_reset_test(pkt_vec)
+__actions_rss(pkt_vec)
+
+rss_validate(pkt_vec, NFP_NET_RSS_IPV4_TCP, test_assert_equal, 0x3bf00e81)
+
+test_pass()
+
+PV_SEEK_SUBROUTINE#:
+   pv_seek_subroutine(pkt_vec)
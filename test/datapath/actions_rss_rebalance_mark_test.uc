@@ -0,0 +1,75 @@
+/* Copyright (c) 2017-2020  Netronome Systems, Inc.  All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+;TEST_INIT_EXEC nfp-reg mereg:i32.me0.XferIn_32=0xf0bf
+;TEST_INIT_EXEC nfp-reg mereg:i32.me0.XferIn_33=0x40c0ffee
+;TEST_INIT_EXEC nfp-reg mereg:i32.me0.XferIn_34=0xdeadbeef
+
+#include "pkt_ipv4_tcp_x88.uc"
+
+#include "actions_harness.uc"
+#include <single_ctx_test.uc>
+
+#include <config.h>
+#include <gro_cfg.uc>
+#include <global.uc>
+#include <pv.uc>
+#include <stdmac.uc>
+
+.reg act_addr
+.reg bucket
+.reg expected
+.reg hash
+.reg word
+.reg $act[4]
+.xfer_order $act
+.reg write $zero[4]
+.xfer_order $zero
+.sig sig_act
+
+local_csr_wr[NN_GET, 96]
+
+/* clear the activity bits of RSS table 1 */
+move(act_addr, (NIC_RSS_ACT_TBL_ADDR + 16))
+aggregate_zero($zero, 4)
+cls[write, $zero[0], act_addr, 0, 4], ctx_swap[sig_act]
+
+local_csr_wr[T_INDEX, (32 * 4)]
+immed[__actions_t_idx, (32 * 4)]
+pv_invalidate_cache(pkt_vec)
+immed[BF_A(pkt_vec, PV_QUEUE_OFFSET_bf), 0]
+immed[BF_A(pkt_vec, PV_META_TYPES_bf), 0]
+
+__actions_rss(pkt_vec)
+
+alu[--, --, B, *l$index2--]
+alu[hash, --, B, *l$index2--]
+
+test_assert_equal(*$index, 0xdeadbeef)
+
+/* the rebalance bit is not part of the CRC32 seed */
+test_assert_equal(hash, 0x3bf00e81)
+
+/* exactly the bit of the selected bucket is set */
+alu[bucket, 0x7f, AND, hash]
+cls[read, $act[0], act_addr, 0, 4], ctx_swap[sig_act]
+
+#define_eval _ACT_WORD 0
+#while (_ACT_WORD < 4)
+    immed[expected, 0]
+    alu[word, --, B, bucket, >>5]
+    .if (word == _ACT_WORD)
+        alu[--, bucket, OR, 0]
+        alu[expected, --, B, 1, <<indirect]
+    .endif
+    test_assert_equal($act[_ACT_WORD], expected)
+    #define_eval _ACT_WORD (_ACT_WORD + 1)
+#endloop
+#undef _ACT_WORD
+
+test_pass()
+
+PV_SEEK_SUBROUTINE#:
+   pv_seek_subroutine(pkt_vec)
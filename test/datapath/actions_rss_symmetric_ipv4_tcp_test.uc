@@ -0,0 +1,69 @@
+/* Copyright (c) 2017-2020  Netronome Systems, Inc.  All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+;TEST_INIT_EXEC nfp-reg mereg:i32.me0.XferIn_32=0xf0bf
+;TEST_INIT_EXEC nfp-reg mereg:i32.me0.XferIn_33=0x20c0ffee
+;TEST_INIT_EXEC nfp-reg mereg:i32.me0.XferIn_34=0xdeadbeef
+
+#include "pkt_ipv4_tcp_x88.uc"
+
+#include "actions_harness.uc"
+#include <single_ctx_test.uc>
+
+#include <config.h>
+#include <gro_cfg.uc>
+#include <global.uc>
+#include <pv.uc>
+#include <stdmac.uc>
+
+.reg meta_type
+.reg hash_type
+.reg hash
+.reg fwd_hash
+.reg pkt_offset
+.reg $reverse[3]
+.xfer_order $reverse
+.sig sig_reverse
+
+#macro rss_symmetric_run(out_hash)
+    local_csr_wr[T_INDEX, (32 * 4)]
+    immed[__actions_t_idx, (32 * 4)]
+    pv_invalidate_cache(pkt_vec)
+    immed[BF_A(pkt_vec, PV_QUEUE_OFFSET_bf), 0]
+    immed[BF_A(pkt_vec, PV_META_TYPES_bf), 0]
+
+    __actions_rss(pkt_vec)
+
+    alu[meta_type, 0xf, AND, BF_A(pkt_vec, PV_META_TYPES_bf)]
+    test_assert_equal(meta_type, NFP_NET_META_HASH)
+    alu[hash_type, 0xf, AND, BF_A(pkt_vec, PV_META_TYPES_bf), >>4]
+    test_assert_equal(hash_type, NFP_NET_RSS_IPV4_TCP)
+
+    alu[--, --, B, *l$index2--]
+    alu[out_hash, --, B, *l$index2--]
+
+    test_assert_equal(*$index, 0xdeadbeef)
+#endm
+
+local_csr_wr[NN_GET, 96]
+
+/* 192.168.0.1:1024 -> 192.168.0.2:80 */
+rss_symmetric_run(fwd_hash)
+
+/* 192.168.0.2:80 -> 192.168.0.1:1024 */
+move($reverse[0], 0xc0a80002)
+move($reverse[1], 0xc0a80001)
+move($reverse[2], 0x00500400)
+move(pkt_offset, (14 + 12))
+mem[write8, $reverse[0], BF_A(pkt_vec, PV_CTM_ADDR_bf), pkt_offset, 12], ctx_swap[sig_reverse]
+
+rss_symmetric_run(hash)
+
+test_assert_equal(hash, fwd_hash)
+
+test_pass()
+
+PV_SEEK_SUBROUTINE#:
+   pv_seek_subroutine(pkt_vec)
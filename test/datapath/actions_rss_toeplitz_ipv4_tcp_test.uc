@@ -0,0 +1,56 @@
+/* Copyright (c) 2017-2020  Netronome Systems, Inc.  All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+;TEST_INIT_EXEC nfp-reg mereg:i32.me0.XferIn_32=0xf0bf
+;TEST_INIT_EXEC nfp-reg mereg:i32.me0.XferIn_33=0x80009000
+;TEST_INIT_EXEC nfp-reg mereg:i32.me0.XferIn_34=0xdeadbeef
+
+/* Microsoft RSS verification suite key, 3 words of IPv4 TCP hash input */
+;TEST_INIT_EXEC awk -v rows=24 -v key=6d5a56da255b0ec24167253d43a38fb0d0ca2bcbae7b30b477cb2da38030f20c6a42b73bbeac01fa -f scripts/rss_key_tbl.awk | sh
+
+#include "pkt_ipv4_tcp_x88.uc"
+
+#include "actions_harness.uc"
+#include <single_ctx_test.uc>
+
+#include <config.h>
+#include <gro_cfg.uc>
+#include <global.uc>
+#include <pv.uc>
+#include <stdmac.uc>
+
+.reg meta_type
+.reg hash_type
+.reg hash
+
+local_csr_wr[NN_GET, 96]
+
+passert(NIC_RSS_KEY_TBL_ADDR, "EQ", 0x9000)
+
+local_csr_wr[T_INDEX, (32 * 4)]
+immed[__actions_t_idx, (32 * 4)]
+pv_invalidate_cache(pkt_vec)
+immed[BF_A(pkt_vec, PV_QUEUE_OFFSET_bf), 0]
+immed[BF_A(pkt_vec, PV_META_TYPES_bf), 0]
+
+__actions_rss(pkt_vec)
+
+alu[meta_type, 0xf, AND, BF_A(pkt_vec, PV_META_TYPES_bf)]
+test_assert_equal(meta_type, NFP_NET_META_HASH)
+alu[hash_type, 0xf, AND, BF_A(pkt_vec, PV_META_TYPES_bf), >>4]
+test_assert_equal(hash_type, NFP_NET_RSS_IPV4_TCP)
+
+alu[--, --, B, *l$index2--]
+alu[hash, --, B, *l$index2--]
+
+/* 192.168.0.1:1024 -> 192.168.0.2:80 */
+test_assert_equal(hash, 0xf730a57b)
+
+test_assert_equal(*$index, 0xdeadbeef)
+
+test_pass()
+
+PV_SEEK_SUBROUTINE#:
+   pv_seek_subroutine(pkt_vec)
@@ -4,7 +4,7 @@
  */
 
 ;TEST_INIT_EXEC nfp-reg mereg:i32.me0.XferIn_32=0x7fe3
-;TEST_INIT_EXEC nfp-reg mereg:i32.me0.XferIn_33=0xff3f8c02
+;TEST_INIT_EXEC nfp-reg mereg:i32.me0.XferIn_33=0x0f3f8c02
 
 #include "actions_rss.uc"
 
@@ -4,7 +4,7 @@
  */
 
 ;TEST_INIT_EXEC nfp-reg mereg:i32.me0.XferIn_32=0xffe3
-;TEST_INIT_EXEC nfp-reg mereg:i32.me0.XferIn_33=0xff3f8c02
+;TEST_INIT_EXEC nfp-reg mereg:i32.me0.XferIn_33=0x0f3f8c02
 
 #include "pkt_ipv4_tcp_x88.uc"
 
@@ -0,0 +1,27 @@
+/* Copyright (c) 2017-2020  Netronome Systems, Inc.  All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+/* IPv4/TCP ACK with sequence number 12 and a 12 byte payload in the MU
+ * buffer at 0x1800 only, the second segment of a flow */
+
+;TEST_INIT_EXEC nfp-mem emem0:0x1880  0x00000000 0x00000000 0x00888888 0x99999999
+;TEST_INIT_EXEC nfp-mem emem0:0x1890  0xaaaaaaaa 0x08004500 0x00340000 0x40004006
+;TEST_INIT_EXEC nfp-mem emem0:0x18a0  0xb970c0a8 0x0001c0a8 0x00020400 0x00500000
+;TEST_INIT_EXEC nfp-mem emem0:0x18b0  0x000c0000 0x00015010 0x01000000 0x00004845
+;TEST_INIT_EXEC nfp-mem emem0:0x18c0  0x4c4c4f20 0x574f524c 0x440a0000
+
+#include <aggregate.uc>
+#include <stdmac.uc>
+
+#include <pv.uc>
+
+.reg pkt_vec[PV_SIZE_LW]
+aggregate_zero(pkt_vec, PV_SIZE_LW)
+move(pkt_vec[0], 0x42)
+move(pkt_vec[1], 0x3)
+move(pkt_vec[2], 0x88)
+move(pkt_vec[3], 0x2)
+move(pkt_vec[4], 0x00783fc0)
+move(pkt_vec[5], ((14 << 24) | ((14 + 20) << 16) | (14 << 8) | (14 + 20)))
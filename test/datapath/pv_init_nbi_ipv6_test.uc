@@ -0,0 +1,85 @@
+/* Copyright (c) 2017-2020  Netronome Systems, Inc.  All rights reserved.
+ *
+ * SPDX-License-Identifier: BSD-2-Clause
+ */
+
+;TEST_INIT_EXEC nfp-mem i32.ctm:0x80  0x00000000 0x00000000 0x00000000 0x00000000
+;TEST_INIT_EXEC nfp-mem i32.ctm:0x90  0x00000000 0x00000000 0x00000000 0x00000000
+
+#include <single_ctx_test.uc>
+#include <config.h>
+#include <global.uc>
+#include <pv.uc>
+#include <stdmac.uc>
+
+.sig s
+.reg addr
+.reg loop_cntr
+.reg tunnel_args
+.reg value
+.reg volatile read  $nbi_desc_rd[(NBI_IN_META_SIZE_LW + (MAC_PREPEND_BYTES / 4))]
+.reg volatile write $nbi_desc_wr[(NBI_IN_META_SIZE_LW + (MAC_PREPEND_BYTES / 4))]
+.xfer_order $nbi_desc_rd
+.xfer_order $nbi_desc_wr
+
+.reg global rtn_addr_reg
+.set rtn_addr_reg
+
+#define pkt_vec *l$index1
+
+#macro nbi_ipv6_desc_write(in_l4_type, in_v6_opt)
+    move($nbi_desc_wr[0], 64)
+    move($nbi_desc_wr[1], 0)
+    move($nbi_desc_wr[2], (1 << BF_L(CAT_SEQ_CTX_bf)))
+    move($nbi_desc_wr[3], ((CAT_L3_TYPE_IP << BF_L(CAT_L3_TYPE_bf)) | (1 << BF_L(CAT_L3_IP_VER_bf)) | (in_l4_type << BF_L(CAT_L4_TYPE_bf))))
+    move($nbi_desc_wr[4], ((MAC_PREPEND_BYTES + 14 + 40) << BF_L(CAT_L4_OFFSET_bf)))
+    move($nbi_desc_wr[5], ((MAC_PREPEND_BYTES + 14) << BF_L(CAT_L3_OFFSET_bf)))
+    move($nbi_desc_wr[6], 0)
+    move($nbi_desc_wr[7], (in_v6_opt << BF_L(MAC_PARSE_V6_OPT_bf)))
+
+    mem[write32, $nbi_desc_wr[0], 0, <<8, addr, (NBI_IN_META_SIZE_LW + (MAC_PREPEND_BYTES / 4))], ctx_swap[s]
+    mem[read32,  $nbi_desc_rd[0], 0, <<8, addr, (NBI_IN_META_SIZE_LW + (MAC_PREPEND_BYTES / 4))], ctx_swap[s]
+#endm
+
+#macro nbi_ipv6_check(expected_seq, expected_hdr_stack)
+    pv_init_nbi(pkt_vec, $nbi_desc_rd, tunnel_args)
+
+    alu[value, --, B, *l$index1[PV_SEQ_wrd]]
+    test_assert_equal(value, expected_seq)
+    alu[value, --, B, *l$index1[PV_HEADER_STACK_wrd]]
+    test_assert_equal(value, expected_hdr_stack)
+#endm
+
+local_csr_wr[ACTIVE_LM_ADDR_1, 0]
+move(loop_cntr, 0)
+.while (loop_cntr < PV_SIZE_LW)
+    move(pkt_vec++, 0)
+    alu[loop_cntr, loop_cntr, +, 1]
+.endw
+local_csr_wr[ACTIVE_LM_ADDR_1, 0]
+nop
+nop
+nop
+
+move(addr, 0x80)
+move(tunnel_args, 0)
+
+/* IPv6/TCP, classified by Catamaran */
+nbi_ipv6_desc_write(3, 0)
+nbi_ipv6_check(((2 << BF_L(PV_SEQ_CTX_bf)) | PROTO_IPV6_TCP), 0x0e360e36)
+
+/* IPv6/UDP, classified by Catamaran */
+nbi_ipv6_desc_write(2, 0)
+nbi_ipv6_check(((2 << BF_L(PV_SEQ_CTX_bf)) | PROTO_IPV6_UDP), 0x0e360e36)
+
+/* IPv6 extension headers, software parser finds no known EtherType */
+nbi_ipv6_desc_write(3, 1)
+nbi_ipv6_check(((2 << BF_L(PV_SEQ_CTX_bf)) | PROTO_UNKNOWN), 0)
+
+test_pass()
+
+PV_HDR_PARSE_SUBROUTINE#:
+pv_hdr_parse_subroutine(pkt_vec)
+
+PV_SEEK_SUBROUTINE#:
+   pv_seek_subroutine(pkt_vec)
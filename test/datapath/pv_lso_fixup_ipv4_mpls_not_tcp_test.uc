@@ -44,6 +44,7 @@ mem[read32, $in_nfd_desc[0], 0, <<8, addrlo, NFD_IN_META_SIZE_LW], ctx_swap[s]
 
 
 // try PROTO_IPV4_UDP, PROTO_IPV4_UNKNOWN, PROTO_IPV4_FRAGMENT
+// (USO is not enabled in NIC_USO_QUEUE_TBL for the queue)
 
 #define_eval _PV_L3_OFFSET (14 + 4)
 #define_eval _PV_L4_OFFSET (14 + 4 + 20)
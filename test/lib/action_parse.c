@@ -193,6 +193,27 @@ static void parse_action_list(void)
                     test_assert_equal(action.value, 0);
                 break;
 
+            case INSTR_RX_WIRE_DMAC_MATCH:
+                /* actions length: 3 words (note ++i below)*/
+                i += 1;
+                action_next = _action_list[++i];
+                if (action_next.pipeline)
+                    test_assert_equal(action_next.op,
+                                      INSTR_CHECKSUM_RSS_TX_HOST);
+                break;
+
+            case INSTR_CHECKSUM_RSS_TX_HOST:
+                /* actions length: 4 words */
+                i += 3;
+                /* fall through */
+            case INSTR_LRO:
+            case INSTR_HDS:
+                /* actions length: 1 word*/
+                /* no instruction follows these in code store */
+                action_next = _action_list[i];
+                test_assert_equal(action_next.pipeline, 0);
+                break;
+
             default:
                 test_assert_equal(action.value, 0);
                 break;